@@ -14,6 +14,7 @@
 #include "comms/requester.hpp"
 #include "serial/serial.hpp"
 #include "datatype/sensors.hpp"
+#include "app/gradient.hpp"
 
 namespace obsidian
 {
@@ -23,10 +24,11 @@ namespace obsidian
   template<ForwardModel f>
   struct AsyncSend
   {
-    AsyncSend(const std::string &worldParams, std::vector<stateline::comms::JobData> &j)
+    AsyncSend(const std::string &worldParams, std::vector<stateline::comms::JobData> &j, bool gradients)
     {
-      typename Types<f>::Params param;
+      typename Types<f>::Params param = typename Types<f>::Params();
       param.returnSensorData = false; // false atm. maybe some day for some use case, we might want to set this to true
+      JobGradient<f>::request(param, gradients);
       j.push_back(comms::serialiseJob<f>(param, worldParams));
     }
   };
@@ -36,21 +38,24 @@ namespace obsidian
   template<ForwardModel f>
   struct AsyncRetrieve
   {
-    AsyncRetrieve(const std::vector<stateline::comms::ResultData> &results, std::vector<double> &lh, uint &sensorId)
+    AsyncRetrieve(const std::vector<stateline::comms::ResultData> &results, std::vector<double> &lh, uint &sensorId,
+                  bool gradients, WorldParams &gradient)
     {
       typename Types<f>::Results res;
       comms::unserialiseResult<f>(results[sensorId++], res);
       lh.push_back(res.likelihood);
+      if (gradients)
+        JobGradient<f>::add(res, gradient);
     }
   };
 
   GeoAsyncPolicy::GeoAsyncPolicy(stateline::comms::Delegator &delegator, const GlobalPrior& prior,
-                                 const std::set<ForwardModel> &sensorsEnabled)
-      : req_(delegator), prior_(prior), sensorsEnabled_(sensorsEnabled)
+                                 const std::set<ForwardModel> &sensorsEnabled, bool gradients)
+      : req_(delegator), prior_(prior), sensorsEnabled_(sensorsEnabled), gradients_(gradients)
   {
   }
 
-  void GeoAsyncPolicy::submit(uint id, const Eigen::VectorXd &theta)
+  void GeoAsyncPolicy::submit(uint id, const Eigen::VectorXd &theta, int priority)
   {
     GlobalParams params = prior_.reconstruct(theta);
     std::string globalData = comms::serialise(params.world);
@@ -59,9 +64,11 @@ namespace obsidian
 
     if (!is_neg_infinity(priorValues_[id])) // Within acceptable bounds
     {
+      if (gradients_)
+        worldGradients_[id] = prior_.logPDFGradient(theta);
       std::vector<stateline::comms::JobData> jobs;
-      applyToSensorsEnabled<AsyncSend>(sensorsEnabled_, globalData, std::ref(jobs));
-      req_.batchSubmit(id, jobs);
+      applyToSensorsEnabled<AsyncSend>(sensorsEnabled_, globalData, std::ref(jobs), gradients_);
+      req_.batchSubmit(id, jobs, priority);
     } else // outside bounds; no point sending work to shards; we already know the outcome: likelihood = -infinity
     {
       zeroSet_.push(id);
@@ -74,6 +81,8 @@ namespace obsidian
     {
       auto val = std::make_pair(zeroSet_.front(), -std::numeric_limits<double>::infinity());
       zeroSet_.pop();
+      priorValues_.erase(val.first);
+      energyGradients_.erase(val.first);
       return val;
     }
 
@@ -84,9 +93,31 @@ namespace obsidian
 
     std::vector<double> logLikelihoods;
     uint sensorId = 0;
-    applyToSensorsEnabled<AsyncRetrieve>(sensorsEnabled_, std::cref(results), std::ref(logLikelihoods), std::ref(sensorId));
+    WorldParams worldGradient;
+    if (gradients_)
+    {
+      worldGradient = worldGradients_[id];
+      worldGradients_.erase(id);
+    }
+    applyToSensorsEnabled<AsyncRetrieve>(sensorsEnabled_, std::cref(results), std::ref(logLikelihoods), std::ref(sensorId),
+                                         gradients_, std::ref(worldGradient));
     double logLikelihood = std::accumulate(logLikelihoods.begin(), logLikelihoods.end(), 0.0) + priorValues_[id];
     double negLogLikelihood = -1.0 * logLikelihood;
+    priorValues_.erase(id);
+    if (gradients_)
+      energyGradients_[id] = -1.0 * prior_.thetaGradient(worldGradient);
     return std::make_pair(id, negLogLikelihood);
   }
+
+  Eigen::VectorXd GeoAsyncPolicy::gradient(uint id)
+  {
+    Eigen::VectorXd g;
+    auto it = energyGradients_.find(id);
+    if (it != energyGradients_.end())
+    {
+      g = it->second;
+      energyGradients_.erase(it);
+    }
+    return g;
+  }
 } // namespace obsidian
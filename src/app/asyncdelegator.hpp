@@ -25,14 +25,20 @@ namespace obsidian
   class GeoAsyncPolicy
   {
   public:
-    GeoAsyncPolicy(stateline::comms::Delegator &delegator, const GlobalPrior& prior, const std::set<ForwardModel> &sensorsEnabled);
+    //! \param gradients Whether to request the gradient of the energy with
+    //!        respect to theta along with each job; see gradient().
+    //!
+    GeoAsyncPolicy(stateline::comms::Delegator &delegator, const GlobalPrior& prior, const std::set<ForwardModel> &sensorsEnabled,
+                   bool gradients = false);
 
     //! Submit job for a parameter set for all sensors.
     //!
     //! \param id a job ID (0 - uint32_t::max
     //! \param theta parameters to compute likelihood of.
+    //! \param priority How many of the queued jobs this job may go ahead of,
+    //!        less their own priorities.
     //!
-    void submit(uint id, const Eigen::VectorXd &theta);
+    void submit(uint id, const Eigen::VectorXd &theta, int priority = 0);
 
     //! Retrieve a job likelihood; collated over all the sensors.
     //!
@@ -40,6 +46,15 @@ namespace obsidian
     //!
     std::pair<uint, double> retrieve();
 
+    //! Take the gradient of the energy of the last retrieved job with an ID.
+    //! Only the gravity and magnetics likelihoods contribute to it.
+    //!
+    //! \param id The job ID.
+    //! \return The gradient with respect to theta, or an empty vector if
+    //!         gradients are off or the job was out of bounds.
+    //!
+    Eigen::VectorXd gradient(uint id);
+
   private:
 
     stateline::comms::Requester req_;
@@ -48,5 +63,8 @@ namespace obsidian
     std::vector<uint> thetaLengths_;
     std::set<ForwardModel> sensorsEnabled_;
     std::queue<uint> zeroSet_;
+    bool gradients_;
+    std::map<uint, WorldParams> worldGradients_;
+    std::map<uint, Eigen::VectorXd> energyGradients_;
   };
 }
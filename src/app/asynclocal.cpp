@@ -0,0 +1,166 @@
+//!
+//! Async policy evaluating jobs on threads of the server process.
+//!
+//! \file app/asynclocal.cpp
+//! \date 2026
+//! \license Affero General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include "app/asynclocal.hpp"
+#include <glog/logging.h>
+#include "world/interpolate.hpp"
+#include "fwdmodel/global.hpp"
+#include "datatype/sensors.hpp"
+#include "app/gradient.hpp"
+
+namespace obsidian
+{
+  //! Builds the likelihood context of a forward model.
+  //!
+  template<ForwardModel f>
+  struct LocalContext
+  {
+    LocalContext(const GlobalSpec &spec, const GlobalResults &real, GlobalLikelihoodContext &context)
+    {
+      LOG(INFO) << "Generating " << f << " likelihood context";
+      GlobalField<f>::of(context) = lh::likelihoodContext<f>(GlobalField<f>::of(real), GlobalField<f>::of(spec));
+    }
+  };
+
+  //! Runs a forward model and adds its likelihood (and gradient) to those of
+  //! the job.
+  //!
+  template<ForwardModel f>
+  struct LocalEvaluate
+  {
+    LocalEvaluate(const GlobalSpec &globalSpec, const GlobalCache &globalCache, const GlobalLikelihoodContext &globalContext,
+                  const WorldParams &world, bool gradients, double &logLikelihood, WorldParams &gradient)
+    {
+      const typename Types<f>::Spec &spec = GlobalField<f>::of(globalSpec);
+      const typename Types<f>::Cache &cache = GlobalField<f>::of(globalCache);
+      const lh::LikelihoodContext<f> &context = GlobalField<f>::of(globalContext);
+      typename Types<f>::Params params = typename Types<f>::Params();
+      params.returnSensorData = false;
+      JobGradient<f>::request(params, gradients);
+      typename Types<f>::Results synthetic = fwd::forwardModel<f>(spec, cache, world, params);
+      typename Types<f>::Results result;
+      result.likelihood = lh::likelihood<f>(synthetic, context, spec);
+      CHECK(!std::isnan(result.likelihood)) << f << " numerical error";
+      LikelihoodGradient<f>::add(spec, cache, context, world, params, synthetic, result);
+      logLikelihood += result.likelihood;
+      if (gradients)
+        JobGradient<f>::add(result, gradient);
+    }
+  };
+
+  LocalAsyncPolicy::LocalAsyncPolicy(const GlobalSpec &spec, const GlobalResults &real, const GlobalPrior &prior,
+                                     const std::set<ForwardModel> &sensorsEnabled, uint nThreads, bool gradients)
+      : spec_(spec), prior_(prior), sensorsEnabled_(sensorsEnabled), gradients_(gradients), arrivals_(0), stop_(false)
+  {
+    LOG(INFO) << "Generating forward model caches";
+    cache_ = fwd::generateGlobalCache(world::worldspec2Interp(spec_.world), spec_, sensorsEnabled_);
+    applyToSensorsEnabled<LocalContext>(sensorsEnabled_, std::cref(spec_), std::cref(real), std::ref(context_));
+
+    LOG(INFO) << "Launching " << nThreads << " evaluation threads";
+    for (uint i = 0; i < nThreads; i++)
+      threads_.push_back(std::async(std::launch::async, &LocalAsyncPolicy::workerThread, this));
+  }
+
+  LocalAsyncPolicy::~LocalAsyncPolicy()
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    jobReady_.notify_all();
+    for (auto &t : threads_)
+      t.wait();
+  }
+
+  void LocalAsyncPolicy::submit(uint id, const Eigen::VectorXd &theta, int priority)
+  {
+    priorValues_[id] = prior_.evaluate(theta);
+
+    if (!is_neg_infinity(priorValues_[id])) // Within acceptable bounds
+    {
+      // The prior is only touched on this thread; the workers get world params
+      Job job { id, prior_.reconstruct(theta).world, WorldParams() };
+      if (gradients_)
+        job.gradient = prior_.logPDFGradient(theta);
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        jobs_.insert(std::make_pair(arrivals_++ - priority, std::move(job)));
+      }
+      jobReady_.notify_one();
+    } else // outside bounds; no point running the forward models; we already know the outcome: likelihood = -infinity
+    {
+      zeroSet_.push(id);
+    }
+  }
+
+  std::pair<uint, double> LocalAsyncPolicy::retrieve()
+  {
+    if (zeroSet_.size() > 0) // out of bounds
+    {
+      auto val = std::make_pair(zeroSet_.front(), -std::numeric_limits<double>::infinity());
+      zeroSet_.pop();
+      priorValues_.erase(val.first);
+      energyGradients_.erase(val.first);
+      return val;
+    }
+
+    Result result;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      resultReady_.wait(lock, [this]() { return !results_.empty(); });
+      result = std::move(results_.front());
+      results_.pop();
+    }
+
+    double negLogLikelihood = -1.0 * (result.logLikelihood + priorValues_[result.id]);
+    priorValues_.erase(result.id);
+    if (gradients_)
+      energyGradients_[result.id] = -1.0 * prior_.thetaGradient(result.gradient);
+    return std::make_pair(result.id, negLogLikelihood);
+  }
+
+  Eigen::VectorXd LocalAsyncPolicy::gradient(uint id)
+  {
+    Eigen::VectorXd g;
+    auto it = energyGradients_.find(id);
+    if (it != energyGradients_.end())
+    {
+      g = it->second;
+      energyGradients_.erase(it);
+    }
+    return g;
+  }
+
+  bool LocalAsyncPolicy::workerThread()
+  {
+    while (true)
+    {
+      Job job;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        jobReady_.wait(lock, [this]() { return !jobs_.empty() || stop_; });
+        if (stop_)
+          break;
+        job = std::move(jobs_.begin()->second);
+        jobs_.erase(jobs_.begin());
+      }
+
+      Result result { job.id, 0.0, std::move(job.gradient) };
+      applyToSensorsEnabled<LocalEvaluate>(sensorsEnabled_, std::cref(spec_), std::cref(cache_), std::cref(context_),
+                                           std::cref(job.world), gradients_, std::ref(result.logLikelihood),
+                                           std::ref(result.gradient));
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        results_.push(std::move(result));
+      }
+      resultReady_.notify_one();
+    }
+    return true;
+  }
+} // namespace obsidian
@@ -0,0 +1,127 @@
+//!
+//! Async policy evaluating jobs on threads of the server process.
+//!
+//! \file app/asynclocal.hpp
+//! \date 2026
+//! \license Affero General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+#include <queue>
+#include "datatype/datatypes.hpp"
+#include "datatype/forwardmodels.hpp"
+#include "likelihood/likelihood.hpp"
+#include "prior/prior.hpp"
+
+namespace obsidian
+{
+  //! The likelihood contexts of all the forward models.
+  //!
+  struct GlobalLikelihoodContext
+  {
+    lh::LikelihoodContext<ForwardModel::GRAVITY> grav;
+    lh::LikelihoodContext<ForwardModel::MAGNETICS> mag;
+    lh::LikelihoodContext<ForwardModel::MTANISO> mt;
+    lh::LikelihoodContext<ForwardModel::SEISMIC1D> s1d;
+    lh::LikelihoodContext<ForwardModel::CONTACTPOINT> cpoint;
+    lh::LikelihoodContext<ForwardModel::THERMAL> therm;
+  };
+
+  //! Drop-in replacement for GeoAsyncPolicy on a single node. Owns a pool of
+  //! threads that run the forward models and likelihoods directly, so there
+  //! is no serialisation or transport between the sampler and the shards.
+  //! The caches and likelihood contexts are built once and shared read-only
+  //! by the threads.
+  //!
+  class LocalAsyncPolicy
+  {
+  public:
+    //! Build the caches and start the threads.
+    //!
+    //! \param spec The specifications of the world and forward models.
+    //! \param real The observed sensor readings.
+    //! \param prior The prior.
+    //! \param sensorsEnabled The forward models to evaluate.
+    //! \param nThreads The number of evaluation threads.
+    //! \param gradients Whether to compute the gradient of the energy with
+    //!        respect to theta along with each job; see gradient().
+    //!
+    LocalAsyncPolicy(const GlobalSpec& spec, const GlobalResults& real, const GlobalPrior& prior,
+                     const std::set<ForwardModel>& sensorsEnabled, uint nThreads, bool gradients = false);
+
+    //! Stop the threads. Jobs that have not started are dropped.
+    //!
+    ~LocalAsyncPolicy();
+
+    //! Submit job for a parameter set for all sensors.
+    //!
+    //! \param id a job ID (0 - uint32_t::max
+    //! \param theta parameters to compute likelihood of.
+    //! \param priority How many of the queued jobs this job may go ahead of,
+    //!        less their own priorities.
+    //!
+    void submit(uint id, const Eigen::VectorXd& theta, int priority = 0);
+
+    //! Retrieve a job likelihood; collated over all the sensors. Blocks
+    //! until a job has finished.
+    //!
+    //! \return pair<job ID , likelihood>
+    //!
+    std::pair<uint, double> retrieve();
+
+    //! Take the gradient of the energy of the last retrieved job with an ID.
+    //! Only the gravity and magnetics likelihoods contribute to it.
+    //!
+    //! \param id The job ID.
+    //! \return The gradient with respect to theta, or an empty vector if
+    //!         gradients are off or the job was out of bounds.
+    //!
+    Eigen::VectorXd gradient(uint id);
+
+  private:
+    struct Job
+    {
+      uint id;
+      WorldParams world;
+      //! The likelihood gradients are added to this, if gradients are on.
+      WorldParams gradient;
+    };
+
+    struct Result
+    {
+      uint id;
+      double logLikelihood;
+      WorldParams gradient;
+    };
+
+    bool workerThread();
+
+    GlobalSpec spec_;
+    GlobalCache cache_;
+    GlobalLikelihoodContext context_;
+    GlobalPrior prior_;
+    std::map<uint, double> priorValues_;
+    std::set<ForwardModel> sensorsEnabled_;
+    std::queue<uint> zeroSet_;
+    bool gradients_;
+    std::map<uint, Eigen::VectorXd> energyGradients_;
+
+    // Shared with the threads. Jobs are kept by turn, as the delegator keeps
+    // them: the number of jobs submitted before a job, less its priority
+    std::mutex mutex_;
+    std::condition_variable jobReady_;
+    std::condition_variable resultReady_;
+    std::multimap<long long, Job> jobs_;
+    long long arrivals_;
+    std::queue<Result> results_;
+    bool stop_;
+    std::vector<std::future<bool>> threads_;
+  };
+}
@@ -19,13 +19,14 @@
 #include "fwdmodel/fwd.hpp"
 #include "likelihood/likelihood.hpp"
 #include "serial/serial.hpp"
+#include "app/gradient.hpp"
 
 namespace obsidian
 {
   //! Thread method receives jobs and evaluates likelihoods and sends results back until until interrupted by signal.
   //!
   template<ForwardModel f>
-  bool workerThread(const typename Types<f>::Spec& spec, const typename Types<f>::Cache& cache, const typename Types<f>::Results& real,
+  bool workerThread(const typename Types<f>::Spec& spec, const typename Types<f>::Cache& cache, const lh::LikelihoodContext<f>& context,
                     stateline::comms::Worker& worker)
   {
     stateline::comms::Minion minion(worker, (uint) f); // comms uses uints for jobs ID
@@ -44,12 +45,13 @@ namespace obsidian
       // Make the results
       typename Types<f>::Results result;
       auto tStart = hrc::now();
-      typename Types<f>::Results synthetic = fwd::forwardModel<f>(spec, cache, worldParams);
+      typename Types<f>::Results synthetic = fwd::forwardModel<f>(spec, cache, worldParams, params);
       auto tEnd = hrc::now();
       if (params.returnSensorData)
         result = synthetic;
-      result.likelihood = lh::likelihood<f>(synthetic, real, spec);
+      result.likelihood = lh::likelihood<f>(synthetic, context, spec);
       CHECK(!std::isnan(result.likelihood)) << f << " numerical error";
+      LikelihoodGradient<f>::add(spec, cache, context, worldParams, params, synthetic, result);
       // Submit the results
       // Use a uint for the job ID
       minion.submitResult( { (uint) f, comms::serialise(result) });
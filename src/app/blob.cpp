@@ -11,4 +11,5 @@
 
 #include "console.cpp"
 #include "asyncdelegator.cpp"
+#include "asynclocal.cpp"
 #include "settings.cpp"
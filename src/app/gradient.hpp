@@ -0,0 +1,105 @@
+//!
+//! Likelihood gradients of the forward models on the worker and server side.
+//!
+//! \file app/gradient.hpp
+//! \date 2026
+//! \license Affero General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#pragma once
+
+#include "datatype/datatypes.hpp"
+#include "fwdmodel/fwd.hpp"
+#include "likelihood/likelihood.hpp"
+
+namespace obsidian
+{
+  //! Adds one world params gradient to another of the same shape.
+  //!
+  inline void addGradient(const WorldParams &gradient, WorldParams &sum)
+  {
+    for (uint i = 0; i < sum.rockProperties.size(); i++)
+      sum.rockProperties[i] += gradient.rockProperties[i];
+    for (uint i = 0; i < sum.controlPoints.size(); i++)
+      sum.controlPoints[i] += gradient.controlPoints[i];
+  }
+
+  //! Requests and collects likelihood gradients. Only the linear forward
+  //! models return them; the others contribute nothing.
+  //!
+  template<ForwardModel f>
+  struct JobGradient
+  {
+    static void request(typename Types<f>::Params &param, bool gradients)
+    {
+    }
+
+    static void add(const typename Types<f>::Results &res, WorldParams &gradient)
+    {
+    }
+  };
+
+  template<ForwardModel f>
+  struct LinearJobGradient
+  {
+    static void request(typename Types<f>::Params &param, bool gradients)
+    {
+      param.returnGradient = gradients;
+    }
+
+    static void add(const typename Types<f>::Results &res, WorldParams &gradient)
+    {
+      addGradient(res.gradient, gradient);
+    }
+  };
+
+  template<>
+  struct JobGradient<ForwardModel::GRAVITY> : LinearJobGradient<ForwardModel::GRAVITY>
+  {
+  };
+
+  template<>
+  struct JobGradient<ForwardModel::MAGNETICS> : LinearJobGradient<ForwardModel::MAGNETICS>
+  {
+  };
+
+  //! Adds the gradient of the likelihood with respect to the world parameters
+  //! to the results of a job. Only the linear forward models have gradients,
+  //! so by default nothing is added.
+  //!
+  template<ForwardModel f>
+  struct LikelihoodGradient
+  {
+    static void add(const typename Types<f>::Spec& spec, const typename Types<f>::Cache& cache, const lh::LikelihoodContext<f>& context,
+                    const WorldParams& world, const typename Types<f>::Params& params, const typename Types<f>::Results& synthetic,
+                    typename Types<f>::Results& result)
+    {
+    }
+  };
+
+  //! Likelihood gradient of the forward models that are linear in the voxel
+  //! properties.
+  //!
+  template<ForwardModel f>
+  struct LinearLikelihoodGradient
+  {
+    static void add(const typename Types<f>::Spec& spec, const typename Types<f>::Cache& cache, const lh::LikelihoodContext<f>& context,
+                    const WorldParams& world, const typename Types<f>::Params& params, const typename Types<f>::Results& synthetic,
+                    typename Types<f>::Results& result)
+    {
+      if (params.returnGradient)
+        result.gradient = fwd::forwardModelGradient<f>(spec, cache, world, lh::likelihoodGradient<f>(synthetic, context, spec));
+    }
+  };
+
+  template<>
+  struct LikelihoodGradient<ForwardModel::GRAVITY> : LinearLikelihoodGradient<ForwardModel::GRAVITY>
+  {
+  };
+
+  template<>
+  struct LikelihoodGradient<ForwardModel::MAGNETICS> : LinearLikelihoodGradient<ForwardModel::MAGNETICS>
+  {
+  };
+}
@@ -9,11 +9,15 @@
 #include "settings.hpp"
 
 #include <fstream>
+#include <map>
 #include <boost/filesystem.hpp>
 #include <glog/logging.h>
 
 namespace obsidian
 {
+  const std::map<std::string, stateline::ChainStore> chainStoreMap { { "leveldb", stateline::ChainStore::LevelDB },
+      { "segments", stateline::ChainStore::Segments } };
+
   po::options_description configFileOptions()
   {
     po::options_description configFile("GDF Configuration File Options");
@@ -27,7 +31,9 @@ namespace obsidian
     ("delegator.heartbeatPollRate", po::value<int>()->default_value(500), "time in ms between heartbeat polls") //
     ("delegator.heartbeatTimeout", po::value<uint>()->default_value(10000), "time in ms for no hearbeat disconnection") //
     ("database.directory", po::value<std::string>()->default_value("chainDB"), "Directory for storing chain database") //
-    ("database.cacheSizeMB", po::value<double>()->default_value(100.0), "Size of database cache in MB");
+    ("database.cacheSizeMB", po::value<double>()->default_value(100.0), "Size of database cache in MB") //
+    ("database.writeQueueLength", po::value<uint>()->default_value(4), "Number of chain caches that can wait to be written") //
+    ("database.chainStore", po::value<std::string>()->default_value("segments"), "How chain states are stored (leveldb or segments)");
     return configFile;
   }
 
@@ -53,6 +59,8 @@ namespace obsidian
     s.directory = vm["database.directory"].as<std::string>();
     s.recover = vm["recover"].as<bool>();
     s.cacheSizeMB = vm["database.cacheSizeMB"].as<double>();
+    s.writeQueueLength = vm["database.writeQueueLength"].as<uint>();
+    s.chainStore = chainStoreMap.at(vm["database.chainStore"].as<std::string>());
     return s;
   }
 
@@ -0,0 +1,224 @@
+//!
+//! Contains tests for the async policy evaluating jobs on threads of the server process.
+//!
+//! \file app/testasynclocal.hpp
+//! \date 2026
+//! \license Affero General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <map>
+#include <memory>
+#include <random>
+
+#include "app/asynclocal.hpp"
+#include "fwdmodel/global.hpp"
+#include "world/interpolate.hpp"
+#include "test/world.hpp"
+
+namespace obsidian
+{
+  //! A world of three layers seen by gravity, magnetics and contact point
+  //! sensors. The densities, susceptibilities and the depths of the lower two
+  //! boundaries are free, within bounds.
+  //!
+  class LocalAsyncPolicyTest: public ::testing::Test
+  {
+  public:
+    GlobalSpec spec;
+    GlobalResults real;
+    std::unique_ptr<GlobalPrior> ptrPrior;
+    std::set<ForwardModel> enabled;
+
+    virtual void SetUp()
+    {
+      WorldParams truth;
+      testing::initWorld(spec.world, truth, 0, 1000, 4, 0, 1000, 4, 0, 1000, 3,
+          [](double x, double y, uint boundary)
+          {
+            return 0.0;
+          },
+          [](double x, double y, uint boundary)
+          {
+            return boundary * 300.0 + 40.0 * std::sin(x / 200.0) + 25.0 * std::cos(y / 300.0);
+          },
+          [](uint layer, uint property)
+          {
+            return 1.0 + 0.5 * layer;
+          });
+
+      spec.grav.locations.resize(6, 3);
+      for (uint i = 0; i < 6; i++)
+      {
+        spec.grav.locations(i, 0) = 100.0 + 150.0 * i;
+        spec.grav.locations(i, 1) = 800.0 - 110.0 * i;
+        spec.grav.locations(i, 2) = 0.0;
+      }
+      spec.grav.voxelisation = { 6, 6, 10, 1 };
+      spec.grav.noise = { 2.0, 1.0 };
+
+      spec.mag.locations = spec.grav.locations;
+      spec.mag.voxelisation = spec.grav.voxelisation;
+      spec.mag.noise = { 2.0, 1.0 };
+      spec.mag.backgroundField = Eigen::Vector3d(3.5929e3, 2.755e4, -4.78e4);
+
+      spec.cpoint.locations.resize(2, 3);
+      for (uint i = 0; i < 2; i++)
+      {
+        spec.cpoint.locations(i, 0) = 300.0 + 400.0 * i;
+        spec.cpoint.locations(i, 1) = 600.0 - 200.0 * i;
+        spec.cpoint.locations(i, 2) = 0.0;
+        Eigen::VectorXi interfaces(2);
+        interfaces << 1, 2;
+        spec.cpoint.interfaces.push_back(interfaces);
+      }
+      spec.cpoint.noise = { 2.0, 1.0 };
+
+      std::set<ForwardModel> all = { ForwardModel::GRAVITY, ForwardModel::MAGNETICS, ForwardModel::CONTACTPOINT };
+      GlobalCache cache = fwd::generateGlobalCache(world::worldspec2Interp(spec.world), spec, all);
+      real = fwd::forwardModelAll(spec, cache, { truth }, all);
+      enabled = { ForwardModel::GRAVITY, ForwardModel::CONTACTPOINT };
+
+      uint nProps = static_cast<uint>(RockProperty::Count);
+      uint density = static_cast<uint>(RockProperty::Density);
+      uint susceptibility = static_cast<uint>(RockProperty::LogSusceptibility);
+      std::vector<distrib::MultiGaussian> ctrlpts;
+      std::vector<Eigen::MatrixXi> ctrlptMasks;
+      std::vector<Eigen::MatrixXd> ctrlptMins;
+      std::vector<Eigen::MatrixXd> ctrlptMaxs;
+      std::vector<distrib::MultiGaussian> properties;
+      std::vector<Eigen::VectorXi> propMasks;
+      std::vector<Eigen::VectorXd> propMins;
+      std::vector<Eigen::VectorXd> propMaxs;
+      std::vector<BoundaryClass> classes;
+      for (uint l = 0; l < 3; l++)
+      {
+        Eigen::MatrixXd depth = Eigen::MatrixXd::Constant(4, 4, l * 300.0);
+        ctrlpts.push_back(distrib::coupledGaussianBlock(depth, 20.0, 20.0));
+        ctrlptMasks.push_back(Eigen::MatrixXi::Constant(4, 4, l > 0));
+        ctrlptMins.push_back(depth.array() - 100.0);
+        ctrlptMaxs.push_back(depth.array() + 100.0);
+        properties.push_back(distrib::MultiGaussian(truth.rockProperties[l], 0.01 * Eigen::MatrixXd::Identity(nProps, nProps)));
+        propMasks.push_back(Eigen::VectorXi::Zero(nProps));
+        propMasks.back()(density) = 1;
+        propMasks.back()(susceptibility) = 1;
+        propMins.push_back(Eigen::VectorXd::Zero(nProps));
+        propMaxs.push_back(Eigen::VectorXd::Constant(nProps, 5.0));
+        classes.push_back(BoundaryClass::Normal);
+      }
+      ptrPrior.reset(
+          new GlobalPrior { prior::WorldParamsPrior(ctrlpts, ctrlptMasks, ctrlptMins, ctrlptMaxs, Eigen::VectorXd::Constant(3, 20.0),
+                                                    Eigen::VectorXd::Constant(3, 20.0), properties, propMasks, propMins, propMaxs,
+                                                    classes) });
+    }
+
+    //! Draw thetas from the prior, and one that is beyond its bounds.
+    //!
+    std::vector<Eigen::VectorXd> thetas(uint n)
+    {
+      std::mt19937 gen(3);
+      std::vector<Eigen::VectorXd> result;
+      for (uint i = 0; i < n; i++)
+        result.push_back(ptrPrior->sample(gen));
+      result.push_back(result[0].array() + 1e3);
+      return result;
+    }
+
+    //! The energy of a theta from the forward models and likelihoods run one
+    //! job at a time, without the policy.
+    //!
+    double energy(const Eigen::VectorXd& theta)
+    {
+      GlobalCache cache = fwd::generateGlobalCache(world::worldspec2Interp(spec.world), spec, enabled);
+      GlobalResults synthetic = fwd::forwardModelAll(spec, cache, ptrPrior->reconstruct(theta), enabled);
+      std::vector<double> likelihoods = lh::likelihoodAll(synthetic, real, spec, enabled);
+      double logLikelihood = 0.0;
+      for (double l : likelihoods)
+        logLikelihood += l;
+      return -1.0 * (logLikelihood + ptrPrior->evaluate(theta));
+    }
+
+    //! Check the gradients of the policy against central differences of
+    //! energy(), for one forward model that returns gradients.
+    //!
+    void expectGradientsMatchCentralDifferences(ForwardModel f)
+    {
+      enabled = { f };
+      std::vector<Eigen::VectorXd> t = thetas(3);
+      LocalAsyncPolicy policy(spec, real, *ptrPrior, enabled, 2, true);
+      for (uint i = 0; i < t.size(); i++)
+        policy.submit(i, t[i]);
+
+      const double h = 1e-4;
+      for (uint i = 0; i < t.size(); i++)
+      {
+        std::pair<uint, double> result = policy.retrieve();
+        Eigen::VectorXd gradient = policy.gradient(result.first);
+        if (result.first == t.size() - 1)
+        {
+          EXPECT_EQ(0, gradient.size());
+          continue;
+        }
+        const Eigen::VectorXd& theta = t[result.first];
+        EXPECT_NEAR(energy(theta), result.second, 1e-9 * (1.0 + std::abs(result.second)));
+        ASSERT_EQ(theta.size(), gradient.size());
+        for (uint j = 0; j < theta.size(); j++)
+        {
+          Eigen::VectorXd up = theta, down = theta;
+          up(j) += h;
+          down(j) -= h;
+          double expected = (energy(up) - energy(down)) / (2 * h);
+          EXPECT_NEAR(expected, gradient(j), 1e-6 * (1.0 + std::abs(expected))) << "theta " << j;
+        }
+
+        // The gradient of a job is only given once
+        EXPECT_EQ(0, policy.gradient(result.first).size());
+      }
+    }
+  };
+
+  TEST_F(LocalAsyncPolicyTest, energiesMatchTheForwardModels)
+  {
+    std::vector<Eigen::VectorXd> t = thetas(6);
+    LocalAsyncPolicy policy(spec, real, *ptrPrior, enabled, 3);
+    for (uint i = 0; i < t.size(); i++)
+      policy.submit(i + 10, t[i]);
+
+    std::map<uint, double> energies;
+    for (uint i = 0; i < t.size(); i++)
+    {
+      std::pair<uint, double> result = policy.retrieve();
+      EXPECT_EQ(0U, energies.count(result.first));
+      energies[result.first] = result.second;
+      EXPECT_EQ(0, policy.gradient(result.first).size());
+    }
+
+    ASSERT_EQ(t.size(), energies.size());
+    for (uint i = 0; i + 1 < t.size(); i++)
+    {
+      ASSERT_EQ(1U, energies.count(i + 10));
+      double expected = energy(t[i]);
+      ASSERT_TRUE(std::isfinite(expected));
+      EXPECT_NEAR(expected, energies[i + 10], 1e-9 * (1.0 + std::abs(expected)));
+    }
+
+    // Like GeoAsyncPolicy, the policy knows a job beyond the bounds of the
+    // prior without running it
+    uint outside = t.size() - 1 + 10;
+    ASSERT_EQ(1U, energies.count(outside));
+    EXPECT_TRUE(std::isinf(ptrPrior->evaluate(t.back())));
+    EXPECT_EQ(-std::numeric_limits<double>::infinity(), energies[outside]);
+  }
+
+  TEST_F(LocalAsyncPolicyTest, gravityGradientsMatchCentralDifferences)
+  {
+    expectGradientsMatchCentralDifferences(ForwardModel::GRAVITY);
+  }
+
+  TEST_F(LocalAsyncPolicyTest, magneticsGradientsMatchCentralDifferences)
+  {
+    expectGradientsMatchCentralDifferences(ForwardModel::MAGNETICS);
+  }
+}
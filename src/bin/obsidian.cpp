@@ -26,8 +26,10 @@
 #include "comms/requester.hpp"
 #include "serial/serial.hpp"
 #include "app/asyncdelegator.hpp"
+#include "app/asynclocal.hpp"
 #include "app/signal.hpp"
 #include "infer/mcmc.hpp"
+#include "infer/smc.hpp"
 #include "infer/metropolis.hpp"
 #include "infer/adaptive.hpp"
 #include "fwdmodel/fwd.hpp"
@@ -48,20 +50,150 @@ po::options_description commandLineOptions()
   ("configfile,c", po::value<std::string>()->default_value("obsidian_config"), "configuration file") //
   ("inputfile,i", po::value<std::string>()->default_value("input.obsidian"), "input file") //
   ("recover,r", po::bool_switch()->default_value(false), "force recovery")
-  ("anneallength,a", po::value<uint>()->default_value(1000), "anneal chains with n samples before starting mcmc");
+  ("anneallength,a", po::value<uint>()->default_value(1000), "anneal chains with n samples before starting mcmc")
+  ("nthreads,t", po::value<uint>()->default_value(0), "evaluate the forward models on n local threads instead of on shards");
   return cmdLine;
 }
 
+//! Anneal the chains and run the sampler, or run population annealing,
+//! evaluating jobs with either the distributed or the local async policy.
+//!
+template<typename AsyncPolicy>
+void runInversion(AsyncPolicy &policy, GlobalPrior &prior, const MCMCSettings &mcmcSettings, const SMCSettings &smcSettings,
+                  const DBSettings &dbSettings, uint annealLength)
+{
+  std::function<Eigen::VectorXd(const Eigen::VectorXd&, double, const mcmc::ProposalCovariance&, mcmc::PhiloxGenerator&, uint, uint)>
+      proposal;
+  if (mcmcSettings.proposalCovarianceLength > 0)
+  {
+    LOG(INFO)<< "Using adaptive covariance proposals";
+    proposal = std::bind(&mcmc::adaptiveCovarianceProposal, ph::_1, ph::_2, ph::_3,
+                         prior.world.thetaMinBound(), prior.world.thetaMaxBound(), ph::_4, ph::_5, ph::_6);
+  }
+  else
+  {
+    proposal = std::bind(&mcmc::adaptiveGaussianProposal,ph::_1, ph::_2,
+                         prior.world.thetaMinBound(), prior.world.thetaMaxBound(), ph::_4, ph::_5, ph::_6);
+  }
+
+  if (smcSettings.particles > 0)
+  {
+    LOG(INFO)<< "Starting population annealing of " << smcSettings.particles << " particles: Run for at most "
+        << mcmcSettings.wallTime << " seconds";
+    LOG(INFO)<< "Problem dimensionality: " << prior.size();
+    mcmc::PopulationAnnealer smc(smcSettings, mcmcSettings, dbSettings, global::interruptedBySignal);
+    std::mt19937 gen(smc.chains().seed());
+    std::vector<Eigen::VectorXd> particles;
+    for (uint i = 0; i < smcSettings.particles; i++)
+      particles.push_back(prior.sample(gen));
+    mcmc::ScreenFn priorEnergy = [&prior](const Eigen::VectorXd &theta)
+    {
+      return -prior.evaluate(theta);
+    };
+    smc.run(policy, particles, proposal, priorEnergy, mcmcSettings.wallTime);
+    return;
+  }
+
+  // Start the sampling
+  LOG(INFO)<< "Starting inversion: Run for " << mcmcSettings.wallTime << " seconds";
+  LOG(INFO)<< "Problem dimensionality: " << prior.size();
+  mcmc::Sampler mcmc(mcmcSettings, dbSettings, prior.size(), global::interruptedBySignal);
+
+  // The initial thetas come from the run seed too, so the whole run replays
+  std::mt19937 gen(mcmc.chains().seed());
+
+  std::vector<Eigen::VectorXd> initialThetas;
+
+  LOG(INFO)<< "Loading / generating initial thetas for the chains";
+
+  // Chains that were not recovered start from the best of their own batch of
+  // prior samples. The batches of all chains form one stream of jobs so the
+  // workers stay busy for the whole search instead of draining after every
+  // chain. A window of one batch in flight keeps the candidates in memory
+  // bounded.
+  uint nChains = mcmcSettings.stacks * mcmcSettings.chains;
+  uint nSamples = annealLength;
+  initialThetas.resize(nChains);
+  std::vector<uint> annealed;
+  for (uint id = 0; id < nChains; id++)
+  {
+    mcmc::ChainCursor first = mcmc.chains().scan(id, 0, 1);
+    if (dbSettings.recover && !first.done())
+      initialThetas[id] = first.state().sample;
+    else
+      annealed.push_back(id);
+  }
+
+  uint nJobs = annealed.size() * nSamples;
+  uint nSubmitted = 0;
+  std::map<uint, Eigen::VectorXd> pending;
+  std::vector<double> lowestEnergies(annealed.size(), std::numeric_limits<double>::infinity());
+  std::vector<uint> bestIndices(annealed.size(), nJobs);
+  for (uint i = 0; i < nJobs; i++)
+  {
+    for (; nSubmitted < nJobs && nSubmitted < i + nSamples; nSubmitted++)
+    {
+      pending[nSubmitted] = prior.sample(gen);
+      policy.submit(nSubmitted, pending[nSubmitted]);
+    }
+    auto result = policy.retrieve();
+    uint index = result.first;
+    double energy = result.second;
+    uint k = index / nSamples;
+    // Out of bounds samples come back with infinite energy and are never
+    // best. Ties go to the earlier sample so the choice does not depend on
+    // the order the results arrive in.
+    if (bestIndices[k] == nJobs
+        || (std::isfinite(energy) && (energy < lowestEnergies[k] || (energy == lowestEnergies[k] && index < bestIndices[k]))))
+    {
+      bestIndices[k] = index;
+      if (std::isfinite(energy))
+        lowestEnergies[k] = energy;
+      initialThetas[annealed[k]] = pending[index];
+    }
+    pending.erase(index);
+  }
+  for (uint k = 0; k < annealed.size(); k++)
+  {
+    uint id = annealed[k];
+    LOG(INFO)<< "stack " << id / mcmcSettings.chains << " chain " << id % mcmcSettings.chains << " best energy: " << lowestEnergies[k];
+  }
+
+  mcmc::ScreenFn screen;
+  if (mcmcSettings.delayedAcceptance)
+  {
+    // Screen proposals on the prior alone so the forward models only see
+    // proposals that pass it; the likelihood ratio decides the second stage
+    LOG(INFO)<< "Using delayed acceptance with prior screening";
+    screen = [&prior](const Eigen::VectorXd &theta)
+    {
+      return -prior.evaluate(theta);
+    };
+  }
+  mcmc::GradientFn gradient;
+  if (mcmcSettings.proposalLangevin)
+  {
+    LOG(INFO)<< "Using Langevin proposals";
+    gradient = [&policy](uint id)
+    {
+      return policy.gradient(id);
+    };
+  }
+  std::vector<uint> blocks;
+  if (mcmcSettings.proposalBlocks != BlockUpdate::None)
+  {
+    blocks = prior.thetaBlocks();
+    LOG(INFO)<< "Using block-wise proposals over " << blocks.size() - 1 << " blocks";
+  }
+  mcmc.run(policy, initialThetas, proposal, mcmcSettings.wallTime, screen, gradient, blocks);
+}
+
 int main(int ac, char* av[])
 {
   init::initialiseSignalHandler();
   // Get the settings from the command line
   auto vm = init::initProgramOptions(ac, av, commandLineOptions());
 
-  // Set up a random generator here
-  std::random_device rd;
-  std::mt19937 gen(rd());
-
   LOG(INFO)<< "Initialise the various settings and objects";
 
   readConfigFile(vm["configfile"].as<std::string>(), vm);
@@ -70,6 +202,7 @@ int main(int ac, char* av[])
   std::set<ForwardModel> sensorsEnabled = parseSensorsEnabled(vm);
   DelegatorSettings delegatorSettings = parseDelegatorSettings(vm);
   MCMCSettings mcmcSettings = parseMCMCSettings(vm);
+  SMCSettings smcSettings = parseSMCSettings(vm);
   DBSettings dbSettings = parseDBSettings(vm);
   dbSettings.recover = vm["recover"].as<bool>();
   WorldSpec worldSpec = parseSpec<WorldSpec>(vm, sensorsEnabled);
@@ -84,62 +217,55 @@ int main(int ac, char* av[])
   applyToSensorsEnabled<getData>(sensorsEnabled, std::ref(sensorId), std::ref(sensorSpecData), std::ref(sensorReadings),
                                  std::cref(worldSpec), std::ref(results), std::cref(vm), std::cref(sensorsEnabled));
 
-  LOG(INFO)<< "Initialise comms";
-  stateline::comms::Delegator delegator(worldSpecData, sensorId, sensorSpecData, sensorReadings, delegatorSettings);
-  delegator.start();
+  if ((mcmcSettings.delayedAcceptance || mcmcSettings.surrogateFeatures > 0) && mcmcSettings.proposalLangevin)
+  {
+    LOG(ERROR)<< "Langevin proposals cannot be combined with delayed acceptance or the surrogate";
+    exit(EXIT_FAILURE);
+  }
 
-  LOG(INFO)<< "Initialise parallel tempering mcmc";
-  GeoAsyncPolicy policy(delegator, prior, sensorsEnabled);
+  if ((mcmcSettings.proposalEnsemble == EnsembleMove::DifferentialEvolution && mcmcSettings.stacks < 3)
+      || (mcmcSettings.proposalEnsemble == EnsembleMove::Stretch && mcmcSettings.stacks < 2))
+  {
+    LOG(ERROR)<< "Too few stacks for the ensemble proposals";
+    exit(EXIT_FAILURE);
+  }
 
-  // Start the sampling
-  LOG(INFO)<< "Starting inversion: Run for " << mcmcSettings.wallTime << " seconds";
-  LOG(INFO)<< "Problem dimensionality: " << prior.size();
-  mcmc::Sampler mcmc(mcmcSettings, dbSettings, prior.size(), global::interruptedBySignal);
+  if (mcmcSettings.targetRHat > 0 && mcmcSettings.stacks < 2)
+  {
+    LOG(ERROR)<< "An R-hat target needs at least 2 stacks";
+    exit(EXIT_FAILURE);
+  }
 
-  std::vector<Eigen::VectorXd> initialThetas;
+  if (mcmcSettings.targetRHat > 0 && mcmcSettings.proposalEnsemble != EnsembleMove::None)
+  {
+    LOG(ERROR)<< "An R-hat target cannot be combined with ensemble proposals, which couple the stacks";
+    exit(EXIT_FAILURE);
+  }
 
-  LOG(INFO)<< "Loading / generating initial thetas for the chains";
+  if (smcSettings.particles > 0 && dbSettings.recover)
+  {
+    LOG(ERROR)<< "Population annealing cannot recover a run";
+    exit(EXIT_FAILURE);
+  }
 
-  for (uint s = 0; s < mcmcSettings.stacks; s++)
+  uint annealLength = vm["anneallength"].as<uint>();
+  uint nThreads = vm["nthreads"].as<uint>();
+  if (nThreads > 0)
   {
-    for (uint c = 0; c < mcmcSettings.chains; c++)
-    {
-      if (dbSettings.recover && !mcmc.chains().states(s * mcmcSettings.chains + c).empty())
-      {
-        initialThetas.push_back(mcmc.chains().states(s * mcmcSettings.chains + c)[0].sample);
-      } else
-      {
-        uint nSamples = vm["anneallength"].as<uint>();
-        std::vector<Eigen::VectorXd> thetas(nSamples);
-        double lowestEnergy = std::numeric_limits<double>::max();
-        uint bestIndex = 0;
-        for ( uint i=0; i<nSamples; i++)
-        {
-          Eigen::VectorXd cand = prior.sample(gen);
-          thetas[i] = cand;
-          policy.submit(i,cand);
-        }
-        for (uint i=0; i<nSamples; i++)
-        {
-          auto result = policy.retrieve();
-          uint id = result.first;
-          double energy = result.second;
-          if (energy < lowestEnergy)
-          {
-            bestIndex = id;
-            lowestEnergy = energy;
-            LOG(INFO) << "stack "<< s << " chain " << c << " best energy: " << lowestEnergy;
-          }
-        }
-        initialThetas.push_back(thetas[bestIndex]);
-      }
-    }
+    LOG(INFO)<< "Initialise parallel tempering mcmc on " << nThreads << " local threads";
+    GlobalSpec globalSpec = parseSpec<GlobalSpec>(vm, sensorsEnabled);
+    LocalAsyncPolicy policy(globalSpec, results, prior, sensorsEnabled, nThreads, mcmcSettings.proposalLangevin);
+    runInversion(policy, prior, mcmcSettings, smcSettings, dbSettings, annealLength);
+    return 0;
   }
 
-  
-  auto proposal = std::bind(&mcmc::adaptiveGaussianProposal,ph::_1, ph::_2,
-                            prior.world.thetaMinBound(), prior.world.thetaMaxBound()); 
-  mcmc.run(policy, initialThetas, proposal, mcmcSettings.wallTime);
+  LOG(INFO)<< "Initialise comms";
+  stateline::comms::Delegator delegator(worldSpecData, sensorId, sensorSpecData, sensorReadings, delegatorSettings);
+  delegator.start();
+
+  LOG(INFO)<< "Initialise parallel tempering mcmc";
+  GeoAsyncPolicy policy(delegator, prior, sensorsEnabled, mcmcSettings.proposalLangevin);
+  runInversion(policy, prior, mcmcSettings, smcSettings, dbSettings, annealLength);
 
   // This will gracefully stop all delegators internal threads
   delegator.stop();
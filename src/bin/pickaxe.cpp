@@ -119,7 +119,7 @@ int main(int ac, char* av[])
   dbSettings.recover = true;
   GlobalPrior prior = parsePrior<GlobalPrior>(vm, sensorsEnabled);
   mcmc::Sampler mcmc(mcmcSettings, dbSettings, prior.size(), global::interruptedBySignal);
-  mcmc::ChainArray chains = mcmc.chains();
+  mcmc::ChainArray& chains = mcmc.chains();
   
   // Stuff needed for forward modelling
   GlobalSpec globalSpec = parseSpec<GlobalSpec>(vm, sensorsEnabled);
@@ -152,16 +152,17 @@ int main(int ac, char* av[])
   for (uint id = 0; id < chains.numTotalChains(); id+=chains.numChains())
   {
     // This is the coldest chain in a stack, so we can directly use its samples.
-    for (uint i = burnin; i < chains.length(id); i += nthin + 1)
+    for (mcmc::ChainCursor c = chains.scan(id, burnin, chains.length(id), nthin + 1); !c.done(); c.next())
     {
       if(global::interruptedBySignal)
       {
         quit = true;
         break;
       }
+      uint i = c.index();
       if(i%1000000==0) LOG(INFO)<< "reading state " << i << " of " << chains.length(id) << " in chain " << id;
       // get the state
-      mcmc::State s = chains.state(id, i);
+      const mcmc::State& s = c.state();
       GlobalParams params = prior.reconstruct(s.sample);
       // prior
       double priorLikelihood = prior.evaluate(s.sample);
@@ -76,6 +76,9 @@ bool workerModelThread(stateline::comms::Worker & worker, WorldSpec & worldSpec,
   typename Types<f>::Results trueReadings;
   obsidian::comms::unserialise(worker.jobResults(static_cast<uint>(f)), trueReadings);
 
+  LOG(INFO) << "Generating " << f << " likelihood context";
+  lh::LikelihoodContext<f> context = lh::likelihoodContext<f>(trueReadings, spec);
+
   uint nthreads = vm["nthreads"].as<uint>();
   LOG(INFO)<< "Launching " << nthreads << " worker threads for " << f;
 
@@ -83,7 +86,7 @@ bool workerModelThread(stateline::comms::Worker & worker, WorldSpec & worldSpec,
   for (uint i = 0; i < nthreads; i++)
   {
     threads.push_back(
-        std::async(std::launch::async, workerThread<f>, std::cref(spec), std::cref(cache), std::cref(trueReadings), std::ref(worker)));
+        std::async(std::launch::async, workerThread<f>, std::cref(spec), std::cref(cache), std::cref(context), std::ref(worker)));
   }
   for (auto& t : threads)
   {
@@ -18,6 +18,15 @@ namespace stateline
 {
   namespace comms
   {
+    //! The priority of a job from a requester. Workers ignore the frame.
+    //!
+    //! \param job The JOB message.
+    //! \return The priority, zero if the job has none.
+    //!
+    int jobPriority(const Message& job)
+    {
+      return job.data.size() > 3 ? std::stoi(job.data[3]) : 0;
+    }
 
     Delegator::Delegator(const std::string& commonSpecData, const std::vector<uint>& jobId, const std::vector<std::string>& jobSpecData,
                          const std::vector<std::string>& jobResultsData, const DelegatorSettings& settings)
@@ -28,6 +37,7 @@ namespace stateline
           jobSpecData_(jobSpecData),
           jobResultsData_(jobResultsData),
           jobQueues_(jobId.size()),
+          arrivals_(jobId.size(), 0),
           requestQueues_(jobId.size()),
           heartbeat_(context_, settings.heartbeat)
     {
@@ -149,19 +159,19 @@ namespace stateline
       if (!jobIdMap_.count(id))
         return;
 
-      std::deque<Message>& queue = jobQueues_[jobIdMap_[id]];
+      JobQueue& queue = jobQueues_[jobIdMap_[id]];
       if (!queue.empty())
       {
         std::string worker = msgRequestFromMinion.address.back();
-        //send a job from the job queue
-        Message r = queue.front();
+        //send the most urgent job from the job queue
+        Message r = queue.begin()->second;
         // keep where the job came from, add new destination
         for (auto const& a : msgRequestFromMinion.address)
         {
           r.address.push_back(a);
         }
         router_.send(SocketID::NETWORK, r);
-        workerToJobMap_[worker].push_back(queue.front());
+        workerToJobMap_[worker].push_back(queue.begin()->second);
         queue.erase(queue.begin());
       } else
       {
@@ -196,8 +206,10 @@ namespace stateline
         queue.erase(queue.begin());
       } else
       {
-        jobQueues_[jobIdMap_[id]].push_back(msgJobFromRequester);
+        uint index = jobIdMap_[id];
+        jobQueues_[index].insert(std::make_pair(arrivals_[index] - jobPriority(msgJobFromRequester), msgJobFromRequester));
       }
+      arrivals_[jobIdMap_[id]]++;
     }
 
     void Delegator::disconnectWorker(const Message& goodbyeFromWorker)
@@ -223,13 +235,15 @@ namespace stateline
       }
 
       //remove all the worker's jobs from work in progress queue 
-      //and push them back onto the (appropriate) job queue
+      //and push them back onto the front of the (appropriate) job queue
       for (auto const& j : workerToJobMap_[worker])
       {
         uint id;
         unserialise(j.data[0], id);
         VLOG(1) << "Requeueing " << j << "onto queue " << id;
-        jobQueues_[jobIdMap_[id]].push_front(j);
+        JobQueue& queue = jobQueues_[jobIdMap_[id]];
+        long long turn = queue.empty() ? 0 : queue.begin()->first;
+        queue.insert(queue.begin(), std::make_pair(turn, j));
       }
       // disconnect the worker
       VLOG(1) << "Disconnecting " << worker;
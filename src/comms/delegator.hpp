@@ -12,9 +12,11 @@
 #pragma once
 
 // Standard Library
+#include <deque>
+#include <functional>
+#include <map>
 #include <set>
 #include <string>
-#include <deque>
 // Prerequisites
 #include <glog/logging.h>
 #include <zmq.hpp>
@@ -126,7 +128,11 @@ namespace stateline
       void jobSwap(const Message& m);
 
       //! Receive a new job from the requesters, and add it to the queue or
-      //! send it directly to an idle worker.
+      //! send it directly to an idle worker. Queued jobs go out in order of
+      //! arrival, except that a job may go ahead of as many of the jobs that
+      //! arrived before it as its priority is above theirs. A job of low
+      //! priority is passed by fewer jobs the longer it waits, so it is never
+      //! starved by jobs of high priority that keep arriving.
       //! 
       //! \param m The JOBSWAP message.
       //!
@@ -145,8 +151,11 @@ namespace stateline
       std::vector<std::string> jobResultsData_;
       // Fault tolerance support
       std::map<std::string, std::vector<Message>> workerToJobMap_;
-      // The queues for jobs
-      std::vector<std::deque<Message>> jobQueues_;
+      // The queues for jobs, by turn: the number of jobs that arrived before
+      // a job, less its priority
+      typedef std::multimap<long long, Message> JobQueue;
+      std::vector<JobQueue> jobQueues_;
+      std::vector<long long> arrivals_;
       std::vector<std::deque<std::vector<std::string>>>requestQueues_;
     std::map<uint, uint> jobIdMap_;
     // Heartbeating System
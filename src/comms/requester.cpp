@@ -29,14 +29,16 @@ namespace stateline
     //! Send a job over a ZMQ socket.
     //!
     //! \param socket The socket to send the job over.
+    //! \param ids The ids to return the result with.
     //! \param job The job to send.
+    //! \param priority The priority of the job in the delegator's queue.
     //!
-    void sendJob(zmq::socket_t& socket, const std::vector<uint>& ids, const JobData& job)
+    void sendJob(zmq::socket_t& socket, const std::vector<uint>& ids, const JobData& job, int priority)
     {
       std::vector<std::string> idStrings;
       for (auto i : ids)
         idStrings.push_back(std::to_string(i));
-      Message m(idStrings, stateline::comms::JOB, { serialise(job.type), job.globalData, job.jobData });
+      Message m(idStrings, stateline::comms::JOB, { serialise(job.type), job.globalData, job.jobData, std::to_string(priority) });
       send(socket, m);
     }
 
@@ -86,9 +88,9 @@ namespace stateline
     }
     ;
 
-    void Requester::submit(uint id, const JobData& j)
+    void Requester::submit(uint id, const JobData& j, int priority)
     {
-      sendJob(socket_, { id }, j);
+      sendJob(socket_, { id }, j, priority);
     }
 
     std::pair<uint, ResultData> Requester::retrieve()
@@ -115,7 +117,7 @@ namespace stateline
     }
     ;
 
-    void Requester::batchSubmit(uint id, const std::vector<JobData>& jobs)
+    void Requester::batchSubmit(uint id, const std::vector<JobData>& jobs, int priority)
     {
       uint nJobs = jobs.size();
       batches_.insert(std::make_pair(id, std::vector<ResultData>(nJobs)));
@@ -123,7 +125,7 @@ namespace stateline
       batchNComplete_.insert(std::make_pair(id, 0));
       for (uint i = 0; i < nJobs; i++)
       {
-        sendJob(socket_, { id, i }, jobs[i]);
+        sendJob(socket_, { id, i }, jobs[i], priority);
       }
     }
 
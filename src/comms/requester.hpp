@@ -64,8 +64,10 @@ namespace stateline
       //!
       //! \param id The job ID.
       //! \param j The job to compute.
+      //! \param priority Queued jobs with a higher priority go to the workers
+      //!        first.
       //!
-      void submit(uint id, const JobData& j);
+      void submit(uint id, const JobData& j, int priority = 0);
 
       //! Retrieves a job that has previously been submitted for computation.
       //! A pair is returned, with the id of the job (from the submit call),
@@ -102,9 +104,10 @@ namespace stateline
       //!
       //! \param id The id of the batch
       //! \param jobs The vector of jobs to compute
-      //! \return The results of the job computations
+      //! \param priority Queued jobs with a higher priority go to the workers
+      //!        first.
       //!
-      void batchSubmit(uint id, const std::vector<JobData>& jobs);
+      void batchSubmit(uint id, const std::vector<JobData>& jobs, int priority = 0);
 
       //! Retrieves a batch of jobs that have previously been submitted for computation.
       //! A pair is returned, with the id of the batch (from the submit call),
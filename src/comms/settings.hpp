@@ -60,6 +60,18 @@ namespace stateline
     HeartbeatSettings heartbeat;
   };
 
+  //! How the states of the chains are stored.
+  //!
+  enum class ChainStore
+  {
+    //! One database entry per state.
+    LevelDB,
+
+    //! Append-only segment files of columns, one file per chain, next to the
+    //! database (see mcmc::SegmentFile).
+    Segments
+  };
+
   //! Settings for interacting with the MCMC database.
   //!
   struct DBSettings
@@ -72,6 +84,59 @@ namespace stateline
 
     //! The size of the database cache in megabytes.
     double cacheSizeMB;
+
+    //! The number of flushed chain caches that can wait to be written before
+    //! the sampler waits for the disk. Zero writes them on the sampler thread.
+    uint writeQueueLength;
+
+    //! How new runs store the states of the chains. Recovered runs carry on
+    //! with the store they were started with.
+    ChainStore chainStore;
+  };
+
+  //! Ensemble proposals that move a chain using the states of the chains at
+  //! the same temperature in the other stacks.
+  //!
+  enum class EnsembleMove
+  {
+    //! No ensemble proposals.
+    None,
+
+    //! Differential evolution (DE-MC): step along the difference of two
+    //! other chains.
+    DifferentialEvolution,
+
+    //! Affine-invariant stretch move towards or away from another chain.
+    Stretch
+  };
+
+  //! How the blocks of a block-wise (Metropolis-within-Gibbs) update are
+  //! chosen.
+  //!
+  enum class BlockUpdate
+  {
+    //! Every proposal moves all of the parameters.
+    None,
+
+    //! Each chain cycles through the blocks in order.
+    Cycle,
+
+    //! Each proposal moves a block chosen at random.
+    Random
+  };
+
+  //! How the sampler orders its jobs when there are more than the workers
+  //! can take at once.
+  //!
+  enum class JobPriority
+  {
+    //! First come, first served.
+    None,
+
+    //! Colder chains first, as only the coldest chains' samples are kept.
+    //! Proposals of the hotter chains are passed by fewer proposals the
+    //! longer they wait, so they are never starved.
+    Coldest
   };
 
   //! Settings for Markov Chain Monte Carlo simulations.
@@ -87,7 +152,28 @@ namespace stateline
     //! Maximum time the simulation should run for.
     uint wallTime;
 
-    //! The number of samples between swap attempts.
+    //! Stop once the potential scale reduction of every dimension is below
+    //! this. Zero disables the target. Needs at least 2 stacks, and cannot
+    //! be combined with ensemble proposals, which couple the stacks.
+    double targetRHat;
+
+    //! Stop once the effective sample size of every dimension of the
+    //! coldest chains is above this. Zero disables the target.
+    double targetEss;
+
+    //! Seconds between flushing all chains to the database so a run can be
+    //! recovered. Zero only flushes when the caches fill and at the end.
+    uint checkpointInterval;
+
+    //! The endpoint the sampler publishes its metrics on, e.g. tcp://*:5556.
+    //! Empty disables publishing.
+    std::string metricsEndpoint;
+
+    //! Milliseconds between metrics messages.
+    uint metricsInterval;
+
+    //! The number of samples every chain in a stack adds in a sweep. Each
+    //! pair of neighbouring chains tries to swap every other sweep.
     uint swapInterval;
 
     //! The number of samples from the beginning 
@@ -122,6 +208,33 @@ namespace stateline
     //! The number of samples between each attempt to adapt the proposal width.
     uint proposalAdaptInterval;
 
+    //! The number of samples the initial isotropic proposal covariance is
+    //! worth. The running covariance of the chain then shapes the proposals.
+    //! Zero keeps the proposals isotropic.
+    uint proposalCovarianceLength;
+
+    //! Whether to use Langevin (MALA) proposals that follow the gradient of
+    //! the energy, where the policy provides one.
+    bool proposalLangevin;
+
+    //! The kind of ensemble proposal, if any. The other chains keep moving
+    //! while a proposal is evaluated, so the moves only approximately keep
+    //! the target; see Sampler::ensembleProposal.
+    EnsembleMove proposalEnsemble;
+
+    //! The fraction of proposals that are ensemble proposals. The rest use
+    //! the usual proposal.
+    double proposalEnsembleRate;
+
+    //! Whether the usual proposals move one block of parameters at a time,
+    //! each with its own adapted width, and how the block is chosen.
+    BlockUpdate proposalBlocks;
+
+    //! The seed of the random generators of the chains. Zero picks one at
+    //! random. The seed is stored with the chains, so a recovered run keeps
+    //! the seed it started with.
+    uint seed;
+
     //! The optimal swap rate for any of the chains.
     double betaOptimalSwapRate;
 
@@ -141,6 +254,56 @@ namespace stateline
 
     //! The initial temperature ladder factor.
     double initialTempFactor;
+
+    //! Whether proposals are first screened with a cheap energy before being
+    //! sent to the forward models (delayed acceptance).
+    bool delayedAcceptance;
+
+    //! How many steps ahead each chain evaluates the proposals it would make
+    //! after each outcome of its outstanding proposal. Zero disables it.
+    uint speculationDepth;
+
+    //! The order the chains' proposals are evaluated in when jobs queue up.
+    //! Speculative proposals always come after the others.
+    JobPriority jobPriority;
+
+    //! The number of random features of the learned surrogate of the energy
+    //! that screens proposals. Zero disables the surrogate.
+    uint surrogateFeatures;
+
+    //! The length scale of the surrogate, in standard deviations of the
+    //! states it is fitted to.
+    double surrogateLengthScale;
+
+    //! The largest standard deviation of a surrogate prediction that is
+    //! still used for screening.
+    double surrogateMaxError;
+
+    //! The number of most recent evaluations the surrogate is fitted to.
+    uint surrogateTrainingLength;
+
+    //! The number of evaluations between refits of the surrogate. Each fit
+    //! runs in the background and is put in use at the next refit; if it has
+    //! not finished by then, the sampler waits for it, so runs with the same
+    //! seed still replay.
+    uint surrogateRefitInterval;
+  };
+
+  //! Settings for population annealing, a sequential Monte Carlo sampler
+  //! that anneals a population of particles from the prior to the posterior.
+  //!
+  struct SMCSettings
+  {
+    //! The number of particles. Zero samples with parallel tempering instead.
+    uint particles;
+
+    //! Each step in inverse temperature is as large as possible while the
+    //! effective sample size of the reweighted particles stays above this
+    //! fraction of the particles.
+    double essFraction;
+
+    //! The number of Metropolis moves each particle makes after resampling.
+    uint moves;
   };
 
 }
@@ -248,6 +248,83 @@ namespace stateline
         { serialise(0), "JOBDATA2"});
     EXPECT_EQ(rep,realRep);
   }
+
+  TEST_F(Delegation, priorityJob)
+  {
+    Delegator& delegator(*pDelegator);
+    // Fake requester 
+    zmq::socket_t requester(delegator.zmqContext(), ZMQ_DEALER);
+    auto requesterID = randomSocketID();
+    setSocketID(requesterID, requester);
+    requester.connect(DELEGATOR_SOCKET_ADDR.c_str());
+    // Fake Worker
+    zmq::socket_t worker(delegator.zmqContext(), ZMQ_DEALER);
+    auto workerID = randomSocketID();
+    setSocketID(workerID, worker);
+    std::vector<uint> jobList =
+    { 0};
+    worker.connect("tcp://localhost:5555");
+    // Both jobs queue up before the worker asks for one
+    send(requester, Message(JOB,
+            { serialise(0), "GLOBAL", "LOW", "0"}));
+    send(requester, Message(JOB,
+            { serialise(0), "GLOBAL", "HIGH", "5"}));
+    send(worker, Message(HELLO,
+            { serialise(jobList)}));
+    receive(worker); // problemSpec
+    send(worker, Message(JOBREQUEST,
+            { serialise(0)}));
+    auto rep = receive(worker); // job
+    delegator.stop();
+
+    Message realRep(
+        { requesterID}, JOB,
+        { serialise(0), "GLOBAL", "HIGH", "5"});
+    EXPECT_EQ(rep,realRep);
+  }
+
+  TEST_F(Delegation, agedJob)
+  {
+    Delegator& delegator(*pDelegator);
+    // Fake requester 
+    zmq::socket_t requester(delegator.zmqContext(), ZMQ_DEALER);
+    auto requesterID = randomSocketID();
+    setSocketID(requesterID, requester);
+    requester.connect(DELEGATOR_SOCKET_ADDR.c_str());
+    // Fake Worker
+    zmq::socket_t worker(delegator.zmqContext(), ZMQ_DEALER);
+    auto workerID = randomSocketID();
+    setSocketID(workerID, worker);
+    std::vector<uint> jobList =
+    { 0};
+    worker.connect("tcp://localhost:5555");
+    // A job of low priority queues up, then jobs of high priority keep arriving
+    send(requester, Message(JOB,
+            { serialise(0), "GLOBAL", "LOW", "0"}));
+    for (uint i = 0; i < 4; i++)
+    {
+      send(requester, Message(JOB,
+              { serialise(0), "GLOBAL", "HIGH", "2"}));
+    }
+    send(worker, Message(HELLO,
+            { serialise(jobList)}));
+    receive(worker); // problemSpec
+    std::vector<std::string> served;
+    for (uint i = 0; i < 3; i++)
+    {
+      send(worker, Message(JOBREQUEST,
+              { serialise(0)}));
+      served.push_back(receive(worker).data[2]);
+      send(requester, Message(JOB,
+              { serialise(0), "GLOBAL", "HIGH", "2"}));
+    }
+    delegator.stop();
+
+    // The first job of high priority passes it, but the ones after it
+    // arrived too late
+    std::vector<std::string> realServed = { "HIGH", "LOW", "HIGH" };
+    EXPECT_EQ(served, realServed);
+  }
 }
  // namespace comms
 }//namespace obsidian
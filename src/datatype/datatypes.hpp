@@ -95,4 +95,57 @@ namespace obsidian
     return g.therm;
   }
 
+  //! For accessing the subfield of one forward model in any of the global
+  //! types, e.g. GlobalField<ForwardModel::GRAVITY>::of(spec) is spec.grav.
+  //!
+  template<ForwardModel f> struct GlobalField;
+
+  template<> struct GlobalField<ForwardModel::GRAVITY>
+  {
+    template<typename T> static auto of(T& g) -> decltype((g.grav))
+    {
+      return g.grav;
+    }
+  };
+
+  template<> struct GlobalField<ForwardModel::MAGNETICS>
+  {
+    template<typename T> static auto of(T& g) -> decltype((g.mag))
+    {
+      return g.mag;
+    }
+  };
+
+  template<> struct GlobalField<ForwardModel::MTANISO>
+  {
+    template<typename T> static auto of(T& g) -> decltype((g.mt))
+    {
+      return g.mt;
+    }
+  };
+
+  template<> struct GlobalField<ForwardModel::SEISMIC1D>
+  {
+    template<typename T> static auto of(T& g) -> decltype((g.s1d))
+    {
+      return g.s1d;
+    }
+  };
+
+  template<> struct GlobalField<ForwardModel::CONTACTPOINT>
+  {
+    template<typename T> static auto of(T& g) -> decltype((g.cpoint))
+    {
+      return g.cpoint;
+    }
+  };
+
+  template<> struct GlobalField<ForwardModel::THERMAL>
+  {
+    template<typename T> static auto of(T& g) -> decltype((g.therm))
+    {
+      return g.therm;
+    }
+  };
+
 } // namespace obsidian
@@ -45,6 +45,12 @@ namespace obsidian
   struct GravParams
   {
     bool returnSensorData;
+
+    /**
+     * Whether to return the gradient of the likelihood with respect to the
+     * world parameters
+     */
+    bool returnGradient;
   };
 
   /**
@@ -58,6 +64,12 @@ namespace obsidian
      * Vector of (z-axis) gravity readings -- may be empty
      */
     Eigen::VectorXd readings;
+
+    /**
+     * Gradient of the likelihood with respect to the world parameters -- empty
+     * unless requested
+     */
+    WorldParams gradient;
   };
 
   template<>
@@ -50,6 +50,12 @@ namespace obsidian
   struct MagParams
   {
     bool returnSensorData;
+
+    /**
+     * Whether to return the gradient of the likelihood with respect to the
+     * world parameters
+     */
+    bool returnGradient;
   };
 
   /**
@@ -64,6 +70,12 @@ namespace obsidian
      */
     Eigen::VectorXd readings;
 
+    /**
+     * Gradient of the likelihood with respect to the world parameters -- empty
+     * unless requested
+     */
+    WorldParams gradient;
+
   };
 
   template<>
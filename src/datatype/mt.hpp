@@ -51,6 +51,12 @@ namespace obsidian
   {
     std::vector<world::InterpolatorSpec> boundaryInterpolation;
     world::Query query;
+
+    /**
+     * Station indices grouped by identical frequency sets. The MT layer terms
+     * are shared by all stations of a group.
+     */
+    std::vector<std::vector<uint>> freqGroups;
   };
 
   /**
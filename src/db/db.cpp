@@ -22,7 +22,8 @@ namespace stateline
   namespace db
   {
     Database::Database(const DBSettings& s)
-        : cacheNumBytes_(s.cacheSizeMB * 1048576)
+        : settings_(s),
+          cacheNumBytes_(s.cacheSizeMB * 1048576)
     {
       options_.block_cache = leveldb::NewLRUCache(cacheNumBytes_); // Cache in MB
       options_.filter_policy = leveldb::NewBloomFilterPolicy(10); // smart filtering -- bits per key?
@@ -53,6 +54,11 @@ namespace stateline
       writeOptions_.sync = false;
     }
 
+    const DBSettings& Database::settings() const
+    {
+      return settings_;
+    }
+
     uint Database::cacheSize()
     {
       return cacheNumBytes_;
@@ -66,6 +72,14 @@ namespace stateline
       return s;
     }
 
+    bool Database::contains(const leveldb::Slice& key)
+    {
+      std::string s;
+      leveldb::Status status = db_->Get(readOptions_, key, &s);
+      CHECK(status.ok() || status.IsNotFound()) << "key is " << key.ToString();
+      return status.ok();
+    }
+
     void Database::put(const leveldb::Slice& key, const leveldb::Slice& value)
     {
       leveldb::Status status = db_->Put(writeOptions_, key, value);
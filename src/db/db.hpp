@@ -33,6 +33,12 @@ namespace stateline
       //!
       ~Database();
 
+      //! Get the settings the database was opened with.
+      //!
+      //! \return The database settings.
+      //!
+      const DBSettings& settings() const;
+
       //! Get the cache size.
       //!
       //! \return The cache size in bytes.
@@ -46,6 +52,13 @@ namespace stateline
       //!
       std::string get(const leveldb::Slice& key);
 
+      //! Check whether the database has an entry for a particular key.
+      //!
+      //! \param key The key for the entry.
+      //! \return True if the entry exists.
+      //!
+      bool contains(const leveldb::Slice& key);
+
       //! Write an entry to the database.
       //!
       //! \param key The key for the entry.
@@ -74,6 +87,7 @@ namespace stateline
       void swap(const std::vector<std::string>& keys1, const std::vector<std::string>& keys2);
 
     private:
+      DBSettings settings_;
       uint cacheNumBytes_;
       leveldb::DB* db_;
       leveldb::Options options_;
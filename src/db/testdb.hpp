@@ -28,6 +28,8 @@ namespace stateline
         settings.directory = path;
         settings.recover = false;
         settings.cacheSizeMB = 1.0;
+        settings.writeQueueLength = 4;
+        settings.chainStore = ChainStore::LevelDB;
         boost::filesystem::remove_all(path);
       }
       ~DB()
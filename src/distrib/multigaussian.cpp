@@ -70,6 +70,12 @@ namespace obsidian
       return -0.5 * (logDetSig + dataFit + norm);
     }
 
+    Eigen::VectorXd logPDFGradient(const Eigen::VectorXd& theta, const MultiGaussian& input)
+    {
+      Eigen::VectorXd fitTerm = input.sigLInv * (theta - input.mu);
+      return -input.sigLInv.transpose() * fitTerm;
+    }
+
     double uniformLogPDF(const Eigen::MatrixXd& theta, const MultiGaussian& input, const Eigen::MatrixXd& thetaMins,
                          const Eigen::MatrixXd& thetaMaxs)
     {
@@ -62,6 +62,10 @@ namespace obsidian
     double logPDF(const Eigen::VectorXd& theta, const MultiGaussian& input, const Eigen::VectorXd& thetaMin,
                   const Eigen::VectorXd& thetaMax);
 
+    //! Compute the gradient of the log PDF of a multivariate Gaussian
+    //! distribution. The bounds are not taken into account.
+    Eigen::VectorXd logPDFGradient(const Eigen::VectorXd& theta, const MultiGaussian& input);
+
     double uniformLogPDF(const Eigen::MatrixXd& theta, const MultiGaussian& input, const Eigen::MatrixXd& thetaMins,
                          const Eigen::MatrixXd& thetaMaxs);
 
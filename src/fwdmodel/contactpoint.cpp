@@ -26,10 +26,14 @@ namespace obsidian
     ContactPointCache generateCache<ForwardModel::CONTACTPOINT>(const std::vector<world::InterpolatorSpec>& boundaryInterpolation,
                                                                 const WorldSpec& worldSpec, const ContactPointSpec& spec)
     {
+      // Each contact point only needs the boundaries down to its deepest interface
+      Eigen::VectorXi deepest(spec.locations.rows());
+      for (uint location = 0; location < spec.locations.rows(); location++)
+        deepest(location) = spec.interfaces[location].size() > 0 ? spec.interfaces[location].maxCoeff() : -1;
       return
       {
         boundaryInterpolation,
-        world::Query(boundaryInterpolation, worldSpec, spec.locations.leftCols(2))
+        world::Query(boundaryInterpolation, worldSpec, spec.locations.leftCols(2), deepest)
       };
     }
 
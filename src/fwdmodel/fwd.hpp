@@ -41,6 +41,42 @@ namespace obsidian
     typename Types<f>::Results forwardModel(const typename Types<f>::Spec& spec, const typename Types<f>::Cache& cache,
                                             const WorldParams& world);
 
+    //! Run a particular forward model for a job with parameters. Forward
+    //! models that can skip work based on the parameters (e.g. when the
+    //! sensor data is not returned) specialise this; by default the
+    //! parameters are ignored.
+    //!
+    //! \param spec The forward model specification.
+    //! \param cache The forward model cache generated by generateCache().
+    //! \param world The world model parameters.
+    //! \param params The forward model parameters.
+    //! \returns Forward model results.
+    //!
+    template<ForwardModel f>
+    typename Types<f>::Results forwardModel(const typename Types<f>::Spec& spec, const typename Types<f>::Cache& cache,
+                                            const WorldParams& world, const typename Types<f>::Params& params)
+    {
+      return forwardModel<f>(spec, cache, world);
+    }
+
+    //! Chain a gradient with respect to the readings of a forward model back
+    //! to the world model parameters. Only the linear forward models (gravity
+    //! and magnetics) specialise this.
+    //!
+    //! \param spec The forward model specification.
+    //! \param cache The forward model cache generated by generateCache().
+    //! \param world The world model parameters.
+    //! \param readingsGradient The gradient with respect to each reading.
+    //! \returns The gradient with respect to the world model parameters.
+    //!
+    template<ForwardModel f>
+    WorldParams forwardModelGradient(const typename Types<f>::Spec& spec, const typename Types<f>::Cache& cache,
+                                     const WorldParams& world, const Eigen::VectorXd& readingsGradient);
+
+    template<>
+    MtAnisoResults forwardModel<ForwardModel::MTANISO>(const MtAnisoSpec& spec, const MtAnisoCache& cache, const WorldParams& world,
+                                                       const MtAnisoParams& params);
+
     namespace detail
     {
       //! Constant representing the imaginary number i.
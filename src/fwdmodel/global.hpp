@@ -24,7 +24,7 @@ namespace obsidian
     //! \param spec The global world specifications.
     //! \returns Cache object containing the caches of all the forward models.
     //!
-    GlobalCache generateGlobalCache(const std::vector<world::InterpolatorSpec>& boundaryInterpolation, const GlobalSpec& spec,
+    inline GlobalCache generateGlobalCache(const std::vector<world::InterpolatorSpec>& boundaryInterpolation, const GlobalSpec& spec,
                                     const std::set<ForwardModel>& enabled)
     {
       return
@@ -45,7 +45,7 @@ namespace obsidian
     //! \param params The global world parameters.
     //! \returns Results of all the forward models.
     //!
-    GlobalResults forwardModelAll(const GlobalSpec& spec, const GlobalCache& cache, const GlobalParams& params,
+    inline GlobalResults forwardModelAll(const GlobalSpec& spec, const GlobalCache& cache, const GlobalParams& params,
                                   const std::set<ForwardModel>& enabled)
     {
       return
@@ -62,6 +62,26 @@ namespace obsidian
       return results;
     }
 
+    //! Chain a gradient with respect to the gravity readings back to the
+    //! world model parameters.
+    //!
+    //! \param spec The forward model specification.
+    //! \param cache The forward model cache generated by generateCache().
+    //! \param world The world model parameters.
+    //! \param readingsGradient The gradient with respect to each reading.
+    //! \returns The gradient with respect to the world model parameters.
+    //!
+    template<>
+    WorldParams forwardModelGradient<ForwardModel::GRAVITY>(const GravSpec& spec, const GravCache& cache, const WorldParams& world,
+                                                            const Eigen::VectorXd& readingsGradient)
+    {
+      Eigen::VectorXd flatGradient = fwd::computeFieldGradient(cache.sensitivityMatrix, cache.sensorIndices, cache.sensorWeights,
+                                                               readingsGradient);
+      const world::Query& query = cache.query;
+      Eigen::MatrixXd densityGradient = Eigen::Map<Eigen::MatrixXd>(flatGradient.data(), query.edgeZ.rows() - 1, query.numPoints());
+      return world::getVoxelsGradient(cache.boundaryInterpolation, world, query, RockProperty::Density, densityGradient);
+    }
+
     namespace detail
     {
       //! Computes the sensitivity for a particular point in the gravity.
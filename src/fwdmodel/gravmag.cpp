@@ -120,6 +120,17 @@ namespace obsidian
       return outField;
     }
 
+    Eigen::VectorXd computeFieldGradient(const Eigen::MatrixXd &sens, const Eigen::MatrixXi &sensorIndices,
+                                         const Eigen::MatrixXd &sensorWeights, const Eigen::VectorXd &fieldGradient)
+    {
+      Eigen::VectorXd rawGradient = Eigen::VectorXd::Zero(sens.rows());
+      uint nQuery = sensorWeights.rows();
+      for (uint i = 0; i < nQuery; i++)
+        for (uint j = 0; j < 4; j++)
+          rawGradient(sensorIndices(i, j)) += fieldGradient(i) * sensorWeights(i, j);
+      return sens.transpose() * rawGradient;
+    }
+
     namespace detail
     {
       //! Data structure to represent a 3D array.
@@ -50,6 +50,19 @@ namespace obsidian
     Eigen::VectorXd computeField(const Eigen::MatrixXd &sens, const Eigen::MatrixXi sensorIndices, const Eigen::MatrixXd sensorWeights,
                                  const Eigen::VectorXd &properties);
 
+    //! Chains a gradient with respect to the field values of computeField()
+    //! back to the rock properties of the voxels. The field is linear in the
+    //! properties, so this is the transpose of the sensitivity.
+    //!
+    //! \param sens The gravity or magnetic sensitivity matrix.
+    //! \param sensorIndices The indices of each of the sensors.
+    //! \param sensorWeights The weights of each of the sensors.
+    //! \param fieldGradient The gradient with respect to each sensor reading.
+    //! \return The gradient with respect to the flattened voxel properties.
+    //!
+    Eigen::VectorXd computeFieldGradient(const Eigen::MatrixXd &sens, const Eigen::MatrixXi &sensorIndices,
+                                         const Eigen::MatrixXd &sensorWeights, const Eigen::VectorXd &fieldGradient);
+
     namespace detail
     {
       //! A small number added to denominators to prevent them from being zero.
@@ -67,6 +67,26 @@ namespace obsidian
       return results;
     }
 
+    //! Chain a gradient with respect to the magnetic readings back to the
+    //! world model parameters.
+    //!
+    //! \param spec The forward model specification.
+    //! \param cache The forward model cache generated by generateCache().
+    //! \param world The world model parameters.
+    //! \param readingsGradient The gradient with respect to each reading.
+    //! \returns The gradient with respect to the world model parameters.
+    //!
+    template<>
+    WorldParams forwardModelGradient<ForwardModel::MAGNETICS>(const MagSpec& spec, const MagCache& cache, const WorldParams& world,
+                                                              const Eigen::VectorXd& readingsGradient)
+    {
+      Eigen::VectorXd flatGradient = fwd::computeFieldGradient(cache.sensitivityMatrix, cache.sensorIndices, cache.sensorWeights,
+                                                               readingsGradient);
+      const world::Query& query = cache.query;
+      Eigen::MatrixXd susceptGradient = Eigen::Map<Eigen::MatrixXd>(flatGradient.data(), query.edgeZ.rows() - 1, query.numPoints());
+      return world::getVoxelsGradient(cache.boundaryInterpolation, world, query, RockProperty::Susceptibility, susceptGradient);
+    }
+
     namespace detail
     {
       //! Calculate the magnetic sensitivity at a particular position
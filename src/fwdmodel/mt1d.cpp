@@ -19,6 +19,13 @@ namespace obsidian
   {
     namespace detail
     {
+      Rotation rotation(double phaseBelow, double phaseAbove)
+      {
+        auto theta = phaseBelow - phaseAbove;
+        auto c = std::cos(theta), s = std::sin(theta);
+        return { c * c, s * s, c * s };
+      }
+
       Eigen::Matrix2cd applyRotation(const Eigen::Matrix2cd &Z, double phaseBelow, double phaseAbove)
       {
         // Calculate the rotation matrix
@@ -31,6 +38,21 @@ namespace obsidian
         return R * Z * R.transpose();
       }
 
+      void applyRotation(const Rotation &r, ComplexFreqBlock &zii, ComplexFreqBlock &zij, ComplexFreqBlock &zji, ComplexFreqBlock &zjj)
+      {
+        // R Z R^T expanded for R = [c s; -s c]
+        ComplexFreqBlock offSum = zij + zji;
+        ComplexFreqBlock diagDiff = zjj - zii;
+        ComplexFreqBlock nii = r.cc * zii + r.cs * offSum + r.ss * zjj;
+        ComplexFreqBlock njj = r.ss * zii - r.cs * offSum + r.cc * zjj;
+        ComplexFreqBlock nij = r.cc * zij - r.ss * zji + r.cs * diagDiff;
+        ComplexFreqBlock nji = r.cc * zji - r.ss * zij + r.cs * diagDiff;
+        zii = nii;
+        zij = nij;
+        zji = nji;
+        zjj = njj;
+      }
+
       double primaryAngle(double y, double x)
       {
         if (fabs(x) < 1e-10)
@@ -56,6 +78,22 @@ namespace obsidian
       return tensor;
     }
 
+    Eigen::MatrixX4d phaseTensorIso1d(const Eigen::MatrixX4cd &Z)
+    {
+      Eigen::MatrixXd tensor = Eigen::MatrixXd::Zero(Z.rows(), 4);
+
+      // With Zxx = Zyy = 0 and Zyx = -Zxy the tensor is diagonal with both
+      // entries equal to tan of the impedance phase
+      for (uint i = 0; i < Z.rows(); i++)
+      {
+        double t = Z(i, 1).imag() / Z(i, 1).real();
+        tensor(i, 0) = t;
+        tensor(i, 3) = t;
+      }
+
+      return tensor;
+    }
+
     Eigen::VectorXd alpha1d(const Eigen::MatrixX4d &tensor)
     {
       Eigen::VectorXd alpha(tensor.rows());
@@ -76,84 +114,165 @@ namespace obsidian
       return beta;
     }
 
-    Eigen::MatrixX4cd impedenceAniso1d(const Eigen::VectorXd &thicknesses, const Eigen::VectorXd &freqs, const Eigen::VectorXd &resx,
-                                       const Eigen::VectorXd &resy, const Eigen::VectorXd &phases)
+    namespace detail
     {
-      int nlayers = thicknesses.rows();
+      MtLayerTerms anisoLayerTerms(const Eigen::VectorXd &freqs, const Eigen::VectorXd &resx, const Eigen::VectorXd &resy,
+                                   const Eigen::VectorXd &phases, int nlayers)
+      {
+        MtLayerTerms terms = isoLayerTerms(freqs, resx, nlayers);
 
-      // The impedance matrix to be filled
-      Eigen::MatrixX4cd zz(freqs.rows(), 4);
+        // The y direction terms only differ by the resistivity and the sign
+        // of the impedance
+        MtLayerTerms yTerms = isoLayerTerms(freqs, resy, nlayers);
+        terms.zprp = -yTerms.zpll;
+        terms.ky = yTerms.kx;
 
-      for (int i = 0; i < freqs.rows(); i++)
-      {
-        // Angular frequency
-        double w = 2 * M_PI * freqs(i);
+        terms.rotations.resize(nlayers);
+        terms.rotations[nlayers - 1] = rotation(phases(nlayers - 2), 0);
+        for (int j = nlayers - 2; j > 0; j--)
+          terms.rotations[j] = rotation(phases(j - 1), phases(j));
+        terms.rotations[0] = rotation(0, phases(0));
 
-        // Start at the bottom layer
-        auto zxp = std::sqrt(detail::MU * w * resx[nlayers - 1]) * std::exp(detail::I * M_PI / 4.0);
-        auto zyp = std::sqrt(detail::MU * w * resy[nlayers - 1]) * std::exp(detail::I * M_PI / 4.0);
+        return terms;
+      }
 
-        Eigen::Matrix2cd Z;
-        Z << 0.0, zxp, -zyp, 0.0;
+      MtLayerTerms isoLayerTerms(const Eigen::VectorXd &freqs, const Eigen::VectorXd &res, int nlayers)
+      {
+        MtLayerTerms terms;
+        terms.nfreqs = freqs.rows();
+        int npadded = (terms.nfreqs + FREQ_BLOCK_SIZE - 1) / FREQ_BLOCK_SIZE * FREQ_BLOCK_SIZE;
+
+        // Square root of MU times the angular frequency. The last block is
+        // padded with its final frequency, and the padding is discarded.
+        Eigen::ArrayXd sqrtMuW(npadded);
+        for (int k = 0; k < npadded; k++)
+          sqrtMuW(k) = std::sqrt(MU * 2 * M_PI * freqs(std::min(k, terms.nfreqs - 1)));
+
+        // With k = sqrt(MU * w / res) * exp(-i pi / 4), the impedances MU * w / k
+        // reduce to sqrt(MU * w) * sqrt(res) * exp(i pi / 4) and exp(-i k th)
+        // to exp(-(1 + i) * a * th) with a = sqrt(MU * w / (2 res)).
+        const std::complex<double> eighthTurn = std::polar(1.0, M_PI / 4.0);
+        const std::complex<double> decay(-1.0, -1.0);
+        terms.zpll.resize(npadded, nlayers);
+        terms.kx.resize(npadded, nlayers);
+        for (int j = 0; j < nlayers; j++)
+        {
+          double sqrtRes = std::sqrt(res(j));
+          terms.zpll.col(j) = (sqrtMuW * sqrtRes).cast<std::complex<double>>() * eighthTurn;
+          terms.kx.col(j) = (sqrtMuW * (M_SQRT1_2 / sqrtRes)).cast<std::complex<double>>() * decay;
+        }
 
-        // Rotate to the next layer's angle
-        Z = detail::applyRotation(Z, phases[nlayers - 2], 0);
+        return terms;
+      }
 
-        std::complex<double> zii = Z(0, 0), zij = Z(0, 1), zji = Z(1, 0), zjj = Z(1, 1);
+      void impedenceAnisoStation(const MtLayerTerms &terms, const Eigen::MatrixXd &thicknesses, uint station, Eigen::MatrixX4cd &zz)
+      {
+        int nlayers = thicknesses.cols();
+        zz.resize(terms.nfreqs, 4);
 
-        // Go through each layer from bottom to top
-        for (int j = nlayers - 2; j >= 0; j--)
+        for (int block = 0; block < terms.nfreqs; block += FREQ_BLOCK_SIZE)
         {
-          double th = thicknesses(j);
+          // Start at the bottom layer
+          ComplexFreqBlock zii = ComplexFreqBlock::Zero();
+          ComplexFreqBlock zij = terms.zpll.col(nlayers - 1).segment<FREQ_BLOCK_SIZE>(block);
+          ComplexFreqBlock zji = terms.zprp.col(nlayers - 1).segment<FREQ_BLOCK_SIZE>(block);
+          ComplexFreqBlock zjj = ComplexFreqBlock::Zero();
 
-          auto ki = std::sqrt(detail::MU * w / resx(j)) * std::exp(-detail::I * M_PI / 4.0);
-          auto kj = std::sqrt(detail::MU * w / resy(j)) * std::exp(-detail::I * M_PI / 4.0);
+          // Rotate to the next layer's angle
+          applyRotation(terms.rotations[nlayers - 1], zii, zij, zji, zjj);
 
-          auto zpll = detail::MU * w / ki;
-          auto zprp = -detail::MU * w / kj;
+          // Go through each layer from bottom to top
+          for (int j = nlayers - 2; j >= 0; j--)
+          {
+            double th = thicknesses(station, j);
 
-          auto phii = zii * zjj / (zij + zpll);
-          auto phij = zii * zjj / (zji + zprp);
+            ComplexFreqBlock zpll = terms.zpll.col(j).segment<FREQ_BLOCK_SIZE>(block);
+            ComplexFreqBlock zprp = terms.zprp.col(j).segment<FREQ_BLOCK_SIZE>(block);
 
-          auto rj = (zji - zprp - phii) / (zji + zprp - phii);
-          auto ri = (zij - zpll - phij) / (zij + zpll - phij);
+            // exp(-i ki th) and exp(-i kj th); every other exponential is a product of these
+            ComplexFreqBlock eki = (terms.kx.col(j).segment<FREQ_BLOCK_SIZE>(block) * th).exp();
+            ComplexFreqBlock ekj = (terms.ky.col(j).segment<FREQ_BLOCK_SIZE>(block) * th).exp();
+            ComplexFreqBlock ekk = eki * ekj;
 
-          auto lj = 2.0 * zpll * zjj / ((zji + zprp) * (zij + zpll - phij));
-          auto li = 2.0 * zprp * zii / ((zij + zpll) * (zji + zprp - phii));
+            ComplexFreqBlock phii = zii * zjj / (zij + zpll);
+            ComplexFreqBlock phij = zii * zjj / (zji + zprp);
 
-          auto l = li * lj * std::exp(detail::I * -2.0 * (ki + kj) * th);
+            ComplexFreqBlock rj = (zji - zprp - phii) / (zji + zprp - phii);
+            ComplexFreqBlock ri = (zij - zpll - phij) / (zij + zpll - phij);
 
-          auto eri = ri * std::exp(detail::I * -2.0 * ki * th);
-          auto erj = rj * std::exp(detail::I * -2.0 * kj * th);
-          auto ekk = std::exp(detail::I * -(ki + kj) * th);
+            ComplexFreqBlock lj = 2.0 * zpll * zjj / ((zji + zprp) * (zij + zpll - phij));
+            ComplexFreqBlock li = 2.0 * zprp * zii / ((zij + zpll) * (zji + zprp - phii));
 
-          // New impedances
-          zii = 2.0 * li * zpll * ekk / ((1.0 - erj) * (1.0 - eri) - l);
-          zij = zpll * (((1.0 + eri) * (1.0 - erj) + l) / ((1.0 - eri) * (1.0 - erj) - l));
-          zji = zprp * (((1.0 + erj) * (1.0 - eri) + l) / ((1.0 - erj) * (1.0 - eri) - l));
-          zjj = 2.0 * lj * zprp * ekk / ((1.0 - erj) * (1.0 - eri) - l);
+            ComplexFreqBlock l = li * lj * ekk * ekk;
 
-          Z << zii, zij, zji, zjj;
+            ComplexFreqBlock eri = ri * eki * eki;
+            ComplexFreqBlock erj = rj * ekj * ekj;
+            ComplexFreqBlock denom = (1.0 - erj) * (1.0 - eri) - l;
 
-          // Rotate to the orientation of the next layer
-          if (j > 0)
+            // New impedances
+            zii = 2.0 * li * zpll * ekk / denom;
+            zij = zpll * (((1.0 + eri) * (1.0 - erj) + l) / denom);
+            zji = zprp * (((1.0 + erj) * (1.0 - eri) + l) / denom);
+            zjj = 2.0 * lj * zprp * ekk / denom;
+
+            // Rotate to the orientation of the next layer
+            applyRotation(terms.rotations[j], zii, zij, zji, zjj);
+          }
+
+          // Handle top layer
+          double scale = 1e-3 / MU;
+          for (int k = 0; k < FREQ_BLOCK_SIZE && block + k < terms.nfreqs; k++)
           {
-            Z = detail::applyRotation(Z, phases(j - 1), phases(j));
-          } else
+            zz.row(block + k) << zii(k) * scale, zij(k) * scale, zji(k) * scale, zjj(k) * scale;
+          }
+        }
+      }
+
+      void impedenceIsoStation(const MtLayerTerms &terms, const Eigen::MatrixXd &thicknesses, uint station, Eigen::MatrixX4cd &zz)
+      {
+        int nlayers = thicknesses.cols();
+        zz.resize(terms.nfreqs, 4);
+
+        for (int block = 0; block < terms.nfreqs; block += FREQ_BLOCK_SIZE)
+        {
+          // Start at the bottom layer
+          ComplexFreqBlock z = terms.zpll.col(nlayers - 1).segment<FREQ_BLOCK_SIZE>(block);
+
+          // Go through each layer from bottom to top
+          for (int j = nlayers - 2; j >= 0; j--)
           {
-            // Handle top layer
-            Z = detail::applyRotation(Z, 0, phases(j)) * 1e-3 / detail::MU;
+            ComplexFreqBlock zp = terms.zpll.col(j).segment<FREQ_BLOCK_SIZE>(block);
+            ComplexFreqBlock ek = (terms.kx.col(j).segment<FREQ_BLOCK_SIZE>(block) * thicknesses(station, j)).exp();
+            ComplexFreqBlock er = (z - zp) / (z + zp) * ek * ek;
+            z = zp * (1.0 + er) / (1.0 - er);
           }
 
-          zii = Z(0, 0);
-          zij = Z(0, 1);
-          zji = Z(1, 0);
-          zjj = Z(1, 1);
+          // Handle top layer
+          double scale = 1e-3 / MU;
+          for (int k = 0; k < FREQ_BLOCK_SIZE && block + k < terms.nfreqs; k++)
+          {
+            zz.row(block + k) << 0.0, z(k) * scale, -z(k) * scale, 0.0;
+          }
         }
-
-        zz.row(i) << zii, zij, zji, zjj;
       }
+    }
 
+    Eigen::MatrixX4cd impedenceAniso1d(const Eigen::VectorXd &thicknesses, const Eigen::VectorXd &freqs, const Eigen::VectorXd &resx,
+                                       const Eigen::VectorXd &resy, const Eigen::VectorXd &phases)
+    {
+      Eigen::MatrixXd stationThicknesses = thicknesses.transpose();
+      detail::MtLayerTerms terms = detail::anisoLayerTerms(freqs, resx, resy, phases, thicknesses.rows());
+      Eigen::MatrixX4cd zz;
+      detail::impedenceAnisoStation(terms, stationThicknesses, 0, zz);
+      return zz;
+    }
+
+    Eigen::MatrixX4cd impedenceIso1d(const Eigen::VectorXd &thicknesses, const Eigen::VectorXd &freqs, const Eigen::VectorXd &res)
+    {
+      Eigen::MatrixXd stationThicknesses = thicknesses.transpose();
+      detail::MtLayerTerms terms = detail::isoLayerTerms(freqs, res, thicknesses.rows());
+      Eigen::MatrixX4cd zz;
+      detail::impedenceIsoStation(terms, stationThicknesses, 0, zz);
       return zz;
     }
 
@@ -168,11 +287,29 @@ namespace obsidian
     MtAnisoCache generateCache<ForwardModel::MTANISO>(const std::vector<world::InterpolatorSpec>& boundaryInterpolation,
                                                       const WorldSpec& worldSpec, const MtAnisoSpec& mtSpec)
     {
-      return
+      MtAnisoCache cache =
       {
         boundaryInterpolation,
-        world::Query(boundaryInterpolation, worldSpec, mtSpec.locations.leftCols(2))
+        world::Query(boundaryInterpolation, worldSpec, mtSpec.locations.leftCols(2)),
+        {}
       };
+
+      // Group the stations that share a frequency set
+      for (uint i = 0; i < mtSpec.freqs.size(); i++)
+      {
+        const Eigen::VectorXd &freqs = mtSpec.freqs[i];
+        uint g = 0;
+        for (; g < cache.freqGroups.size(); g++)
+        {
+          const Eigen::VectorXd &groupFreqs = mtSpec.freqs[cache.freqGroups[g][0]];
+          if (groupFreqs.size() == freqs.size() && groupFreqs == freqs)
+            break;
+        }
+        if (g == cache.freqGroups.size())
+          cache.freqGroups.push_back(std::vector<uint>());
+        cache.freqGroups[g].push_back(i);
+      }
+      return cache;
     }
 
     //! Run a MT forward model.
@@ -184,6 +321,26 @@ namespace obsidian
     //!
     template<>
     MtAnisoResults forwardModel<ForwardModel::MTANISO>(const MtAnisoSpec& spec, const MtAnisoCache& cache, const WorldParams& world)
+    {
+      MtAnisoParams params;
+      params.returnSensorData = true;
+      return forwardModel<ForwardModel::MTANISO>(spec, cache, world, params);
+    }
+
+    //! Run a MT forward model. The stations are evaluated in batches that
+    //! share their frequencies, and the phase tensor outputs are only
+    //! computed when the sensor data is requested. The stations of a batch
+    //! are evaluated in turn, as the workers already run one job per core.
+    //!
+    //! \param spec The forward model specification.
+    //! \param cache The forward model cache generated by generateCache().
+    //! \param world The world model parameters.
+    //! \param params The forward model parameters.
+    //! \returns Forward model results.
+    //!
+    template<>
+    MtAnisoResults forwardModel<ForwardModel::MTANISO>(const MtAnisoSpec& spec, const MtAnisoCache& cache, const WorldParams& world,
+                                                       const MtAnisoParams& params)
     {
       Eigen::MatrixXd transitions = world::getTransitions(cache.boundaryInterpolation, world, cache.query);
       Eigen::MatrixXd thicknesses = world::thickness(transitions); // mqueries x nthicknesses
@@ -191,23 +348,38 @@ namespace obsidian
       Eigen::VectorXd resx = world::extractProperty(world, RockProperty::ResistivityX);
       Eigen::VectorXd resy;
       Eigen::VectorXd phase;
-      if (spec.ignoreAniso)
-      {
-        resy = resx;
-        phase = Eigen::VectorXd::Zero(resy.size());
-      } else
+      if (!spec.ignoreAniso)
       {
         resy = world::extractProperty(world, RockProperty::ResistivityY);
         phase = world::extractProperty(world, RockProperty::ResistivityPhase);
       }
 
       MtAnisoResults results;
-      for (uint i = 0; i < thicknesses.rows(); i++)
+      results.readings.resize(thicknesses.rows());
+      for (const std::vector<uint> &stations : cache.freqGroups)
       {
-        results.readings.push_back(impedenceAniso1d(thicknesses.row(i), spec.freqs[i], resx, resy, phase));
-        results.phaseTensor.push_back(phaseTensor1d(results.readings[i]));
-        results.alpha.push_back(alpha1d(results.phaseTensor[i]));
-        results.beta.push_back(beta1d(results.phaseTensor[i]));
+        const Eigen::VectorXd &freqs = spec.freqs[stations[0]];
+        if (spec.ignoreAniso)
+        {
+          detail::MtLayerTerms terms = detail::isoLayerTerms(freqs, resx, thicknesses.cols());
+          for (uint i : stations)
+            detail::impedenceIsoStation(terms, thicknesses, i, results.readings[i]);
+        } else
+        {
+          detail::MtLayerTerms terms = detail::anisoLayerTerms(freqs, resx, resy, phase, thicknesses.cols());
+          for (uint i : stations)
+            detail::impedenceAnisoStation(terms, thicknesses, i, results.readings[i]);
+        }
+      }
+
+      if (params.returnSensorData)
+      {
+        for (uint i = 0; i < thicknesses.rows(); i++)
+        {
+          results.phaseTensor.push_back(spec.ignoreAniso ? phaseTensorIso1d(results.readings[i]) : phaseTensor1d(results.readings[i]));
+          results.alpha.push_back(alpha1d(results.phaseTensor[i]));
+          results.beta.push_back(beta1d(results.phaseTensor[i]));
+        }
       }
       return results;
     }
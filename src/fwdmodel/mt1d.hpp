@@ -30,14 +30,91 @@ namespace obsidian
     Eigen::MatrixX4cd impedenceAniso1d(const Eigen::VectorXd &thicknesses, const Eigen::VectorXd &freqs, const Eigen::VectorXd &resx,
                                        const Eigen::VectorXd &resy, const Eigen::VectorXd &phases);
 
+    //! Calculate the impedence matrix for isotropic 1D MT.
+    //!
+    //! With a single resistivity per layer and no layer rotations the
+    //! diagonal of the impedance matrix stays zero and Zyx = -Zxy, so only a
+    //! scalar recursion is needed. The result equals impedenceAniso1d() with
+    //! resy = res and zero phases.
+    //!
+    //! \param thicknesses A vector containing the thicknesses for each layer.
+    //! \param freqs A vector containing the MT frequencies.
+    //! \param res A vector containing the resistivities (not logarithmic).
+    //! \return The impedance matrix for isotropic MT.
+    //!
+    Eigen::MatrixX4cd impedenceIso1d(const Eigen::VectorXd &thicknesses, const Eigen::VectorXd &freqs, const Eigen::VectorXd &res);
+
     namespace detail
     {
       //! Constant for the permeability of free space.
       //!
       constexpr double MU = 4 * M_PI * 1e-7;
 
+      //! The number of frequencies the impedance recursion processes together.
+      //! Each block is held in fixed-size arrays so that the layer recursion
+      //! vectorises across frequencies without any heap allocation.
+      //!
+      constexpr int FREQ_BLOCK_SIZE = 4;
+
+      //! A block of real values, one per frequency.
+      //!
+      using FreqBlock = Eigen::Array<double, FREQ_BLOCK_SIZE, 1>;
+
+      //! A block of complex values, one per frequency.
+      //!
+      using ComplexFreqBlock = Eigen::Array<std::complex<double>, FREQ_BLOCK_SIZE, 1>;
+
+      //! The trigonometric terms of the rotation R Z R^T between two layers.
+      //! They only depend on the layer phases, so they are computed once per
+      //! layer rather than once per frequency.
+      //!
+      struct Rotation
+      {
+        //! cos^2 of the rotation angle.
+        double cc;
+
+        //! sin^2 of the rotation angle.
+        double ss;
+
+        //! cos * sin of the rotation angle.
+        double cs;
+      };
+
+      //! The terms of the impedance recursion that only depend on the layer
+      //! properties and the frequencies. Stations that share a frequency set
+      //! only differ by their layer thicknesses, so these are computed once
+      //! for the whole batch.
+      //!
+      struct MtLayerTerms
+      {
+        //! The number of frequencies.
+        int nfreqs;
+
+        //! Intrinsic impedance of each layer in the x and y directions, with
+        //! one row per frequency (padded to a whole number of blocks) and one
+        //! column per layer.
+        Eigen::ArrayXXcd zpll;
+        Eigen::ArrayXXcd zprp;
+
+        //! Wavenumber terms such that exp(kx * th) = exp(-i k th) for a layer
+        //! of thickness th. Same layout as the impedances.
+        Eigen::ArrayXXcd kx;
+        Eigen::ArrayXXcd ky;
+
+        //! Rotation from each layer to the one above it (anisotropic only).
+        std::vector<Rotation> rotations;
+      };
+
+      //! Compute the rotation terms between two layers.
+      //!
+      //! \param phaseBelow The phase of the layer below.
+      //! \param phaseAbove The phase of the layer above.
+      //! \return The rotation terms.
+      //!
+      Rotation rotation(double phaseBelow, double phaseAbove);
+
       //! Rotate the impedance matrix based on the phases of the layers.
-      //! 
+      //!
       //! \param Z The impedance matrix.
       //! \param phaseBelow The phase of the layer below.
       //! \param phaseAbove The phase of the layer above.
@@ -45,6 +122,51 @@ namespace obsidian
       //!
       Eigen::Matrix2cd applyRotation(const Eigen::Matrix2cd &Z, double phaseBelow, double phaseAbove);
 
+      //! Rotate a block of impedance matrices stored as one array per element.
+      //!
+      //! \param r The precomputed rotation terms.
+      //! \param zii, zij, zji, zjj The impedance matrix elements, rotated in place.
+      //!
+      void applyRotation(const Rotation &r, ComplexFreqBlock &zii, ComplexFreqBlock &zij, ComplexFreqBlock &zji, ComplexFreqBlock &zjj);
+
+      //! Compute the layer terms for anisotropic MT.
+      //!
+      //! \param freqs The MT frequencies.
+      //! \param resx, resy The resistivities in x and y direction (not logarithmic).
+      //! \param phases The phase of each layer.
+      //! \param nlayers The number of layers used by the recursion.
+      //! \return The layer terms.
+      //!
+      MtLayerTerms anisoLayerTerms(const Eigen::VectorXd &freqs, const Eigen::VectorXd &resx, const Eigen::VectorXd &resy,
+                                   const Eigen::VectorXd &phases, int nlayers);
+
+      //! Compute the layer terms for isotropic MT. Only zpll and kx are set.
+      //!
+      //! \param freqs The MT frequencies.
+      //! \param res The resistivities (not logarithmic).
+      //! \param nlayers The number of layers used by the recursion.
+      //! \return The layer terms.
+      //!
+      MtLayerTerms isoLayerTerms(const Eigen::VectorXd &freqs, const Eigen::VectorXd &res, int nlayers);
+
+      //! Run the anisotropic impedance recursion for one station of a batch.
+      //!
+      //! \param terms The layer terms from anisoLayerTerms().
+      //! \param thicknesses The layer thicknesses, one row per station.
+      //! \param station The row of the station to evaluate.
+      //! \param zz The impedance matrix to fill, one row per frequency.
+      //!
+      void impedenceAnisoStation(const MtLayerTerms &terms, const Eigen::MatrixXd &thicknesses, uint station, Eigen::MatrixX4cd &zz);
+
+      //! Run the isotropic impedance recursion for one station of a batch.
+      //!
+      //! \param terms The layer terms from isoLayerTerms().
+      //! \param thicknesses The layer thicknesses, one row per station.
+      //! \param station The row of the station to evaluate.
+      //! \param zz The impedance matrix to fill, one row per frequency.
+      //!
+      void impedenceIsoStation(const MtLayerTerms &terms, const Eigen::MatrixXd &thicknesses, uint station, Eigen::MatrixX4cd &zz);
+
       //! Calculates the primary angle of a vector.
       //! 
       //! \param y The imaginary part of the phase.
@@ -61,6 +183,14 @@ namespace obsidian
     //!
     Eigen::MatrixX4d phaseTensor1d(const Eigen::MatrixX4cd &Z);
 
+    //! Calculate the phase tensor of an isotropic impedance matrix, as
+    //! computed by impedenceIso1d(). Only the off-diagonal element is used.
+    //!
+    //! \param Z The isotropic impedance matrix.
+    //! \return The phase tensor.
+    //!
+    Eigen::MatrixX4d phaseTensorIso1d(const Eigen::MatrixX4cd &Z);
+
     //! Computes the alpha value of the phase tensor, which is a measure of its
     //! rotations from the major axis.
     //! 
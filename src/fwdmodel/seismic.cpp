@@ -28,10 +28,16 @@ namespace obsidian
     Seismic1dCache generateCache<ForwardModel::SEISMIC1D>(const std::vector<world::InterpolatorSpec>& boundaryInterpolation,
                                                           const WorldSpec& worldSpec, const Seismic1dSpec& spec)
     {
+      // The travel time to an interface depends on the thickness of the layer
+      // above it, so each location needs one boundary below its deepest interface
+      int lastBoundary = boundaryInterpolation.size() - 1;
+      Eigen::VectorXi deepest(spec.locations.rows());
+      for (uint location = 0; location < spec.locations.rows(); location++)
+        deepest(location) = spec.interfaces[location].size() > 0 ? std::min(spec.interfaces[location].maxCoeff() + 1, lastBoundary) : -1;
       return
       {
         boundaryInterpolation,
-        world::Query(boundaryInterpolation, worldSpec, spec.locations.leftCols(2))
+        world::Query(boundaryInterpolation, worldSpec, spec.locations.leftCols(2), deepest)
       };
     }
 
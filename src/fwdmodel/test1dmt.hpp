@@ -64,6 +64,164 @@ namespace test
     EXPECT_NEAR(-4.76612, Z(1, 3).imag(), TOLERANCE);
   }
 
+  TEST_F(MtAnisoScenario, frequencyBlocksMatchSingleFrequencies)
+  {
+    // Enough frequencies to fill several blocks plus a partial one
+    Eigen::VectorXd manyFreqs = Eigen::VectorXd::LinSpaced(11, -3, 3);
+    for (int i = 0; i < manyFreqs.rows(); i++)
+      manyFreqs(i) = std::pow(10.0, manyFreqs(i));
+
+    auto Z = impedenceAniso1d(thicknesses, manyFreqs, resx, resy, phases);
+    ASSERT_EQ(manyFreqs.rows(), Z.rows());
+
+    for (int i = 0; i < manyFreqs.rows(); i++)
+    {
+      auto single = impedenceAniso1d(thicknesses, manyFreqs.segment(i, 1), resx, resy, phases);
+      for (int j = 0; j < 4; j++)
+      {
+        EXPECT_NEAR(single(0, j).real(), Z(i, j).real(), 1e-9 * std::abs(single(0, j)));
+        EXPECT_NEAR(single(0, j).imag(), Z(i, j).imag(), 1e-9 * std::abs(single(0, j)));
+      }
+    }
+  }
+
+  TEST_F(MtAnisoScenario, isotropicMatchesAnisotropicWithoutAnisotropy)
+  {
+    Eigen::VectorXd manyFreqs = Eigen::VectorXd::LinSpaced(7, -3, 3);
+    for (int i = 0; i < manyFreqs.rows(); i++)
+      manyFreqs(i) = std::pow(10.0, manyFreqs(i));
+
+    auto aniso = impedenceAniso1d(thicknesses, manyFreqs, resx, resx, Eigen::Vector3d::Zero());
+    auto iso = impedenceIso1d(thicknesses, manyFreqs, resx);
+    ASSERT_EQ(aniso.rows(), iso.rows());
+
+    for (int i = 0; i < iso.rows(); i++)
+    {
+      for (int j = 0; j < 4; j++)
+      {
+        EXPECT_NEAR(aniso(i, j).real(), iso(i, j).real(), 1e-9 * std::abs(aniso(i, 1)));
+        EXPECT_NEAR(aniso(i, j).imag(), iso(i, j).imag(), 1e-9 * std::abs(aniso(i, 1)));
+      }
+    }
+
+    auto anisoTensor = phaseTensor1d(aniso);
+    auto isoTensor = phaseTensorIso1d(iso);
+    for (int i = 0; i < iso.rows(); i++)
+      for (int j = 0; j < 4; j++)
+        EXPECT_NEAR(anisoTensor(i, j), isoTensor(i, j), 1e-9);
+  }
+
+  //! The impedance recursion as it was before the layer terms were shared
+  //! across frequencies and stations: one frequency at a time, with every
+  //! term computed from scratch.
+  //!
+  Eigen::MatrixX4cd referenceImpedenceAniso1d(const Eigen::VectorXd &thicknesses, const Eigen::VectorXd &freqs,
+                                              const Eigen::VectorXd &resx, const Eigen::VectorXd &resy,
+                                              const Eigen::VectorXd &phases)
+  {
+    using obsidian::fwd::detail::MU;
+    using obsidian::fwd::detail::I;
+    using obsidian::fwd::detail::applyRotation;
+
+    int nlayers = thicknesses.rows();
+    Eigen::MatrixX4cd zz(freqs.rows(), 4);
+
+    for (int i = 0; i < freqs.rows(); i++)
+    {
+      double w = 2 * M_PI * freqs(i);
+
+      auto zxp = std::sqrt(MU * w * resx[nlayers - 1]) * std::exp(I * M_PI / 4.0);
+      auto zyp = std::sqrt(MU * w * resy[nlayers - 1]) * std::exp(I * M_PI / 4.0);
+
+      Eigen::Matrix2cd Z;
+      Z << 0.0, zxp, -zyp, 0.0;
+      Z = applyRotation(Z, phases[nlayers - 2], 0);
+
+      std::complex<double> zii = Z(0, 0), zij = Z(0, 1), zji = Z(1, 0), zjj = Z(1, 1);
+
+      for (int j = nlayers - 2; j >= 0; j--)
+      {
+        double th = thicknesses(j);
+
+        auto ki = std::sqrt(MU * w / resx(j)) * std::exp(-I * M_PI / 4.0);
+        auto kj = std::sqrt(MU * w / resy(j)) * std::exp(-I * M_PI / 4.0);
+
+        auto zpll = MU * w / ki;
+        auto zprp = -MU * w / kj;
+
+        auto phii = zii * zjj / (zij + zpll);
+        auto phij = zii * zjj / (zji + zprp);
+
+        auto rj = (zji - zprp - phii) / (zji + zprp - phii);
+        auto ri = (zij - zpll - phij) / (zij + zpll - phij);
+
+        auto lj = 2.0 * zpll * zjj / ((zji + zprp) * (zij + zpll - phij));
+        auto li = 2.0 * zprp * zii / ((zij + zpll) * (zji + zprp - phii));
+
+        auto l = li * lj * std::exp(I * -2.0 * (ki + kj) * th);
+
+        auto eri = ri * std::exp(I * -2.0 * ki * th);
+        auto erj = rj * std::exp(I * -2.0 * kj * th);
+        auto ekk = std::exp(I * -(ki + kj) * th);
+
+        zii = 2.0 * li * zpll * ekk / ((1.0 - erj) * (1.0 - eri) - l);
+        zij = zpll * (((1.0 + eri) * (1.0 - erj) + l) / ((1.0 - eri) * (1.0 - erj) - l));
+        zji = zprp * (((1.0 + erj) * (1.0 - eri) + l) / ((1.0 - erj) * (1.0 - eri) - l));
+        zjj = 2.0 * lj * zprp * ekk / ((1.0 - erj) * (1.0 - eri) - l);
+
+        Z << zii, zij, zji, zjj;
+        if (j > 0)
+          Z = applyRotation(Z, phases(j - 1), phases(j));
+        else
+          Z = applyRotation(Z, 0, phases(j)) * 1e-3 / MU;
+
+        zii = Z(0, 0);
+        zij = Z(0, 1);
+        zji = Z(1, 0);
+        zjj = Z(1, 1);
+      }
+
+      zz.row(i) << zii, zij, zji, zjj;
+    }
+
+    return zz;
+  }
+
+  TEST_F(MtAnisoScenario, stationBatchMatchesReferenceRecursion)
+  {
+    // Several stations of different thicknesses sharing a frequency set that
+    // fills more than one block
+    Eigen::VectorXd manyFreqs = Eigen::VectorXd::LinSpaced(6, -3, 3);
+    for (int i = 0; i < manyFreqs.rows(); i++)
+      manyFreqs(i) = std::pow(10.0, manyFreqs(i));
+
+    Eigen::MatrixXd stationThicknesses(5, 2);
+    for (int i = 0; i < stationThicknesses.rows(); i++)
+      stationThicknesses.row(i) = thicknesses.transpose() * (1.0 + 0.25 * i);
+
+    auto anisoTerms = obsidian::fwd::detail::anisoLayerTerms(manyFreqs, resx, resy, phases, stationThicknesses.cols());
+    auto isoTerms = obsidian::fwd::detail::isoLayerTerms(manyFreqs, resx, stationThicknesses.cols());
+    for (int i = 0; i < stationThicknesses.rows(); i++)
+    {
+      Eigen::VectorXd th = stationThicknesses.row(i).transpose();
+      Eigen::MatrixX4cd aniso, iso;
+      obsidian::fwd::detail::impedenceAnisoStation(anisoTerms, stationThicknesses, i, aniso);
+      obsidian::fwd::detail::impedenceIsoStation(isoTerms, stationThicknesses, i, iso);
+      auto anisoRef = referenceImpedenceAniso1d(th, manyFreqs, resx, resy, phases);
+      auto isoRef = referenceImpedenceAniso1d(th, manyFreqs, resx, resx, Eigen::Vector3d::Zero());
+      ASSERT_EQ(anisoRef.rows(), aniso.rows());
+      ASSERT_EQ(isoRef.rows(), iso.rows());
+      for (int k = 0; k < anisoRef.rows(); k++)
+      {
+        for (int j = 0; j < 4; j++)
+        {
+          EXPECT_NEAR(0.0, std::abs(anisoRef(k, j) - aniso(k, j)), 1e-9 * std::abs(anisoRef(k, 1)));
+          EXPECT_NEAR(0.0, std::abs(isoRef(k, j) - iso(k, j)), 1e-9 * std::abs(isoRef(k, 1)));
+        }
+      }
+    }
+  }
+
   TEST_F(MtAnisoScenario, phaseTensorIsCorrect)
   {
     auto Z = impedenceAniso1d(thicknesses, freqs, resx, resy, phases);
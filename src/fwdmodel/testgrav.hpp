@@ -13,6 +13,8 @@
 #include <cmath>
 
 #include "gravity.hpp"
+#include "world/interpolate.hpp"
+#include "test/world.hpp"
 
 using namespace obsidian;
 using namespace fwd;
@@ -21,5 +23,74 @@ namespace test
 {
   namespace fwd
   {
+    //! The readings projected onto a fixed direction, whose gradient is that
+    //! direction chained back through the forward model.
+    double projectedReadings(const GravSpec& spec, const GravCache& cache, const WorldParams& world, const Eigen::VectorXd& direction)
+    {
+      return direction.dot(forwardModel<ForwardModel::GRAVITY>(spec, cache, world).readings);
+    }
+
+    TEST(GravityGradient, gradientMatchesFiniteDifferences)
+    {
+      WorldSpec worldSpec;
+      WorldParams world;
+      obsidian::testing::initWorld(worldSpec, world, 0, 1000, 4, 0, 1000, 4, 0, 1000, 3,
+          [](double x, double y, uint boundary)
+          {
+            return 0.0;
+          },
+          [](double x, double y, uint boundary)
+          {
+            return boundary * 300.0 + 40.0 * std::sin(x / 200.0) + 25.0 * std::cos(y / 300.0);
+          },
+          [](uint layer, uint property)
+          {
+            return 1.0 + 0.5 * layer;
+          });
+      std::vector<world::InterpolatorSpec> interp = world::worldspec2Interp(worldSpec);
+
+      GravSpec spec;
+      spec.locations.resize(6, 3);
+      for (uint i = 0; i < 6; i++)
+      {
+        spec.locations(i, 0) = 100.0 + 150.0 * i;
+        spec.locations(i, 1) = 800.0 - 110.0 * i;
+        spec.locations(i, 2) = 0.0;
+      }
+      spec.voxelisation = { 6, 6, 10, 1 };
+      GravCache cache = generateCache<ForwardModel::GRAVITY>(interp, worldSpec, spec);
+
+      Eigen::VectorXd direction(6);
+      direction << 0.3, -1.2, 0.7, 0.1, -0.4, 0.9;
+      WorldParams gradient = forwardModelGradient<ForwardModel::GRAVITY>(spec, cache, world, direction);
+      ASSERT_EQ(world.rockProperties.size(), gradient.rockProperties.size());
+      ASSERT_EQ(world.controlPoints.size(), gradient.controlPoints.size());
+
+      const double h = 1e-4;
+      uint density = static_cast<uint>(RockProperty::Density);
+      for (uint l = 0; l < world.rockProperties.size(); l++)
+      {
+        WorldParams up = world, down = world;
+        up.rockProperties[l](density) += h;
+        down.rockProperties[l](density) -= h;
+        double expected = (projectedReadings(spec, cache, up, direction) - projectedReadings(spec, cache, down, direction)) / (2 * h);
+        EXPECT_NEAR(expected, gradient.rockProperties[l](density), 1e-6 * (1.0 + std::abs(expected)));
+      }
+
+      for (uint b = 1; b < world.controlPoints.size(); b++)
+      {
+        for (uint j = 0; j < world.controlPoints[b].rows(); j++)
+        {
+          for (uint k = 0; k < world.controlPoints[b].cols(); k++)
+          {
+            WorldParams up = world, down = world;
+            up.controlPoints[b](j, k) += h;
+            down.controlPoints[b](j, k) -= h;
+            double expected = (projectedReadings(spec, cache, up, direction) - projectedReadings(spec, cache, down, direction)) / (2 * h);
+            EXPECT_NEAR(expected, gradient.controlPoints[b](j, k), 1e-6 * (1.0 + std::abs(expected)));
+          }
+        }
+      }
+    }
   }
 }
@@ -9,7 +9,7 @@ std::string directory = ".";
 int main(int ac, char** av)
 {
   obsidian::init::initialiseLogging("testgravmag", logLevel, stdErr, directory);
-  testing::InitGoogleTest(&ac, av);
+  ::testing::InitGoogleTest(&ac, av);
   auto result = RUN_ALL_TESTS();
   return result;
 }
@@ -14,6 +14,9 @@
 #include <functional>
 #include <Eigen/Core>
 
+#include "infer/covariance.hpp"
+#include "infer/random.hpp"
+
 namespace stateline
 {
   namespace mcmc
@@ -63,30 +66,77 @@ namespace stateline
     }
     
     //! An adaptive Gaussian proposal function. It randomly varies each value in
-    //! the state according to a Gaussian distribution whose variance changes
-    //! depending on the acceptance ratio of a chain. It also bounces of the
-    //! walls of the hard boundaries given so as not to get stuck in corners.
+    //! a block of the state according to a Gaussian distribution whose variance
+    //! changes depending on the acceptance ratio of a chain. It also bounces of
+    //! the walls of the hard boundaries given so as not to get stuck in corners.
     //! 
     //! \param state The current state of the chain
     //! \param sigma The standard deviation of the distribution (step size of the proposal)
     //! \param min The minimum bound of theta 
     //! \param max The maximum bound of theta 
+    //! \param gen The random generator of the chain
+    //! \param begin The first value of the block to vary
+    //! \param length The number of values in the block; the rest keep their
+    //!        values and draw no random numbers
     //! \returns The new proposed theta
     //!
     Eigen::VectorXd adaptiveGaussianProposal(const Eigen::VectorXd &state, double sigma, 
-        const Eigen::VectorXd& min, const Eigen::VectorXd& max)
+        const Eigen::VectorXd& min, const Eigen::VectorXd& max, PhiloxGenerator& gen, uint begin, uint length)
     {
-      // Random number generators
-      static std::random_device rd;
-      static std::mt19937 generator(rd());
-      static std::normal_distribution<> rand; // Standard normal
+      std::normal_distribution<> rand; // Standard normal
 
       // Vary each paramater according to a Gaussian distribution
-      Eigen::VectorXd proposal(state.rows());
-      for (int i = 0; i < proposal.rows(); i++)
-        proposal(i) = state(i) + rand(generator) * sigma;
+      Eigen::VectorXd proposal = state;
+      for (uint i = begin; i < begin + length; i++)
+        proposal(i) = state(i) + rand(gen) * sigma;
+
+      proposal.segment(begin, length) = bouncyBounds(proposal.segment(begin, length), min.segment(begin, length),
+                                                     max.segment(begin, length));
+      return proposal;
+    };
+
+    //! An adaptive Gaussian proposal function shaped by the running covariance
+    //! of a chain (adaptive Metropolis). Only the shape of the covariance is
+    //! used: it is scaled to an average variance of sigma squared, so the
+    //! width adaption works as for adaptiveGaussianProposal. It also bounces
+    //! off the walls of the hard boundaries.
+    //!
+    //! A block of the state moves with the diagonal block of the Cholesky
+    //! factor, which factorises the covariance of the block given the values
+    //! before it.
+    //!
+    //! \param state The current state of the chain
+    //! \param sigma The step size of the proposal
+    //! \param covariance The running proposal covariance of the chain
+    //! \param min The minimum bound of theta
+    //! \param max The maximum bound of theta
+    //! \param gen The random generator of the chain
+    //! \param begin The first value of the block to vary
+    //! \param length The number of values in the block; the rest keep their
+    //!        values and draw no random numbers
+    //! \returns The new proposed theta
+    //!
+    Eigen::VectorXd adaptiveCovarianceProposal(const Eigen::VectorXd &state, double sigma,
+        const ProposalCovariance &covariance, const Eigen::VectorXd& min, const Eigen::VectorXd& max, PhiloxGenerator& gen,
+        uint begin, uint length)
+    {
+      std::normal_distribution<> rand; // Standard normal
+
+      Eigen::VectorXd z(length);
+      for (uint i = 0; i < length; i++)
+        z(i) = rand(gen);
+
+      // The Frobenius norm of the Cholesky factor is the root of the trace
+      // of the covariance
+      auto cholesky = covariance.cholesky.block(begin, begin, length, length);
+      double scale = sigma * std::sqrt((double) length) / cholesky.norm();
+      Eigen::VectorXd step = cholesky.triangularView<Eigen::Lower>() * z;
+      Eigen::VectorXd proposal = state;
+      proposal.segment(begin, length) += scale * step;
 
-      return bouncyBounds(proposal, min, max);
+      proposal.segment(begin, length) = bouncyBounds(proposal.segment(begin, length), min.segment(begin, length),
+                                                     max.segment(begin, length));
+      return proposal;
     };
     
     
@@ -10,4 +10,10 @@
 //!
 
 #include "chainarray.cpp"
+#include "covariance.cpp"
+#include "metrics.cpp"
 #include "metropolis.cpp"
+#include "random.cpp"
+#include "segments.cpp"
+#include "smc.cpp"
+#include "surrogate.cpp"
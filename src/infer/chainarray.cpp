@@ -11,6 +11,9 @@
 
 #include "infer/chainarray.hpp"
 
+#include <algorithm>
+#include <random>
+#include <boost/filesystem.hpp>
 #include <glog/logging.h>
 
 #include "infer/metropolis.hpp"
@@ -48,15 +51,74 @@ namespace stateline
 
     } // namespace internal
 
+    namespace
+    {
+      // The number of states a cursor reads at a time
+      const uint scanBlockLength = 1024;
+    }
+
+    ChainCursor::ChainCursor(ChainArray& chains, uint id, uint begin, uint end, uint stride)
+        : chains_(&chains),
+          id_(id),
+          index_(begin),
+          end_(end),
+          stride_(stride),
+          position_(0)
+    {
+      fill();
+    }
+
+    bool ChainCursor::done() const
+    {
+      return index_ >= end_;
+    }
+
+    uint ChainCursor::index() const
+    {
+      return index_;
+    }
+
+    const State& ChainCursor::state() const
+    {
+      return block_[position_];
+    }
+
+    void ChainCursor::next()
+    {
+      index_ += stride_;
+      if (++position_ == block_.size())
+        fill();
+    }
+
+    void ChainCursor::fill()
+    {
+      block_.clear();
+      position_ = 0;
+      if (done())
+        return;
+      uint count = std::min((end_ - index_ + stride_ - 1) / stride_, scanBlockLength);
+      chains_->readStates(id_, index_, count, stride_, block_);
+    }
+
     ChainArray::ChainArray(uint nStacks, uint nChains, double tempFactor, double initialSigma, double sigmaFactor, db::Database& db,
-                           uint cacheLength, bool recover)
+                           uint cacheLength, bool recover, uint seed, uint writeQueueLength)
         : nstacks_(nStacks),
           nchains_(nChains),
           cacheLength_(cacheLength),
           beta_(nStacks * nChains),
           sigma_(nStacks * nChains),
+          covariance_(nStacks * nChains),
+          seed_(seed),
+          generators_(nStacks * nChains),
           cache_(nStacks * nChains),
-          db_(db)
+          db_(db),
+          chainStore_(db.settings().chainStore),
+          segments_(nStacks * nChains),
+          diskLength_(nStacks * nChains, 0),
+          spare_(nStacks * nChains),
+          writeQueueLength_(writeQueueLength),
+          nUnwritten_(0),
+          stop_(false)
     {
       // Reserve the cache
       for (auto& c : cache_)
@@ -66,15 +128,47 @@ namespace stateline
       if (recover)
       {
         LOG(INFO)<< "Recovering chains...";
+
+        // Databases written before the chain store was chosen hold the states
+        std::string storeKey = internal::toDbString(0, internal::DbEntryType::STORE);
+        if (db_.contains(storeKey))
+          chainStore_ = ChainStore(internal::uintFromDb(db_.get(storeKey)));
+        else
+          chainStore_ = ChainStore::LevelDB;
+        openSegments();
+
         for(uint id = 0; id < nChains * nStacks; id++)
         {
           recoverFromCache(id);
         }
+
+        // Databases written before the seed was stored start a new one
+        std::string key = internal::toDbString(0, internal::DbEntryType::SEED);
+        if (db_.contains(key))
+          seed_ = internal::uintFromDb(db_.get(key));
+        else
+          seed_ = std::random_device()();
+
+        // Carry on from where the coldest chain of the stack left off,
+        // rather than repeating the numbers of the first run
+        for(uint id = 0; id < nChains * nStacks; id++)
+        {
+          generators_[id] = PhiloxGenerator(seed_, id, lengthOnDisk(id - id % nChains));
+        }
+        db_.put(key, leveldb::Slice((char*) &seed_, sizeof(uint) / sizeof(char)));
       }
       else
       {
         uint uzero = 0;
         leveldb::WriteBatch batch;
+        if (seed_ == 0)
+          seed_ = std::random_device()();
+        batch.Put(internal::toDbString(0, internal::DbEntryType::SEED),
+            leveldb::Slice((char*)&seed_, sizeof(uint)/sizeof(char)));
+        uint store = uint(chainStore_);
+        batch.Put(internal::toDbString(0, internal::DbEntryType::STORE),
+            leveldb::Slice((char*)&store, sizeof(uint)/sizeof(char)));
+        openSegments();
         for (uint i = 0; i < nStacks; i++)
         {
           for (uint j = 0; j < nChains; j++)
@@ -85,6 +179,7 @@ namespace stateline
             double sigma = initialSigma * std::pow(sigmaFactor, j);
             beta_[id] = beta;
             sigma_[id] = sigma;
+            generators_[id] = PhiloxGenerator(seed_, id);
 
             // All chains start off with length 0
             batch.Put(internal::toDbString(id, internal::DbEntryType::LENGTH),
@@ -101,11 +196,37 @@ namespace stateline
         }
         db_.batch(batch);
       }
+
+      writerReturned_ = std::async(std::launch::async, &ChainArray::writeBehind, this);
+    }
+
+    ChainArray::~ChainArray()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+      }
+      queued_.notify_one();
+      writerReturned_.wait();
+    }
+
+    void ChainArray::openSegments()
+    {
+      if (chainStore_ != ChainStore::Segments)
+        return;
+
+      boost::filesystem::path directory = boost::filesystem::path(db_.settings().directory) / "segments";
+      boost::filesystem::create_directories(directory);
+      for (uint id = 0; id < numTotalChains(); id++)
+      {
+        std::string file = "chain" + std::to_string(id);
+        segments_[id].reset(new SegmentFile((directory / file).string()));
+      }
     }
 
     uint ChainArray::lengthOnDisk(uint id)
     {
-      return internal::uintFromDb(db_.get(internal::toDbString(id, internal::DbEntryType::LENGTH)));
+      return diskLength_[id];
     }
 
     uint ChainArray::length(uint id)
@@ -125,10 +246,10 @@ namespace stateline
       return length;
     }
 
-    bool ChainArray::append(uint id, const State& proposedState)
+    bool ChainArray::append(uint id, const State& proposedState, double screenedDeltaEnergy)
     {
       State last = cache_[id].back();
-      bool accepted = acceptProposal(proposedState, last, beta_[id]);
+      bool accepted = acceptProposal(proposedState, last, beta_[id], generators_[id], screenedDeltaEnergy);
 
       if (accepted)
         cache_[id].push_back(proposedState);
@@ -146,6 +267,7 @@ namespace stateline
     {
       cache_[id].push_back(s);
       cache_[id].back().accepted = true;
+      covariance_[id] = initialCovariance(s.sample, sigma_[id]);
       if (cache_[id].size() == cacheLength_)
         flushCache(id);
     }
@@ -157,54 +279,146 @@ namespace stateline
       VLOG(1) << "Recovering stack " << stack << " chain " << chain << " from cache:";
       beta_[id] = internal::doubleFromDb(db_.get(internal::toDbString(id, internal::DbEntryType::BETA)));
       sigma_[id] = internal::doubleFromDb(db_.get(internal::toDbString(id, internal::DbEntryType::SIGMA)));
+      diskLength_[id] = internal::uintFromDb(db_.get(internal::toDbString(id, internal::DbEntryType::LENGTH)));
+
+      // The segments written after the length was last recorded are dropped
+      if (segments_[id])
+      {
+        if (segments_[id]->length() < diskLength_[id])
+        {
+          LOG(WARNING)<< "Chain " << id << " has " << segments_[id]->length() << " of its " << diskLength_[id] << " states";
+          diskLength_[id] = segments_[id]->length();
+        }
+        segments_[id]->truncate(diskLength_[id]);
+      }
       uint len = lengthOnDisk(id);
       VLOG(1) << "Has length " << len;
       VLOG(1) << "Current cache length: " << cache_[id].size();
       if (len > 0)
       {
         cache_[id].push_back(stateFromDisk(id, len - 1));
+
+        // Databases written before the proposal covariance was stored start
+        // from an isotropic covariance
+        std::string key = internal::toDbString(id, internal::DbEntryType::COVARIANCE);
+        if (db_.contains(key))
+          covariance_[id] = covarianceFromDb(db_.get(key));
+        else
+          covariance_[id] = initialCovariance(cache_[id].back().sample, sigma_[id]);
       }
     }
 
     void ChainArray::flushCache(uint id)
     {
-      leveldb::WriteBatch batch;
-      uint diskLength = lengthOnDisk(id);
+      PendingWrite w;
+      w.id = id;
+      w.sigma = sigma_[id];
+      w.beta = beta_[id];
+      w.covariance = covariance_[id];
       uint cacheLength = cache_[id].size();
-      State lastState = cache_[id].back();
 
       // Don't put the front state in
       if (id % numChains() == 0)
       {
-        for (uint i = 1; i < cacheLength; i++)
-        {
-          uint index = diskLength + i - 1;
-          batch.Put(internal::toDbString(id, index, internal::DbEntryType::STATE), comms::serialise(cache_[id][i]));
-        }
-        uint newLength = diskLength + cacheLength - 1; // no front state
-        batch.Put(internal::toDbString(id, internal::DbEntryType::LENGTH), leveldb::Slice((char*) &newLength, sizeof(uint) / sizeof(char)));
-        VLOG(3) << "Flushing cache of chain " << id << ". new length: " << newLength;
+        w.index = diskLength_[id];
+        w.begin = 1;
+        diskLength_[id] += cacheLength - 1;
+        VLOG(3) << "Flushing cache of chain " << id << ". new length: " << diskLength_[id];
       } else
       {
-        uint index = 0;
-        batch.Put(internal::toDbString(id, index, internal::DbEntryType::STATE), comms::serialise(cache_[id][cacheLength - 1]));
+        w.index = 0;
+        w.begin = cacheLength - 1;
+        diskLength_[id] = 1;
         VLOG(3) << "Overwriting high temperature state of chain " << id;
-        uint newLength = 1; // no front state
-        batch.Put(toDbString(id, internal::DbEntryType::LENGTH), leveldb::Slice((char*) &newLength, sizeof(uint) / sizeof(char)));
       }
+      w.length = diskLength_[id];
+
+      // Hand over the full cache and carry on in the spare one
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        written_.wait(lock, [this]() { return nUnwritten_ < std::max(writeQueueLength_, 1U); });
+        std::swap(w.states, spare_[id]);
+      }
+      std::swap(w.states, cache_[id]);
+      cache_[id].reserve(cacheLength_);
+      cache_[id].push_back(w.states.back());
+
+      if (writeQueueLength_ == 0)
+      {
+        write(w);
+        w.states.clear();
+        std::swap(w.states, spare_[id]);
+        return;
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_.push_back(std::move(w));
+        nUnwritten_++;
+      }
+      queued_.notify_one();
+    }
+
+    void ChainArray::sync()
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      written_.wait(lock, [this]() { return nUnwritten_ == 0; });
+    }
+
+    void ChainArray::write(PendingWrite& w)
+    {
+      leveldb::WriteBatch batch;
+      if (segments_[w.id])
+      {
+        // The segment goes first, so a recorded length is never ahead of it
+        segments_[w.id]->append(w.index, w.states, w.begin);
+      } else
+      {
+        for (uint i = w.begin; i < w.states.size(); i++)
+        {
+          uint index = w.index + i - w.begin;
+          batch.Put(internal::toDbString(w.id, index, internal::DbEntryType::STATE), comms::serialise(w.states[i]));
+        }
+      }
+      batch.Put(internal::toDbString(w.id, internal::DbEntryType::LENGTH), leveldb::Slice((char*) &w.length, sizeof(uint) / sizeof(char)));
 
       // Update sigma and beta
-      double sigma = sigma_[id];
-      double beta = beta_[id];
-      batch.Put(internal::toDbString(id, internal::DbEntryType::SIGMA), leveldb::Slice((char*) &sigma, sizeof(double) / sizeof(char)));
-      batch.Put(internal::toDbString(id, internal::DbEntryType::BETA), leveldb::Slice((char*) &beta, sizeof(double) / sizeof(char)));
+      batch.Put(internal::toDbString(w.id, internal::DbEntryType::SIGMA), leveldb::Slice((char*) &w.sigma, sizeof(double) / sizeof(char)));
+      batch.Put(internal::toDbString(w.id, internal::DbEntryType::BETA), leveldb::Slice((char*) &w.beta, sizeof(double) / sizeof(char)));
+      if (w.covariance.mean.size() > 0)
+        batch.Put(internal::toDbString(w.id, internal::DbEntryType::COVARIANCE), covarianceToDb(w.covariance));
 
       // Write the batch
       db_.batch(batch);
+    }
+
+    bool ChainArray::writeBehind()
+    {
+      while (true)
+      {
+        PendingWrite w;
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          queued_.wait(lock, [this]() { return !pending_.empty() || stop_; });
+          // Everything queued is written before stopping
+          if (pending_.empty())
+            break;
+          w = std::move(pending_.front());
+          pending_.pop_front();
+        }
+
+        write(w);
 
-      // Re-initialise the cache
-      cache_[id].clear();
-      cache_[id].push_back(lastState);
+        w.states.clear();
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          if (spare_[w.id].capacity() == 0)
+            std::swap(w.states, spare_[w.id]);
+          nUnwritten_--;
+        }
+        written_.notify_all();
+      }
+      return true;
     }
 
     State ChainArray::lastState(uint id)
@@ -214,8 +428,11 @@ namespace stateline
 
     State ChainArray::stateFromDisk(uint id, uint idx)
     {
+      sync();
       uint dlen = lengthOnDisk(id);
       CHECK(idx < dlen) << "Can't access state " << idx << " in chain " << id << " from disk when " << dlen << " states stored on disk";
+      if (segments_[id])
+        return segments_[id]->state(idx);
       State s;
       std::string data = db_.get(toDbString(id, idx, internal::DbEntryType::STATE));
       comms::unserialise(data, s);
@@ -226,7 +443,8 @@ namespace stateline
     {
       CHECK(cache_[id].size() > 0) << "Can't access state " << idx << " in chain " << id << " from cache when cache empty!";
       uint dlen = lengthOnDisk(id);
-      uint cacheIdx = idx - dlen;
+      // Once the chain is on disk the front of the cache is its last state there
+      uint cacheIdx = dlen > 0 ? idx - dlen + 1 : idx;
       CHECK(cacheIdx < cache_[id].size()) << "Can't access state " << idx << " in chain " << id << ": index beyond cache boundary";
       return cache_[id][cacheIdx];
     }
@@ -243,20 +461,40 @@ namespace stateline
 
     std::vector<State> ChainArray::states(uint id)
     {
-      uint len = length(id);
-      std::vector<State> v(len);
-      for (uint i = 0; i < len; i++)
+      std::vector<State> v;
+      readStates(id, 0, length(id), 1, v);
+      return v;
+    }
+
+    ChainCursor ChainArray::scan(uint id, uint begin, uint end, uint stride)
+    {
+      CHECK(stride > 0) << "Can't scan chain " << id << " with a stride of zero";
+      return ChainCursor(*this, id, begin, std::min(end, length(id)), stride);
+    }
+
+    void ChainArray::readStates(uint id, uint first, uint count, uint stride, std::vector<State>& states)
+    {
+      states.reserve(states.size() + count);
+      uint dlen = lengthOnDisk(id);
+      uint nDisk = first < dlen ? std::min(count, (dlen - first + stride - 1) / stride) : 0;
+      if (segments_[id] && nDisk > 0)
+      {
+        sync();
+        segments_[id]->read(first, nDisk, stride, states);
+      } else
       {
-        v[i] = state(id, i);
+        for (uint k = 0; k < nDisk; k++)
+          states.push_back(stateFromDisk(id, first + k * stride));
       }
-      return v;
+      for (uint k = nDisk; k < count; k++)
+        states.push_back(state(id, first + k * stride));
     }
 
     bool ChainArray::swap(uint id1, uint id2)
     {
       State& state1 = cache_[id1].back();
       State& state2 = cache_[id2].back();
-      bool swapped = acceptSwap(state1, state2, beta_[id1], beta_[id2]);
+      bool swapped = acceptSwap(state1, state2, beta_[id1], beta_[id2], generators_[id1]);
       State tempState;
       if (swapped)
       {
@@ -282,6 +520,26 @@ namespace stateline
       return sigma_[id];
     }
 
+    const ProposalCovariance& ChainArray::covariance(uint id) const
+    {
+      return covariance_[id];
+    }
+
+    void ChainArray::adaptCovariance(uint id, double weight)
+    {
+      updateCovariance(covariance_[id], cache_[id].back().sample, weight);
+    }
+
+    PhiloxGenerator& ChainArray::generator(uint id)
+    {
+      return generators_[id];
+    }
+
+    uint ChainArray::seed() const
+    {
+      return seed_;
+    }
+
     double ChainArray::beta(uint id) const
     {
       return beta_[id];
@@ -11,13 +11,68 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+
 #include "db/db.hpp"
 #include "mcmctypes.hpp"
+#include "covariance.hpp"
+#include "random.hpp"
+#include "segments.hpp"
 
 namespace stateline
 {
   namespace mcmc
   {
+    class ChainArray;
+
+    //! A forward cursor over states of a chain (see ChainArray::scan()). It
+    //! reads the states in order a block at a time, rather than looking up
+    //! each one.
+    //!
+    class ChainCursor
+    {
+      public:
+        //! Check whether the cursor has passed its last state.
+        //!
+        //! \return True once there are no more states.
+        //!
+        bool done() const;
+
+        //! Get the index in the chain of the current state.
+        //!
+        //! \return The index of the state.
+        //!
+        uint index() const;
+
+        //! Get the current state.
+        //!
+        //! \return The state.
+        //!
+        const State& state() const;
+
+        //! Move on to the next state.
+        //!
+        void next();
+
+      private:
+        friend class ChainArray;
+
+        ChainCursor(ChainArray& chains, uint id, uint begin, uint end, uint stride);
+        void fill();
+
+        ChainArray* chains_;
+        uint id_;
+        uint index_;
+        uint end_;
+        uint stride_;
+        std::vector<State> block_;
+        uint position_;
+    };
+
     //! Manager for all the states and handle reading / writing from / to databse.
     //!
     //! \section id The chain ID used by MCMC sampler.
@@ -35,6 +90,19 @@ namespace stateline
     //! id 7 = stack 2 chain 4 // highest temperature chain of stack 2
     //! \endcode
     //!
+    //! \section writes Writing to the database.
+    //!
+    //! Full caches are handed to a writer thread, which serialises them and
+    //! writes them to the database, so the sampler never waits on the disk
+    //! unless writeQueueLength caches are already waiting. The lengths of the
+    //! chains are kept in memory, and reading a state from the database first
+    //! waits for the writes before it. sync() waits for every write, and the
+    //! destructor finishes them before returning.
+    //!
+    //! The states go to the database or to a SegmentFile per chain, as
+    //! DBSettings::chainStore chose when the run was started. Everything
+    //! else about a chain goes to the database.
+    //!
     class ChainArray
     {
       public:
@@ -49,9 +117,20 @@ namespace stateline
         //! \param cacheLength The size of the memory cache used to store the chains.
         //! \param recover If set to true, chain data will be recovered from the database
         //                 otherwise, the MCMC will start from the beginning.
+        //! \param seed The seed of the random generators of the chains. Zero
+        //!        picks one at random. Ignored when recovering, which uses the
+        //!        seed stored in the database.
+        //! \param writeQueueLength The number of flushed caches that can wait
+        //!        for the writer thread before flushing blocks (see \ref writes).
+        //!        Zero writes them on the calling thread.
         //!
         ChainArray(uint nStacks, uint nChains, double tempFactor, double initialSigma,
-            double sigmaFactor, db::Database& db, uint cacheLength, bool recover);
+            double sigmaFactor, db::Database& db, uint cacheLength, bool recover, uint seed = 0,
+            uint writeQueueLength = 4);
+
+        //! Finish the outstanding writes and stop the writer thread.
+        //!
+        ~ChainArray();
 
         //! Get the length of a chain.
         //!
@@ -64,9 +143,11 @@ namespace stateline
         //! 
         //! \param id The id of the chain (see \ref id).
         //! \param proposedState The new state to append.
+        //! \param screenedDeltaEnergy The change in screening energy of a
+        //!        delayed acceptance proposal (see acceptProposal()).
         //! \return Whether the state accepted or rejected (in which case last state is reappended).
         //!
-        bool append(uint id, const State& proposedState);
+        bool append(uint id, const State& proposedState, double screenedDeltaEnergy = 0.0);
 
         //! Initialise a chain (by definitely accepting a new state).
         //!
@@ -97,6 +178,17 @@ namespace stateline
         //!
         std::vector<State> states(uint id);
 
+        //! Read states of a chain in order.
+        //!
+        //! \param id The id of the chain (see \ref id).
+        //! \param begin The index of the first state.
+        //! \param end The index past the last state. It is limited to the
+        //!        length of the chain.
+        //! \param stride The step between the indices of the states.
+        //! \return A cursor at the first state.
+        //!
+        ChainCursor scan(uint id, uint begin, uint end, uint stride = 1);
+
         //! Attempt to swap the states in two different chains.
         //!
         //! \param id1 The id of the first chain (see \ref id).
@@ -119,6 +211,34 @@ namespace stateline
         //!
         void setSigma(uint id, double sigma);
 
+        //! Get the running proposal covariance of a specific chain.
+        //!
+        //! \param id The id of the chain (see \ref id).
+        //! \return The proposal covariance of the chain.
+        //!
+        const ProposalCovariance& covariance(uint id) const;
+
+        //! Add the last state of a chain to its running proposal covariance.
+        //!
+        //! \param id The id of the chain (see \ref id).
+        //! \param weight The weight of the state (see updateCovariance()).
+        //!
+        void adaptCovariance(uint id, double weight);
+
+        //! Get the random generator of a specific chain. Everything random a
+        //! chain does draws from it, so a run replays exactly from its seed.
+        //!
+        //! \param id The id of the chain (see \ref id).
+        //! \return The random generator of the chain.
+        //!
+        PhiloxGenerator& generator(uint id);
+
+        //! Get the seed of the random generators of the chains.
+        //!
+        //! \return The seed of the run.
+        //!
+        uint seed() const;
+
         //! Get the inverse temperature of a specific chain.
         //!
         //! \param id The id of the second chain (see \ref id).
@@ -151,12 +271,17 @@ namespace stateline
         //!
         uint numTotalChains() const;
 
-        //! Forcibly flush the cache for a particular chain.
+        //! Forcibly flush the cache for a particular chain. The states are
+        //! written behind (see \ref writes).
         //!
         //! \param id The id of the chain to flush.
         //!
         void flushCache(uint id);
 
+        //! Wait until every flushed cache has been written to the database.
+        //!
+        void sync();
+
         //! Recover a particular chain from cached.
         //!
         //! \param id The id of the chain to recover.
@@ -164,19 +289,61 @@ namespace stateline
         void recoverFromCache(uint id);
 
       private:
+        friend class ChainCursor;
+
+        //! A flushed cache waiting for the writer thread.
+        struct PendingWrite
+        {
+          uint id;
+
+          // The index in the chain of states[begin]
+          uint index;
+          uint begin;
+          std::vector<State> states;
+          uint length;
+          double sigma;
+          double beta;
+          ProposalCovariance covariance;
+        };
+
+        void openSegments();
         uint lengthOnDisk(uint id);
-        void setLengthOnDisk(uint id, uint length);
 
         State stateFromDisk(uint id, uint index);
         State stateFromCache(uint id, uint index);
+        void readStates(uint id, uint first, uint count, uint stride, std::vector<State>& states);
+
+        void write(PendingWrite& w);
+        bool writeBehind();
 
         uint nstacks_;
         uint nchains_;
         uint cacheLength_;
         std::vector<double> beta_;
         std::vector<double> sigma_;
+        std::vector<ProposalCovariance> covariance_;
+        uint seed_;
+        std::vector<PhiloxGenerator> generators_;
         std::vector<std::vector<State>> cache_;
         db::Database& db_;
+
+        // The segment file of each chain, unless the states are in the database
+        ChainStore chainStore_;
+        std::vector<std::unique_ptr<SegmentFile>> segments_;
+
+        // The lengths of the chains once the pending writes are done
+        std::vector<uint> diskLength_;
+
+        // Written caches handed back for the next flush of their chain
+        std::vector<std::vector<State>> spare_;
+        uint writeQueueLength_;
+        std::deque<PendingWrite> pending_;
+        uint nUnwritten_;
+        bool stop_;
+        std::mutex mutex_;
+        std::condition_variable queued_;
+        std::condition_variable written_;
+        std::future<bool> writerReturned_;
     };
 
     namespace internal
@@ -195,7 +362,17 @@ namespace stateline
         SIGMA,
         
         //! Indicates that the database entry is the inverse temperature of a chain.
-        BETA
+        BETA,
+
+        //! Indicates that the database entry is the proposal covariance of a chain.
+        COVARIANCE,
+
+        //! Indicates that the database entry is the random seed of the run.
+        SEED,
+
+        //! Indicates that the database entry is how the states of the chains
+        //! are stored (see ChainStore).
+        STORE
       };
 
       //! Get the key string representing a database entry of a particular chain.
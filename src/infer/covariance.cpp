@@ -0,0 +1,81 @@
+//!
+//! Contains the implementation of the running proposal covariance of a chain.
+//!
+//! \file infer/covariance.cpp
+//! \date 2026
+//! \license Affero General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include "infer/covariance.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <glog/logging.h>
+
+namespace stateline
+{
+  namespace mcmc
+  {
+    ProposalCovariance initialCovariance(const Eigen::VectorXd& state, double sigma)
+    {
+      ProposalCovariance covariance;
+      covariance.mean = state;
+      covariance.cholesky = sigma * Eigen::MatrixXd::Identity(state.rows(), state.rows());
+      return covariance;
+    }
+
+    void updateCovariance(ProposalCovariance& covariance, const Eigen::VectorXd& state, double weight)
+    {
+      // C' = (1 - w) C + w (1 - w) d d^T = (1 - w) (C + w d d^T)
+      Eigen::VectorXd delta = state - covariance.mean;
+      covariance.mean += weight * delta;
+      choleskyRankUpdate(covariance.cholesky, std::sqrt(weight) * delta);
+      covariance.cholesky *= std::sqrt(1.0 - weight);
+
+      // The Frobenius norm of the factor is the root of the trace
+      uint n = covariance.cholesky.rows();
+      double floor = COVARIANCE_DIAGONAL_FLOOR * covariance.cholesky.norm() / std::sqrt((double) n);
+      for (uint k = 0; k < n; k++)
+        covariance.cholesky(k, k) = std::max(covariance.cholesky(k, k), floor);
+    }
+
+    void choleskyRankUpdate(Eigen::MatrixXd& cholesky, Eigen::VectorXd v)
+    {
+      uint n = cholesky.rows();
+      for (uint k = 0; k < n; k++)
+      {
+        double diag = cholesky(k, k);
+        double r = std::sqrt(diag * diag + v(k) * v(k));
+        double c = r / diag;
+        double s = v(k) / diag;
+        cholesky(k, k) = r;
+        uint rest = n - k - 1;
+        cholesky.col(k).tail(rest) = (cholesky.col(k).tail(rest) + s * v.tail(rest)) / c;
+        v.tail(rest) = c * v.tail(rest) - s * cholesky.col(k).tail(rest);
+      }
+    }
+
+    std::string covarianceToDb(const ProposalCovariance& covariance)
+    {
+      uint n = covariance.mean.rows();
+      std::string data((1 + n + n * n) * sizeof(double), '\0');
+      double* values = (double*) &data[0];
+      values[0] = n;
+      Eigen::Map<Eigen::VectorXd>(values + 1, n) = covariance.mean;
+      Eigen::Map<Eigen::MatrixXd>(values + 1 + n, n, n) = covariance.cholesky;
+      return data;
+    }
+
+    ProposalCovariance covarianceFromDb(const std::string& data)
+    {
+      const double* values = (const double*) &data[0];
+      uint n = values[0];
+      CHECK_EQ(data.size(), (1 + n + n * n) * sizeof(double)) << "Corrupt proposal covariance in database";
+      ProposalCovariance covariance;
+      covariance.mean = Eigen::Map<const Eigen::VectorXd>(values + 1, n);
+      covariance.cholesky = Eigen::Map<const Eigen::MatrixXd>(values + 1 + n, n, n);
+      return covariance;
+    }
+  }
+}
@@ -0,0 +1,81 @@
+//!
+//! Contains the interface for the running proposal covariance of a chain.
+//!
+//! \file infer/covariance.hpp
+//! \date 2026
+//! \license Affero General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#pragma once
+
+#include <string>
+#include <Eigen/Core>
+
+namespace stateline
+{
+  namespace mcmc
+  {
+    //! Running estimate of the covariance of the states of a chain. It is
+    //! kept as a Cholesky factor so that adding a state and drawing a
+    //! correlated proposal step are both quadratic in the state dimension.
+    //!
+    struct ProposalCovariance
+    {
+      //! The running mean of the states.
+      Eigen::VectorXd mean;
+
+      //! The lower triangular Cholesky factor of the running covariance.
+      Eigen::MatrixXd cholesky;
+    };
+
+    //! The smallest diagonal entry of the Cholesky factor after an update,
+    //! relative to the root mean square standard deviation. As with the
+    //! epsilon times identity of Haario et al., it keeps a direction the
+    //! chain has not moved in from collapsing, so the proposals still explore
+    //! it and the rank-1 updates never divide by a vanishing diagonal.
+    //!
+    constexpr double COVARIANCE_DIAGONAL_FLOOR = 1e-2;
+
+    //! Create a proposal covariance centred on a state, with an isotropic
+    //! covariance matching the proposal width.
+    //!
+    //! \param state The first state of the chain.
+    //! \param sigma The proposal width of the chain.
+    //! \return The initial proposal covariance.
+    //!
+    ProposalCovariance initialCovariance(const Eigen::VectorXd& state, double sigma);
+
+    //! Add a state to the running mean and covariance. The new covariance is
+    //! (1 - weight) times the old covariance plus weight times the outer
+    //! product of the state's deviation from the mean. The diagonal of the
+    //! Cholesky factor is then kept above COVARIANCE_DIAGONAL_FLOOR.
+    //!
+    //! \param covariance The proposal covariance to update.
+    //! \param state The state to add.
+    //! \param weight The weight of the new state, between zero and one.
+    //!
+    void updateCovariance(ProposalCovariance& covariance, const Eigen::VectorXd& state, double weight);
+
+    //! Update a Cholesky factor in place so that it factorises L L^T + v v^T.
+    //!
+    //! \param cholesky The lower triangular Cholesky factor L.
+    //! \param v The vector of the rank-1 update.
+    //!
+    void choleskyRankUpdate(Eigen::MatrixXd& cholesky, Eigen::VectorXd v);
+
+    //! Convert a proposal covariance to a string for the database.
+    //!
+    //! \param covariance The proposal covariance.
+    //! \return A string containing the dimension, mean and Cholesky factor.
+    //!
+    std::string covarianceToDb(const ProposalCovariance& covariance);
+
+    //! Convert a database string back into a proposal covariance.
+    //!
+    //! \param data The string data from the database.
+    //! \return The proposal covariance the string represents.
+    //!
+    ProposalCovariance covarianceFromDb(const std::string& data);
+  }
+}
@@ -10,6 +10,8 @@
 
 #pragma once
 
+#include <algorithm>
+#include <vector>
 #include <Eigen/Dense>
 
 namespace stateline
@@ -94,10 +96,160 @@ namespace stateline
           return (rHat() < 1.1).all();
         }
 
+        //! Get the number of chains tested for convergence.
+        //!
+        //! \return The number of chains.
+        //!
+        int numChains() const
+        {
+          return numSamples_.rows();
+        }
+
+      private:
+        Eigen::ArrayXXd M_;
+        Eigen::ArrayXXd S_;
+        Eigen::ArrayXi numSamples_;
+    };
+
+    //! Online effective sample size estimate using batch means. Each chain
+    //! keeps a fixed number of batch sums; when they fill up, neighbouring
+    //! batches merge and the batch size doubles, so the memory is constant
+    //! and the batches grow with the chain. The autocorrelation time is the
+    //! variance of the batch means relative to the variance of the samples.
+    //!
+    class EffectiveSampleSize
+    {
+      public:
+        //! Initialise the estimator.
+        //!
+        //! \param numChains The number of chains to be estimated.
+        //! \param numDims The number of dimensions in each state.
+        //! \param numBatches The number of batches kept per chain once they
+        //!        have filled up. The estimate needs at least 2 batches.
+        //!
+        EffectiveSampleSize(int numChains, int numDims, int numBatches = 32) :
+          M_(Eigen::ArrayXXd::Zero(numDims, numChains)),
+          S_(Eigen::ArrayXXd::Zero(numDims, numChains)),
+          numSamples_(Eigen::ArrayXi::Zero(numChains)),
+          batchSums_(numChains, Eigen::ArrayXXd::Zero(numDims, 2 * numBatches)),
+          batchSize_(Eigen::ArrayXi::Ones(numChains)),
+          numFull_(Eigen::ArrayXi::Zero(numChains)),
+          numInBatch_(Eigen::ArrayXi::Zero(numChains)),
+          numBatches_(numBatches)
+        {
+        }
+
+        //! Update the estimate for a new sample in a particular chain.
+        //!
+        //! \param id The chain which has the new sample.
+        //! \param sample The new sample.
+        //!
+        void update(uint id, const Eigen::VectorXd &sample)
+        {
+          // Running mean and variance as in EpsrConvergenceCriteria
+          int n = numSamples_(id) + 1;
+          Eigen::ArrayXd x = sample.array();
+          Eigen::ArrayXd newM = M_.col(id) + (x - M_.col(id)) / n;
+          S_.col(id) = S_.col(id) + (x - M_.col(id)) * (x - newM);
+          M_.col(id) = newM;
+          numSamples_(id) = n;
+
+          Eigen::ArrayXXd& sums = batchSums_[id];
+          sums.col(numFull_(id)) += x;
+          if (++numInBatch_(id) < batchSize_(id))
+            return;
+
+          numInBatch_(id) = 0;
+          if (++numFull_(id) < sums.cols())
+            return;
+
+          // Merge neighbouring batches and double the batch size
+          for (int i = 0; i < numBatches_; i++)
+            sums.col(i) = sums.col(2 * i) + sums.col(2 * i + 1);
+          sums.rightCols(numBatches_).setZero();
+          numFull_(id) = numBatches_;
+          batchSize_(id) *= 2;
+        }
+
+        //! Estimate the effective sample size of a chain. Zero until the
+        //! chain has 2 full batches. A dimension the chain never moves in
+        //! carries no information, so it is zero as well.
+        //!
+        //! \param id The chain to estimate.
+        //! \return The effective sample size of each dimension, at most the
+        //!         number of samples.
+        //!
+        Eigen::ArrayXd ess(uint id) const
+        {
+          int k = numFull_(id);
+          int n = numSamples_(id);
+          Eigen::ArrayXd result = Eigen::ArrayXd::Zero(M_.rows());
+          if (k < 2)
+            return result;
+
+          // The variance of the means of the full batches
+          double b = batchSize_(id);
+          Eigen::ArrayXXd means = batchSums_[id].leftCols(k) / b;
+          Eigen::ArrayXd mean = means.rowwise().mean();
+          Eigen::ArrayXd batchVar = (means.colwise() - mean).square().rowwise().sum() / (k - 1.0);
+          Eigen::ArrayXd var = S_.col(id) / (n - 1.0);
+
+          for (int i = 0; i < result.rows(); i++)
+          {
+            // Batches of a constant merged in a different order can round to
+            // slightly different means, so check the samples vary first
+            if (var(i) > 0.0)
+              result(i) = batchVar(i) > 0.0 ? std::min((double) n, n * var(i) / (b * batchVar(i))) : n;
+          }
+          return result;
+        }
+
+        //! Estimate the effective sample size of all the chains together.
+        //!
+        //! \return The sum over chains of the effective sample size of each
+        //!         dimension.
+        //!
+        Eigen::ArrayXd ess() const
+        {
+          Eigen::ArrayXd total = Eigen::ArrayXd::Zero(M_.rows());
+          for (uint i = 0; i < batchSums_.size(); i++)
+            total += ess(i);
+          return total;
+        }
+
       private:
         Eigen::ArrayXXd M_;
         Eigen::ArrayXXd S_;
         Eigen::ArrayXi numSamples_;
+        std::vector<Eigen::ArrayXXd> batchSums_;
+        Eigen::ArrayXi batchSize_;
+        Eigen::ArrayXi numFull_;
+        Eigen::ArrayXi numInBatch_;
+        int numBatches_;
     };
+
+    //! Check targets on the potential scale reduction and the effective
+    //! sample size of the coldest chains.
+    //!
+    //! \param cc The convergence criteria of the coldest chains.
+    //! \param ess The effective sample size of the coldest chains.
+    //! \param targetRHat Every R-hat must be below this. Zero disables it.
+    //! \param targetEss Every effective sample size must be at least this.
+    //!        Zero disables it.
+    //! \return True if there is a target and every target is met.
+    //!
+    inline bool hasMetTargets(const EpsrConvergenceCriteria& cc, const EffectiveSampleSize& ess, double targetRHat,
+                              double targetEss)
+    {
+      if (targetRHat <= 0 && targetEss <= 0)
+        return false;
+      // R-hat needs at least 2 chains, and is not a number until each has 2
+      // samples
+      if (targetRHat > 0 && (cc.numChains() < 2 || !(cc.rHat() < targetRHat).all()))
+        return false;
+      if (targetEss > 0 && ess.ess().minCoeff() < targetEss)
+        return false;
+      return true;
+    }
   }
 }
@@ -11,7 +11,12 @@
 
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <future>
 #include <limits>
+#include <map>
+#include <queue>
 #include <random>
 #include <iomanip>
 #include <chrono>
@@ -24,6 +29,9 @@
 #include "app/settings.hpp"
 #include "infer/chainarray.hpp"
 #include "infer/diagnostics.hpp"
+#include "infer/metrics.hpp"
+#include "infer/metropolis.hpp"
+#include "infer/surrogate.hpp"
 #include "comms/transport.hpp"
 
 namespace stateline
@@ -45,10 +53,13 @@ namespace stateline
       //!
       Sampler(const MCMCSettings& s, const DBSettings& d, uint stateDim, volatile bool& interrupted)
           : db_(d),
-            chains_(s.stacks, s.chains, s.initialTempFactor, s.proposalInitialSigma, s.initialSigmaFactor, db_, s.cacheLength, d.recover),
+            chains_(s.stacks, s.chains, s.initialTempFactor, s.proposalInitialSigma, s.initialSigmaFactor, db_, s.cacheLength, d.recover,
+                    s.seed, d.writeQueueLength),
             lengths_(s.stacks * s.chains, 0),
+            swapSweeps_(s.stacks * s.chains, 0),
             propStates_(s.stacks * s.chains, stateDim),
-            locked_(s.stacks * s.chains, false),
+            replicaAt_(s.stacks * s.chains),
+            slotOf_(s.stacks * s.chains),
             nextChainBeta_(s.stacks * s.chains),
             nAcceptsGlobal_(s.stacks * s.chains, 0),
             nSwapsGlobal_(s.stacks * (s.chains), 0),
@@ -58,6 +69,40 @@ namespace stateline
             acceptRates_(s.stacks * s.chains),
             swapRates_(s.stacks * s.chains),
             lowestEnergies_(s.stacks * s.chains),
+            screenEnergies_(s.stacks * s.chains, 0.0),
+            propScreenEnergies_(s.stacks * s.chains, 0.0),
+            propScreenBetas_(s.stacks * s.chains, 1.0),
+            hasSurrogate_(false),
+            surrogateEnergies_(s.stacks * s.chains, std::numeric_limits<double>::quiet_NaN()),
+            propSurrogateDeltas_(s.stacks * s.chains, std::numeric_limits<double>::quiet_NaN()),
+            trainingStates_(s.surrogateTrainingLength),
+            trainingEnergies_(s.surrogateTrainingLength),
+            nTrained_(0),
+            nSurrogateFits_(0),
+            gradients_(s.stacks * s.chains),
+            propGradients_(s.stacks * s.chains),
+            propLangevin_(s.stacks * s.chains, false),
+            propSigmas_(s.stacks * s.chains, 0.0),
+            propBetas_(s.stacks * s.chains, 1.0),
+            propLogRatios_(s.stacks * s.chains, 0.0),
+            propEnsemble_(s.stacks * s.chains, false),
+            nEnsembleProposed_(0),
+            nEnsembleAccepted_(0),
+            blockSigmas_(s.stacks * s.chains),
+            blockAccepts_(s.stacks * s.chains),
+            blockProposals_(s.stacks * s.chains),
+            nextBlock_(s.stacks * s.chains, 0),
+            propBlocks_(s.stacks * s.chains, -1),
+            nScreened_(0),
+            nProposed_(0),
+            speculate_(false),
+            specGrown_(s.stacks * s.chains, false),
+            specChildren_(s.stacks * s.chains),
+            nextJob_(s.stacks * s.chains),
+            nSpeculativeJobs_(0),
+            nSpeculated_(0),
+            nSpeculationHits_(0),
+            swapDecisionSeconds_(0.0),
             s_(s),
             recover_(d.recover),
             numOutstandingJobs_(0),
@@ -81,6 +126,8 @@ namespace stateline
           nSwapsGlobal_[i] = 0;
           nSwapAttemptsGlobal_[i] = 1;
           swapBuffers_[i].push_back(false); // gets rid of a nan, not really needed
+          replicaAt_[i] = i;
+          slotOf_[i] = i;
         }
       }
 
@@ -88,50 +135,114 @@ namespace stateline
       //!
       //! \param policy Async policy to evaluate states.
       //! \param initialStates Initial chain states. Ignored if recovering.
-      //! \param propFn The proposal function.
-      //! \param numSeconds The number of seconds to run the MCMC for.
+      //! \param propFn The proposal function. It is given the last state, the
+      //!        proposal width, the proposal covariance and the random
+      //!        generator of the chain, and the first index and length of the
+      //!        block of the state it may move.
+      //! \param numSeconds The maximum number of seconds to run the MCMC for.
+      //!        It stops earlier once the R-hat and effective sample size
+      //!        targets in the settings are met.
+      //! \param screenFn Optional cheap energy for delayed acceptance. Proposals
+      //!        are first accepted or rejected on this energy, and only the
+      //!        accepted ones are sent to the policy. The second stage corrects
+      //!        for the screening so the chains still target the full energy.
+      //!        If the settings enable the surrogate, it screens proposals
+      //!        after this energy.
+      //! \param gradientFn Optional gradient of the energy of each evaluated
+      //!        job. Chains whose current state has a gradient make Langevin
+      //!        proposals instead of calling propFn.
+      //! \param blocks Optional offsets of contiguous blocks of the state,
+      //!        ending with the state size. If block updates are enabled,
+      //!        each propFn proposal is given one block to move.
+      //!
+      //! If the settings ask for speculation, the policy also evaluates the
+      //! proposals each chain would make after either outcome of its
+      //! outstanding one. Their job ids start after the replica ids.
       //!
       template<class AsyncPolicy, class PropFn>
-      void run(AsyncPolicy &policy, const std::vector<Eigen::VectorXd>& initialStates, PropFn &propFn, uint numSeconds)
+      void run(AsyncPolicy &policy, const std::vector<Eigen::VectorXd>& initialStates, PropFn &propFn, uint numSeconds,
+               const ScreenFn &screenFn = ScreenFn(), const GradientFn &gradientFn = GradientFn(),
+               const std::vector<uint> &blocks = std::vector<uint>())
       {
         using namespace std::chrono;
 
         // Used for publishing statistics to visualisation server.
-        zmq::socket_t publisher(context_, ZMQ_PUB);
-        publisher.bind("tcp://*:5556");
+        MetricsPublisher publisher(context_, s_.metricsEndpoint);
 
         // Record the starting time of the MCMC
         steady_clock::time_point startTime = steady_clock::now();
+        LOG(INFO)<< "Random seed: " << chains_.seed();
 
-        // Initialise the chains if we're not recovering
+        // Initialise the chains if we're not recovering. Recovered chains
+        // have no gradients until they next accept a proposal
+        gradientFn_ = gradientFn;
         if (!recover_)
         {
           initialise(policy, initialStates);
         }
 
+        // Screening energies of the current states
+        screenFn_ = screenFn;
+        if (screenFn_)
+        {
+          for (uint i = 0; i < chains_.numTotalChains(); i++)
+            screenEnergies_[i] = screenFn_(chains_.lastState(i).sample);
+        }
+
+        // Every block starts from the proposal width of its chain. A single
+        // block is the same as no blocks
+        blocks_.clear();
+        if (s_.proposalBlocks != BlockUpdate::None && blocks.size() > 2)
+          blocks_ = blocks;
+        uint nBlocks = blocks_.empty() ? 0 : blocks_.size() - 1;
+        for (uint i = 0; i < chains_.numTotalChains(); i++)
+        {
+          blockSigmas_[i].assign(nBlocks, chains_.sigma(i));
+          blockAccepts_[i].assign(nBlocks, 0);
+          blockProposals_[i].assign(nBlocks, 0);
+        }
+
+        // Speculation needs the next proposal of a chain to depend on nothing
+        // but its state, its proposal width and its generator
+        speculate_ = s_.speculationDepth > 0;
+        if (speculate_ && (screenFn_ || s_.surrogateFeatures > 0 || gradientFn_ || s_.proposalEnsemble != EnsembleMove::None
+            || !blocks_.empty() || s_.proposalCovarianceLength > 0))
+        {
+          LOG(WARNING)<< "Speculative proposals only support plain proposals: disabling them";
+          speculate_ = false;
+        }
+
         // Start all the chains from hottest to coldest
         for (uint i = 0; i < chains_.numTotalChains(); i++)
         {
           uint c = chains_.numTotalChains() - i - 1;
-          propose(policy, c, propFn);
+          proposeNext(policy, c, propFn);
         }
 
         // Initialise the convergence criteria
         uint stateDim = initialStates[0].size();
         EpsrConvergenceCriteria cc(chains_.numStacks(), stateDim);
 
+        // Monitor the sampling efficiency of the coldest chains
+        EffectiveSampleSize ess(chains_.numStacks(), stateDim);
+
         // Listen for replies. As soon as a new state comes back,
-        // add it to the corresponding chain, and submit a new proposed state
-        auto lastLogTime = steady_clock::now();
+        // add it to the corresponding chain, and submit a new proposed state.
+        // Jobs are tagged with the replica that proposed them rather than the
+        // chain, so swaps can move a replica while its job is outstanding.
+        auto lastPublishTime = steady_clock::now();
         auto lastPrintTime = steady_clock::now();
-        while (duration_cast<seconds>(steady_clock::now() - startTime).count() < numSeconds && !interrupted_)
+        auto lastTargetTime = steady_clock::now();
+        auto lastCheckpointTime = steady_clock::now();
+        bool targetsMet = false;
+        while (duration_cast<seconds>(steady_clock::now() - startTime).count() < numSeconds && !interrupted_ && !targetsMet)
         {
           std::pair<uint, double> result;
 
           // Wait a for reply
           try
           {
-            result = policy.retrieve();
+            result = retrieve(policy);
           }
           catch (...)
           {
@@ -143,7 +254,8 @@ namespace stateline
             break;
 
           numOutstandingJobs_--;
-          uint id = result.first;
+          uint replica = result.first;
+          uint id = slotOf_[replica];
           double energy = result.second;
 
           // Check if this chain is either the coldest or the hottest
@@ -151,44 +263,39 @@ namespace stateline
           bool isColdestChainInStack = id % chains_.numChains() == 0;
 
           // Handle the new proposal and add a new state to the chain
-          State propState { propStates_.row(id), energy, chains_.beta(id), false, SwapType::NoAttempt };
-          bool propAccepted = chains_.append(id, propState);
-          lengths_[id] += 1;
-          updateAccepts(id, propAccepted);
+          appendProposal(id, replica, energy);
 
           // Update the convergence test if this is the coldest chain in a stack
-          if (isColdestChainInStack && chains_.numChains() > 1 && chains_.numStacks() > 1)
+          if (isColdestChainInStack && chains_.numStacks() > 1)
           {
             cc.update(id / chains_.numChains(), chains_.lastState(id).sample);
           }
+          if (isColdestChainInStack)
+          {
+            ess.update(id / chains_.numChains(), chains_.lastState(id).sample);
+          }
 
-          // Check if this chain was locked. If it was locked, it means that
-          // the chain above (hotter) locked it so that it can swap with it
-          if (locked_[id])
+          // Once a sweep of the stack, try swapping with the hotter chain
+          // using the latest state of both. The pairs alternate between even
+          // and odd sweeps so neighbouring swaps never compete for a chain
+          uint sweep = stackSweep(id / chains_.numChains());
+          if (!isHottestChainInStack && swapSweeps_[id] != sweep + 1 && (sweep + id % chains_.numChains()) % 2 == 0)
           {
-            // Try swapping this chain with the one above it
-            bool swapAccepted = chains_.swap(id, id + 1);
-            updateSwaps(id + 1, swapAccepted);
-            // Unlock this chain, propgating the lock downwards
-            unlock(policy, id, propFn);
+            steady_clock::time_point swapTime = steady_clock::now();
+            swapSweeps_[id] = sweep + 1;
+            trySwap(id);
+            swapDecisionSeconds_ += duration_cast<duration<double>>(steady_clock::now() - swapTime).count();
           }
-          else if (isHottestChainInStack && lengths_[id] % s_.swapInterval == 0 && chains_.numChains() > 1)
+
+          // The replica proposes again straight away from wherever it ended
+          // up. The hotter replica's outstanding job follows it if swapped
+          try
           {
-            // The hottest chain is ready to swap. Lock the next chain
-            // to prevent it from proposing any more
-            locked_[id - 1] = true;
+            proposeNext(policy, slotOf_[replica], propFn);
           }
-          else
+          catch (...)
           {
-            // This chain is not locked, so we can propose
-            try
-            {
-              propose(policy, id, propFn);
-            }
-            catch (...)
-            {
-              VLOG(3) << "Comms error -- probably shutting down";
-            }
+            VLOG(3) << "Comms error -- probably shutting down";
           }
 
           // Check again after a new interaction with comms
@@ -202,6 +309,7 @@ namespace stateline
           if (lengths_[id] % s_.proposalAdaptInterval == 0)
           {
             adaptSigma(id);
+            adaptBlockSigmas(id);
           }
 
           // Update the temperature which might have changed while waiting
@@ -213,35 +321,21 @@ namespace stateline
             adaptBeta(id);
           }
 
-          // Update the accept and swap rates
-          if (duration_cast<milliseconds>(steady_clock::now() - lastLogTime).count() > 50)
+          // Snapshot the progress for the metrics stream, and for the log
+          // less often. The publisher formats and sends it off this thread
+          bool publishDue = !s_.metricsEndpoint.empty()
+              && duration_cast<milliseconds>(steady_clock::now() - lastPublishTime).count() > s_.metricsInterval;
+          bool printDue = duration_cast<milliseconds>(steady_clock::now() - lastPrintTime).count() > 500;
+          if (publishDue || printDue)
           {
-            lastLogTime = steady_clock::now();
+            lastPublishTime = steady_clock::now();
+            double runSeconds = duration_cast<duration<double>>(steady_clock::now() - startTime).count();
+            publisher.publish(metrics(ess, runSeconds), printDue);
 
-            std::stringstream s;
-            s << "\n\nChainID  Length  MinEngy  CurrEngy    Sigma      AcptRt    GlbAcptRt    Beta     SwapRt   GlbSwapRt\n";
-            s << "-----------------------------------------------------------------------------------------------------\n";
-            for (uint i = 0; i < chains_.numTotalChains(); i++)
-            {
-              if (i % chains_.numChains() == 0 && i != 0)
-                s << '\n';
-              s << std::setprecision(6) << std::showpoint << i << " " << std::setw(9) << lengths_[i] << " " << std::setw(10)
-                  << lowestEnergies_[i] << " " << std::setw(10) << chains_.lastState(i).energy << " " << std::setw(10) << sigmas_[i] << " "
-                  << std::setw(10) << acceptRates_[i] << " " << std::setw(10) << nAcceptsGlobal_[i] / (double) lengths_[i] << " "
-                  << std::setw(10) << betas_[i] << " " << std::setw(10) << swapRates_[i] << " " << std::setw(10)
-                  << nSwapsGlobal_[i] / (double) nSwapAttemptsGlobal_[i] << " \n";
-            }
-
-            // Quick and dirty way to get the data to the visualisation server
-            comms::sendString(publisher, s.str());
-
-            if (duration_cast<milliseconds>(steady_clock::now() - lastPrintTime).count() > 500)
+            if (printDue)
             {
               lastPrintTime = steady_clock::now();
-
-              LOG(INFO)<< s.str() << "\n";
-
-              if (chains_.numStacks() > 1 && chains_.numChains() > 1)
+              if (chains_.numStacks() > 1)
               {
                 if (cc.hasConverged())
                 {
@@ -254,6 +348,31 @@ namespace stateline
               }
             }
           }
+
+          // Write every chain out so the run can be recovered from here
+          if (s_.checkpointInterval > 0
+              && duration_cast<seconds>(steady_clock::now() - lastCheckpointTime).count() >= s_.checkpointInterval)
+          {
+            lastCheckpointTime = steady_clock::now();
+            for (uint i = 0; i < chains_.numTotalChains(); i++)
+            {
+              chains_.flushCache(i);
+            }
+            VLOG(1) << "Checkpointed all chains";
+          }
+
+          // Stop early once the targets are met. The outstanding jobs are
+          // drained below as for the wall time
+          if (duration_cast<seconds>(steady_clock::now() - lastTargetTime).count() >= 1)
+          {
+            lastTargetTime = steady_clock::now();
+            targetsMet = hasMetTargets(cc, ess, s_.targetRHat, s_.targetEss);
+            if (targetsMet)
+            {
+              LOG(INFO)<< "Sampling targets met after "
+                  << duration_cast<seconds>(steady_clock::now() - startTime).count() << " seconds";
+            }
+          }
         }
 
         // Time limit reached. We need to now retrieve all outstanding job results.
@@ -261,13 +380,17 @@ namespace stateline
         {
           while (numOutstandingJobs_--)
           {
-            auto result = policy.retrieve();
-            uint id = result.first;
-            double energy = result.second;
-            State propState { propStates_.row(id), energy, chains_.beta(id), false, SwapType::NoAttempt };
-            bool propAccepted = chains_.append(id, propState);
-            lengths_[id] += 1;
-            updateAccepts(id, propAccepted);
+            auto result = retrieve(policy);
+            appendProposal(slotOf_[result.first], result.first, result.second);
+          }
+          // Speculative jobs still running are of no use now
+          for (; nSpeculativeJobs_ > 0; nSpeculativeJobs_--)
+          {
+            policy.retrieve();
+          }
+          if (speculate_)
+          {
+            LOG(INFO)<< "Speculative proposals used: " << nSpeculationHits_ << " of " << nSpeculated_;
           }
         }
         else
@@ -280,6 +403,7 @@ namespace stateline
         {
           chains_.flushCache(i);
         }
+        chains_.sync();
 
         if (cc.hasConverged())
         {
@@ -295,9 +419,9 @@ namespace stateline
 
     //! Get the MCMC chain array.
     //!
-    //! \return A copy of the chain array.
+    //! \return A reference to the chain array.
     //!
-    ChainArray chains()
+    ChainArray &chains()
     {
       return chains_;
     }
@@ -311,6 +435,16 @@ namespace stateline
       return chains_;
     }
 
+    //! Get the proposal widths of the blocks of a chain.
+    //!
+    //! \param id The id of the chain.
+    //! \return The width of each block; empty without block updates.
+    //!
+    const std::vector<double> &blockSigmas(uint id) const
+    {
+      return blockSigmas_[id];
+    }
+
   private:
 
     //! Initialise the sampler.
@@ -337,10 +471,13 @@ namespace stateline
         State s
         { initialStates[id], energy, chains_.beta(id), true, SwapType::NoAttempt};
         chains_.initialise(id, s);
+        if (gradientFn_)
+          gradients_[id] = gradientFn_(id);
       }
     }
 
-    //! Propose a new state through an async policy.
+    //! Propose a new state through an async policy. The job is tagged with
+    //! the replica currently held by the chain.
     //!
     //! \param policy Async policy to evaluate proposals.
     //! \param id The id of the chain that is proposing.
@@ -349,38 +486,571 @@ namespace stateline
     template <class AsyncPolicy, class PropFn>
     void propose(AsyncPolicy &policy, uint id, PropFn &propFn)
     {
-      propStates_.row(id) = propFn(chains_.lastState(id).sample, chains_.sigma(id));
-      policy.submit(id, propStates_.row(id));
+      uint replica = replicaAt_[id];
+      propLogRatios_[replica] = 0.0;
+      propLangevin_[replica] = false;
+      propBlocks_[replica] = -1;
+      propEnsemble_[replica] = s_.proposalEnsemble != EnsembleMove::None && uniform_(chains_.generator(id)) < s_.proposalEnsembleRate
+          && ensembleProposal(id, replica);
+      if (propEnsemble_[replica])
+      {
+        nEnsembleProposed_++;
+      }
+      else if (gradients_[id].size() > 0)
+      {
+        propLangevin_[replica] = true;
+        // Remember the step the proposal was made with to correct for it
+        propSigmas_[replica] = chains_.sigma(id);
+        propBetas_[replica] = chains_.beta(id);
+        propStates_.row(replica) = langevinProposal(chains_.lastState(id).sample, gradients_[id], chains_.sigma(id), chains_.beta(id),
+                                                    chains_.generator(id));
+      }
+      else if (!blocks_.empty())
+      {
+        // Metropolis-within-Gibbs: only the block moves
+        uint block = nextBlock(id);
+        uint begin = blocks_[block];
+        propStates_.row(replica) = propFn(chains_.lastState(id).sample, blockSigmas_[id][block], chains_.covariance(id),
+                                          chains_.generator(id), begin, blocks_[block + 1] - begin);
+        propBlocks_[replica] = block;
+      }
+      else
+      {
+        propStates_.row(replica) = propFn(chains_.lastState(id).sample, chains_.sigma(id), chains_.covariance(id),
+                                          chains_.generator(id), 0, propStates_.cols());
+      }
       numOutstandingJobs_++;
+      nProposed_++;
+
+      // First stage of delayed acceptance: proposals rejected on the
+      // screening energy are never sent to the policy. A step that does not
+      // go up in screening energy always passes and draws nothing, so where a
+      // flat prior screens, its rejections leave the chain as an infinite
+      // energy from the policy would
+      propSurrogateDeltas_[replica] = std::numeric_limits<double>::quiet_NaN();
+      propScreenBetas_[replica] = chains_.beta(id);
+      if (screenFn_)
+      {
+        propScreenEnergies_[replica] = screenFn_(propStates_.row(replica));
+        double screened = screenedDeltaEnergy(id, replica);
+        if (std::isinf(propScreenEnergies_[replica])
+            || (screened > 0.0 && !acceptEnergyDelta(screened, chains_.beta(id), chains_.generator(id))))
+        {
+          screenRejected_.push(replica);
+          nScreened_++;
+          return;
+        }
+      }
+      if (hasSurrogate_ && !surrogateScreen(id, replica))
+      {
+        screenRejected_.push(replica);
+        nScreened_++;
+        return;
+      }
+
+      policy.submit(replica, propStates_.row(replica), jobPriority(id));
     }
 
-    //! Unlock a chain and reactivate any chains that were waiting for it.
+    //! The priority of a proposal of a chain in the policy's queue: the
+    //! number of queued proposals it may go ahead of. With the coldest chains
+    //! first, a proposal goes ahead of the proposals of one chain of each
+    //! stack for each temperature it is colder than the hottest, so the
+    //! hotter chains wait longer but are never starved.
     //!
-    //! \param policy Async policy to evulate proposals.
-    //! \param id The id of the chain to unlock.
+    //! \param id The id of the chain that is proposing.
+    //! \return The priority.
+    //!
+    int jobPriority(uint id) const
+    {
+      if (s_.jobPriority == JobPriority::Coldest)
+        return (chains_.numChains() - 1 - id % chains_.numChains()) * chains_.numStacks();
+      return 0;
+    }
+
+    //! Propose the next state of a chain. With speculation, the proposal made
+    //! ahead of time for the state the chain is now in is used if there is
+    //! one, and the tree of proposals after it is extended to the speculation
+    //! depth.
+    //!
+    //! \param policy Async policy to evaluate proposals.
+    //! \param id The id of the chain that is proposing.
     //! \param propFn The proposal function.
     //!
     template <class AsyncPolicy, class PropFn>
-    void unlock(AsyncPolicy &policy, uint id, PropFn &propFn)
+    void proposeNext(AsyncPolicy &policy, uint id, PropFn &propFn)
     {
-      // Unlock this chain
-      locked_[id] = false;
+      if (!speculate_)
+      {
+        propose(policy, id, propFn);
+        return;
+      }
+      uint replica = replicaAt_[id];
+      if (!useSpeculation(id, replica))
+      {
+        propose(policy, id, propFn);
+        rootJobs_[replica] = replica;
+      }
+      if (!specGrown_[replica])
+      {
+        specChildren_[replica] = speculateChildren(policy, id, propStates_.row(replica), chains_.lastState(id).sample,
+                                                   chains_.sigma(id), chains_.generator(id), 1, propFn);
+        specGrown_[replica] = true;
+      }
+      for (uint job : specChildren_[replica])
+      {
+        growSpeculation(policy, id, job, 2, propFn);
+      }
+    }
 
-      // The hotter chain no longer has to wait for this chain, so
-      // it can propose new state
-      propose(policy, id + 1, propFn);
+    //! Make the outstanding proposal of a replica the speculative proposal
+    //! that assumed the chain's current state, proposal width and generator,
+    //! if there is one. A speculation matching all three is exactly the
+    //! proposal propose() would make. The other speculations are cancelled.
+    //!
+    //! \param id The id of the chain holding the replica.
+    //! \param replica The id of the replica.
+    //! \return Whether a speculative proposal was used.
+    //!
+    bool useSpeculation(uint id, uint replica)
+    {
+      if (!specGrown_[replica])
+        return false;
+      specGrown_[replica] = false;
 
-      // Check if this was the coldest chain
-      if (id % chains_.numChains() != 0)
+      // The generator identifies the chain too, as each chain has a stream
+      int match = -1;
+      for (uint branch = 0; branch < 2; branch++)
       {
-        // Lock the chain that is below (colder) than this.
-        locked_[id - 1] = true;
+        const Speculation& spec = speculations_.at(specChildren_[replica][branch]);
+        if (match < 0 && spec.sigma == chains_.sigma(id) && spec.gen == chains_.generator(id)
+            && spec.base == chains_.lastState(id).sample)
+          match = branch;
+      }
+      for (uint branch = 0; branch < 2; branch++)
+      {
+        if ((int)branch != match)
+          cancelSpeculation(specChildren_[replica][branch]);
+      }
+      if (match < 0)
+        return false;
+
+      uint job = specChildren_[replica][match];
+      Speculation spec = std::move(speculations_.at(job));
+      speculations_.erase(job);
+      propStates_.row(replica) = spec.proposal;
+      chains_.generator(id) = spec.propGen;
+      propLogRatios_[replica] = 0.0;
+      propLangevin_[replica] = false;
+      propBlocks_[replica] = -1;
+      propEnsemble_[replica] = false;
+      specGrown_[replica] = spec.grown;
+      specChildren_[replica] = spec.children;
+      numOutstandingJobs_++;
+      nProposed_++;
+      nSpeculationHits_++;
+      if (spec.returned)
+      {
+        specReady_.push(std::make_pair(replica, spec.energy));
       }
       else
       {
-        // This is the coldest chain and there is no one to swap with
-        propose(policy, id, propFn);
+        // No longer speculative: its result is the replica's
+        nSpeculativeJobs_--;
+        rootJobs_[job] = replica;
       }
+      return true;
+    }
+
+    //! Submit the proposals a chain would make after each outcome of a
+    //! proposal.
+    //!
+    //! \param policy Async policy to evaluate proposals.
+    //! \param id The id of the chain that is proposing.
+    //! \param proposal The proposal.
+    //! \param base The state the proposal moves from.
+    //! \param sigma The proposal width.
+    //! \param gen The generator of the chain after making the proposal.
+    //! \param depth The number of steps the new proposals are ahead. Deeper
+    //!        proposals are less likely to be used, so they queue behind.
+    //! \param propFn The proposal function.
+    //! \return The jobs of the proposals after a rejection and after an
+    //!         acceptance.
+    //!
+    template <class AsyncPolicy, class PropFn>
+    std::array<uint, 2> speculateChildren(AsyncPolicy &policy, uint id, const Eigen::VectorXd& proposal,
+                                          const Eigen::VectorXd& base, double sigma, const PhiloxGenerator& gen,
+                                          uint depth, PropFn &propFn)
+    {
+      // Deciding on the proposal draws one uniform number. It draws none for
+      // an infinite energy, so those outcomes are never matched
+      PhiloxGenerator next = gen;
+      std::uniform_real_distribution<>()(next);
+
+      std::array<uint, 2> jobs;
+      for (uint accepted = 0; accepted < 2; accepted++)
+      {
+        uint job = nextJob_;
+        nextJob_ = std::max(nextJob_ + 1, chains_.numTotalChains());
+        Speculation& spec = speculations_[job];
+        spec.base = accepted ? proposal : base;
+        spec.sigma = sigma;
+        spec.gen = next;
+        spec.propGen = next;
+        spec.proposal = propFn(spec.base, sigma, chains_.covariance(id), spec.propGen, 0, spec.base.size());
+        spec.returned = false;
+        spec.grown = false;
+        policy.submit(job, spec.proposal, -(int)(depth * chains_.numTotalChains()));
+        nSpeculativeJobs_++;
+        nSpeculated_++;
+        jobs[accepted] = job;
+      }
+      return jobs;
+    }
+
+    //! Extend the tree of speculative proposals below a speculation.
+    //!
+    //! \param policy Async policy to evaluate proposals.
+    //! \param id The id of the chain that is proposing.
+    //! \param job The job of the speculation.
+    //! \param depth The number of steps the speculation is ahead.
+    //! \param propFn The proposal function.
+    //!
+    template <class AsyncPolicy, class PropFn>
+    void growSpeculation(AsyncPolicy &policy, uint id, uint job, uint depth, PropFn &propFn)
+    {
+      if (depth > s_.speculationDepth)
+        return;
+      Speculation& spec = speculations_.at(job);
+      if (!spec.grown)
+      {
+        spec.children = speculateChildren(policy, id, spec.proposal, spec.base, spec.sigma, spec.propGen, depth, propFn);
+        spec.grown = true;
+      }
+      for (uint child : spec.children)
+      {
+        growSpeculation(policy, id, child, depth + 1, propFn);
+      }
+    }
+
+    //! Cancel a speculation and everything below it. The policies cannot
+    //! take jobs back, so the results of running jobs are dropped on arrival.
+    //!
+    //! \param job The job of the speculation.
+    //!
+    void cancelSpeculation(uint job)
+    {
+      auto spec = speculations_.find(job);
+      if (spec->second.grown)
+      {
+        for (uint child : spec->second.children)
+          cancelSpeculation(child);
+      }
+      speculations_.erase(spec);
+    }
+
+    //! Screen the proposal of a replica on the surrogate, after any screening
+    //! energy. The surrogate only screens if it is confident about both the
+    //! current state and the proposal; the choice is the same either way
+    //! round, so the chain keeps its target.
+    //!
+    //! \param id The id of the chain holding the replica.
+    //! \param replica The id of the replica.
+    //! \return False if the surrogate rejects the proposal.
+    //!
+    bool surrogateScreen(uint id, uint replica)
+    {
+      double energy = surrogateEnergy(propStates_.row(replica));
+      if (std::isnan(energy) || std::isnan(surrogateEnergies_[id]))
+        return true;
+      // This stage corrects for the screening energy, if there is one
+      double screened = screenedDeltaEnergy(id, replica);
+      propSurrogateDeltas_[replica] = energy - surrogateEnergies_[id];
+      return acceptEnergyDelta(propSurrogateDeltas_[replica] - screened, chains_.beta(id), chains_.generator(id));
+    }
+
+    //! The energy of a state predicted by the surrogate.
+    //!
+    //! \param state The state.
+    //! \return The energy, or NaN if the surrogate is not confident about it.
+    //!
+    double surrogateEnergy(const Eigen::VectorXd& state) const
+    {
+      double sd;
+      double energy = predictEnergy(surrogate_, state, sd);
+      return sd < s_.surrogateMaxError ? energy : std::numeric_limits<double>::quiet_NaN();
+    }
+
+    //! Add an evaluated proposal to the training states of the surrogate,
+    //! and refit it every refit interval. The fit runs in the background and
+    //! is put in use at the next refit. If it is still running then, the
+    //! sampler waits for it, so the surrogate always changes after the same
+    //! number of evaluations and runs with the same seed replay.
+    //!
+    //! \param state The proposed state.
+    //! \param energy Its energy.
+    //!
+    void trainSurrogate(const Eigen::VectorXd& state, double energy)
+    {
+      trainingStates_.push_back(state);
+      trainingEnergies_.push_back(energy);
+      nTrained_++;
+      if (nTrained_ % s_.surrogateRefitInterval != 0)
+        return;
+
+      if (surrogateFit_.valid())
+      {
+        surrogate_ = surrogateFit_.get();
+        hasSurrogate_ = true;
+        for (uint i = 0; i < chains_.numTotalChains(); i++)
+          surrogateEnergies_[i] = surrogateEnergy(chains_.lastState(i).sample);
+        VLOG(1) << "Refitted the surrogate to " << trainingStates_.size() << " evaluations";
+      }
+
+      std::vector<Eigen::VectorXd> states(trainingStates_.begin(), trainingStates_.end());
+      std::vector<double> energies(trainingEnergies_.begin(), trainingEnergies_.end());
+      PhiloxGenerator gen(chains_.seed(), chains_.numTotalChains(), nSurrogateFits_++);
+      uint nFeatures = s_.surrogateFeatures;
+      double lengthScale = s_.surrogateLengthScale;
+      surrogateFit_ = std::async(std::launch::async, [states, energies, nFeatures, lengthScale, gen]() mutable
+      {
+        return fitSurrogate(states, energies, nFeatures, lengthScale, gen);
+      });
+    }
+
+    //! Choose the block the next proposal of a chain moves.
+    //!
+    //! \param id The id of the chain that is proposing.
+    //! \return The index of the block.
+    //!
+    uint nextBlock(uint id)
+    {
+      uint nBlocks = blocks_.size() - 1;
+      if (s_.proposalBlocks == BlockUpdate::Random)
+        return std::uniform_int_distribution<uint>(0, nBlocks - 1)(chains_.generator(id));
+      uint block = nextBlock_[id];
+      nextBlock_[id] = (block + 1) % nBlocks;
+      return block;
+    }
+
+    //! Propose a new state for a replica from the current states of the chains
+    //! at the same temperature in the other stacks.
+    //!
+    //! The moves keep the target only while the rest of the ensemble holds
+    //! still. Here the other chains carry on moving while the proposal is
+    //! evaluated, so it is accepted against an ensemble that may have moved
+    //! on, and the chain is only approximately invariant. The error is small
+    //! when the ensemble changes slowly next to the time a proposal takes,
+    //! and the usual proposals made the rest of the time are exact.
+    //!
+    //! \param id The id of the chain that is proposing.
+    //! \param replica The id of the replica held by the chain.
+    //! \return False if there are too few other stacks for the move.
+    //!
+    bool ensembleProposal(uint id, uint replica)
+    {
+      uint level = id % chains_.numChains();
+      std::vector<Eigen::VectorXd> ensemble;
+      for (uint k = 0; k < chains_.numStacks(); k++)
+      {
+        uint other = k * chains_.numChains() + level;
+        if (other != id)
+          ensemble.push_back(chains_.lastState(other).sample);
+      }
+
+      Eigen::VectorXd state = chains_.lastState(id).sample;
+      if (s_.proposalEnsemble == EnsembleMove::DifferentialEvolution && ensemble.size() >= 2)
+        propStates_.row(replica) = differentialEvolutionProposal(state, ensemble, chains_.generator(id));
+      else if (s_.proposalEnsemble == EnsembleMove::Stretch && ensemble.size() >= 1)
+        propStates_.row(replica) = stretchProposal(state, ensemble, chains_.generator(id), propLogRatios_[replica]);
+      else
+        return false;
+      return true;
+    }
+
+    //! Take a snapshot of the progress of the sampler.
+    //!
+    //! \param ess The effective sample size of the coldest chains.
+    //! \param runSeconds Seconds since the sampler started.
+    //! \return The metrics snapshot.
+    //!
+    Metrics metrics(const EffectiveSampleSize &ess, double runSeconds)
+    {
+      Metrics m;
+      m.seconds = runSeconds;
+      m.numChains = chains_.numChains();
+      m.chains.resize(chains_.numTotalChains());
+      for (uint i = 0; i < chains_.numTotalChains(); i++)
+      {
+        m.chains[i] = ChainMetrics { lengths_[i], lowestEnergies_[i], chains_.lastState(i).energy, sigmas_[i], acceptRates_[i],
+                                     nAcceptsGlobal_[i] / (double) lengths_[i], betas_[i], swapRates_[i],
+                                     nSwapsGlobal_[i] / (double) nSwapAttemptsGlobal_[i] };
+      }
+      // The worst dimension of the coldest chains of all stacks, per second
+      // and per forward model evaluation of this run
+      m.ess = ess.ess().minCoeff();
+      m.essPerSecond = m.ess / runSeconds;
+      m.essPerEvaluation = m.ess / std::max(nProposed_ - nScreened_ + nSpeculated_ - nSpeculationHits_, 1ULL);
+      m.screening = screenFn_ || hasSurrogate_;
+      m.nProposed = nProposed_;
+      m.nScreened = nScreened_;
+      m.ensemble = s_.proposalEnsemble != EnsembleMove::None;
+      m.nEnsembleProposed = nEnsembleProposed_;
+      m.nEnsembleAccepted = nEnsembleAccepted_;
+      m.speculation = speculate_;
+      m.nSpeculated = nSpeculated_;
+      m.nSpeculationHits = nSpeculationHits_;
+      m.swapDecisionSeconds = swapDecisionSeconds_;
+      return m;
+    }
+
+    //! Retrieve the next proposal result, returning proposals rejected by the
+    //! screening stage and speculative proposals that already have a result
+    //! first.
+    //!
+    //! \param policy Async policy to evaluate proposals.
+    //! \return The replica id and the energy of its proposal.
+    //!
+    template <class AsyncPolicy>
+    std::pair<uint, double> retrieve(AsyncPolicy &policy)
+    {
+      if (!screenRejected_.empty())
+      {
+        uint replica = screenRejected_.front();
+        screenRejected_.pop();
+        return std::make_pair(replica, std::numeric_limits<double>::infinity());
+      }
+      if (!specReady_.empty())
+      {
+        auto result = specReady_.front();
+        specReady_.pop();
+        return result;
+      }
+      if (!speculate_)
+        return policy.retrieve();
+
+      // Keep the results of speculative jobs until their proposal is made
+      while (true)
+      {
+        auto result = policy.retrieve();
+        auto root = rootJobs_.find(result.first);
+        if (root != rootJobs_.end())
+        {
+          uint replica = root->second;
+          rootJobs_.erase(root);
+          return std::make_pair(replica, result.second);
+        }
+        nSpeculativeJobs_--;
+        // Results of cancelled speculations are dropped
+        auto spec = speculations_.find(result.first);
+        if (spec != speculations_.end())
+        {
+          spec->second.returned = true;
+          spec->second.energy = result.second;
+        }
+      }
+    }
+
+    //! The change in energy of the proposal of a replica on the last
+    //! screening stage it passed, in units of the temperature of the chain
+    //! now holding it. Zero if the current state has no finite screening
+    //! energy to compare against.
+    //!
+    //! \param id The id of the chain holding the replica.
+    //! \param replica The id of the replica.
+    //!
+    double screenedDeltaEnergy(uint id, uint replica) const
+    {
+      double delta;
+      if (!std::isnan(propSurrogateDeltas_[replica]))
+        delta = propSurrogateDeltas_[replica];
+      else if (screenFn_ && !std::isinf(screenEnergies_[id]))
+        delta = propScreenEnergies_[replica] - screenEnergies_[id];
+      else
+        return 0.0;
+      // The replica may have been swapped to another temperature after it
+      // was screened
+      return delta * propScreenBetas_[replica] / chains_.beta(id);
+    }
+
+    //! Accept or reject the outstanding proposal of a replica given its energy.
+    //!
+    //! \param id The id of the chain holding the replica.
+    //! \param replica The id of the replica.
+    //! \param energy The energy of the proposed state.
+    //!
+    void appendProposal(uint id, uint replica, double energy)
+    {
+      double correction = screenedDeltaEnergy(id, replica) + propLogRatios_[replica] / chains_.beta(id);
+      if (gradientFn_)
+      {
+        propGradients_[replica] = gradientFn_(replica);
+        if (propLangevin_[replica] && !std::isinf(energy))
+        {
+          // Without the gradient at the proposal the reverse move is unknown
+          if (propGradients_[replica].size() == 0)
+            energy = std::numeric_limits<double>::infinity();
+          else
+            correction += langevinLogProposalRatio(chains_.lastState(id).sample, propStates_.row(replica), gradients_[id],
+                                                   propGradients_[replica], propSigmas_[replica], propBetas_[replica])
+                / chains_.beta(id);
+        }
+      }
+      State propState { propStates_.row(replica), energy, chains_.beta(id), false, SwapType::NoAttempt };
+      bool propAccepted = chains_.append(id, propState, correction);
+      if (propAccepted && screenFn_)
+        screenEnergies_[id] = propScreenEnergies_[replica];
+      if (propAccepted && hasSurrogate_)
+        surrogateEnergies_[id] = surrogateEnergy(propStates_.row(replica));
+      if (s_.surrogateFeatures > 0 && std::isfinite(energy))
+        trainSurrogate(propStates_.row(replica), energy);
+      if (propAccepted && gradientFn_)
+        gradients_[id].swap(propGradients_[replica]);
+      if (propAccepted && propEnsemble_[replica])
+        nEnsembleAccepted_++;
+      if (propBlocks_[replica] >= 0)
+      {
+        // Counted against the chain the proposal ends up in, like its sigma
+        blockProposals_[id][propBlocks_[replica]]++;
+        blockAccepts_[id][propBlocks_[replica]] += propAccepted;
+      }
+      if (s_.proposalCovarianceLength > 0)
+        chains_.adaptCovariance(id, 1.0 / (s_.proposalCovarianceLength + lengths_[id] + 1));
+      lengths_[id] += 1;
+      updateAccepts(id, propAccepted);
+    }
+
+    //! Get the sweep a stack is on: the number of swap intervals that every
+    //! chain in it has completed. Unlike the length of one chain, it does not
+    //! depend on the order the results of the stack arrive in.
+    //!
+    //! \param stack The index of the stack.
+    //! \return The sweep.
+    //!
+    uint stackSweep(uint stack)
+    {
+      auto first = lengths_.begin() + stack * chains_.numChains();
+      return *std::min_element(first, first + chains_.numChains()) / s_.swapInterval;
+    }
+
+    //! Try swapping the latest states of a chain and the next hotter chain.
+    //! Neither chain waits: an outstanding proposal moves with its replica
+    //! and is accepted or rejected at its new temperature.
+    //!
+    //! \param id The id of the colder chain.
+    //!
+    void trySwap(uint id)
+    {
+      bool swapAccepted = chains_.swap(id, id + 1);
+      if (swapAccepted)
+      {
+        std::swap(screenEnergies_[id], screenEnergies_[id + 1]);
+        std::swap(surrogateEnergies_[id], surrogateEnergies_[id + 1]);
+        gradients_[id].swap(gradients_[id + 1]);
+        std::swap(replicaAt_[id], replicaAt_[id + 1]);
+        slotOf_[replicaAt_[id]] = id;
+        slotOf_[replicaAt_[id + 1]] = id + 1;
+      }
+      updateSwaps(id + 1, swapAccepted);
     }
 
     //! Return a new proposal step size for a chain.
@@ -410,6 +1080,28 @@ namespace stateline
       return newSigma;
     }
 
+    //! Adapt the proposal width of each block of a chain on its acceptance
+    //! rate since the last adaption, in the same way as adaptSigma().
+    //!
+    //! \param id The id of the chain to be adapted.
+    //!
+    void adaptBlockSigmas(uint id)
+    {
+      double gamma = s_.adaptionLength/(double)(s_.adaptionLength+lengths_[id]);
+      for (uint b = 0; b < blockSigmas_[id].size(); b++)
+      {
+        if (blockProposals_[id][b] == 0)
+          continue;
+        double acceptRate = blockAccepts_[id][b] / (double)blockProposals_[id][b];
+        double factor = std::pow(acceptRate / s_.proposalOptimalAccept, s_.proposalAdaptRate);
+        double boundFactor = std::min(std::max(factor, s_.proposalMinFactor), s_.proposalMaxFactor);
+        blockSigmas_[id][b] *= std::pow(boundFactor, gamma);
+        VLOG(2) << "Adapting Sigma" << id << " block " << b << ":" << blockSigmas_[id][b] << " @acceptrate:" << acceptRate;
+        blockAccepts_[id][b] = 0;
+        blockProposals_[id][b] = 0;
+      }
+    }
+
     //! Adapt a new temperature for a chain.
     //!
     //! \param id The id of the chain to be adapted.
@@ -504,12 +1196,17 @@ namespace stateline
     // lengths of the chains
     std::vector<uint> lengths_;
 
+    // The sweep of its stack in which each chain last tried swapping with
+    // the next hotter chain, plus one; zero if it never has
+    std::vector<uint> swapSweeps_;
+
     // Matrix of proposed states
     Eigen::MatrixXd propStates_;
 
-    // Whether a chain is locked. A locked chain will wait for any outstanding
-    // job results and propagate the lock.
-    std::vector<bool> locked_;
+    // The replica held by each chain, and the chain holding each replica.
+    // Proposals belong to replicas so that swapping never waits for a job
+    std::vector<uint> replicaAt_;
+    std::vector<uint> slotOf_;
 
     // Cache the next temperature as computed by lower chains in the stack
     std::vector<double> nextChainBeta_;
@@ -529,6 +1226,106 @@ namespace stateline
     std::vector<double> swapRates_;
     std::vector<double> lowestEnergies_;
 
+    // Delayed acceptance screening energy and its values for the current and
+    // proposed states
+    ScreenFn screenFn_;
+    std::vector<double> screenEnergies_;
+    std::vector<double> propScreenEnergies_;
+    std::vector<double> propScreenBetas_;
+
+    // The learned surrogate of the energy once there is one, and the fit
+    // running in the background. The surrogate energy of each current state
+    // and the change in surrogate energy each outstanding proposal was
+    // screened on, NaN where the surrogate did not screen
+    bool hasSurrogate_;
+    EnergySurrogate surrogate_;
+    std::future<EnergySurrogate> surrogateFit_;
+    std::vector<double> surrogateEnergies_;
+    std::vector<double> propSurrogateDeltas_;
+
+    // The most recent evaluations, to fit the surrogate to, the number of
+    // evaluations so far and the number of fits started
+    boost::circular_buffer<Eigen::VectorXd> trainingStates_;
+    boost::circular_buffer<double> trainingEnergies_;
+    unsigned long long nTrained_;
+    uint nSurrogateFits_;
+
+    // Energy gradients of the current and proposed states, and the Langevin
+    // step each outstanding proposal was made with
+    GradientFn gradientFn_;
+    std::vector<Eigen::VectorXd> gradients_;
+    std::vector<Eigen::VectorXd> propGradients_;
+    std::vector<bool> propLangevin_;
+    std::vector<double> propSigmas_;
+    std::vector<double> propBetas_;
+
+    // The log proposal ratio of each outstanding ensemble proposal, and
+    // counts of ensemble proposals for logging
+    std::vector<double> propLogRatios_;
+    std::vector<bool> propEnsemble_;
+    unsigned long long nEnsembleProposed_;
+    unsigned long long nEnsembleAccepted_;
+
+    // Offsets of the blocks of block-wise updates (empty if disabled), the
+    // proposal width and acceptance counts of each block of each chain, the
+    // next block of each chain when cycling, and the block each outstanding
+    // proposal moved (-1 for a full proposal)
+    std::vector<uint> blocks_;
+    std::vector<std::vector<double>> blockSigmas_;
+    std::vector<std::vector<uint>> blockAccepts_;
+    std::vector<std::vector<uint>> blockProposals_;
+    std::vector<uint> nextBlock_;
+    std::vector<int> propBlocks_;
+
+    // For choosing ensemble proposals with the generator of the chain
+    std::uniform_real_distribution<> uniform_;
+
+    // Proposals rejected by screening, waiting to be returned as results
+    std::queue<uint> screenRejected_;
+    unsigned long long nScreened_;
+    unsigned long long nProposed_;
+
+    // A proposal made ahead of time, with what it assumed about the chain:
+    // the state it moves from, the proposal width and the generator before
+    // and after proposing. It keeps its result until its turn, and the
+    // speculations after each of its outcomes once grown
+    struct Speculation
+    {
+      Eigen::VectorXd base;
+      double sigma;
+      PhiloxGenerator gen;
+      Eigen::VectorXd proposal;
+      PhiloxGenerator propGen;
+      bool returned;
+      double energy;
+      bool grown;
+      std::array<uint, 2> children;
+    };
+
+    // Whether speculation is on, the speculations by job, and the
+    // speculations after each outcome of the outstanding proposal of each
+    // replica
+    bool speculate_;
+    std::map<uint, Speculation> speculations_;
+    std::vector<bool> specGrown_;
+    std::vector<std::array<uint, 2>> specChildren_;
+
+    // The replica of each outstanding non-speculative job, and replicas
+    // whose proposal has a result already
+    std::map<uint, uint> rootJobs_;
+    std::queue<std::pair<uint, double>> specReady_;
+
+    // The next speculative job id, the number of speculative jobs running,
+    // and counts of speculations made and used
+    uint nextJob_;
+    uint nSpeculativeJobs_;
+    unsigned long long nSpeculated_;
+    unsigned long long nSpeculationHits_;
+
+    // Time spent deciding swaps between retrieving a result and proposing
+    // again
+    double swapDecisionSeconds_;
+
     // The MCMC settings
     MCMCSettings s_;
 
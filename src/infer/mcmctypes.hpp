@@ -11,6 +11,8 @@
 #pragma once
 
 #include <Eigen/Core>
+#include <functional>
+#include <vector>
 
 namespace stateline
 {
@@ -50,11 +52,94 @@ namespace stateline
       SwapType swapType;
     };
 
+    //! A snapshot of the progress of one chain, for monitoring.
+    //!
+    struct ChainMetrics
+    {
+      //! The number of states in the chain.
+      uint length;
+
+      //! The lowest energy the chain has visited in this run.
+      double lowestEnergy;
+
+      //! The energy of the current state.
+      double energy;
+
+      //! The proposal width.
+      double sigma;
+
+      //! The acceptance rate over the adaption window.
+      double acceptRate;
+
+      //! The acceptance rate over the whole run.
+      double globalAcceptRate;
+
+      //! The inverse temperature.
+      double beta;
+
+      //! The swap rate with the next colder chain over the adaption window.
+      double swapRate;
+
+      //! The swap rate with the next colder chain over the whole run.
+      double globalSwapRate;
+    };
+
+    //! A snapshot of the progress of the sampler, for monitoring.
+    //!
+    struct Metrics
+    {
+      //! Seconds since the sampler started.
+      double seconds;
+
+      //! The number of chains in each stack.
+      uint numChains;
+
+      //! The metrics of every chain, ordered by chain id.
+      std::vector<ChainMetrics> chains;
+
+      //! The effective sample size of the worst dimension of the coldest
+      //! chains, and that per second and per evaluation.
+      double ess;
+      double essPerSecond;
+      double essPerEvaluation;
+
+      //! Whether delayed acceptance is screening proposals, and how many
+      //! proposals were made and screened out.
+      bool screening;
+      unsigned long long nProposed;
+      unsigned long long nScreened;
+
+      //! Whether ensemble proposals are enabled, and how many were made and
+      //! accepted.
+      bool ensemble;
+      unsigned long long nEnsembleProposed;
+      unsigned long long nEnsembleAccepted;
+
+      //! Whether chains evaluate proposals speculatively, and how many
+      //! speculative proposals were made and used.
+      bool speculation;
+      unsigned long long nSpeculated;
+      unsigned long long nSpeculationHits;
+
+      //! The time spent deciding swaps. A swap only uses the latest states of
+      //! the pair, so it never waits for a job and causes no idle time of its
+      //! own; this is the time it adds before the chain is resubmitted.
+      double swapDecisionSeconds;
+    };
+
     //! Type representing proposal acceptance functions.
     using PropAcceptFn = std::function<bool(const State&, const State&, double)>;
 
     //! Type representing swap acceptance functions.
     using SwapAcceptFn = std::function<bool(const State&, const State&, double, double)>;
 
+    //! Type representing cheap energy functions used to screen proposals
+    //! before they are evaluated in full.
+    using ScreenFn = std::function<double(const Eigen::VectorXd&)>;
+
+    //! Type representing functions that return the gradient of the energy of
+    //! the last evaluated proposal of a job (empty if there is none).
+    using GradientFn = std::function<Eigen::VectorXd(uint)>;
+
   }
 }
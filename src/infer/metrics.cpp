@@ -0,0 +1,126 @@
+//!
+//! Contains the implementation for publishing the progress of the sampler.
+//!
+//! \file infer/metrics.cpp
+//! \date 2026
+//! \license Affero General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include "infer/metrics.hpp"
+
+#include <iomanip>
+#include <memory>
+#include <sstream>
+#include <glog/logging.h>
+
+#include "serial/mcmc.hpp"
+
+namespace stateline
+{
+  namespace mcmc
+  {
+    std::string renderMetrics(const Metrics& m)
+    {
+      std::stringstream s;
+      s << "\n\nChainID  Length  MinEngy  CurrEngy    Sigma      AcptRt    GlbAcptRt    Beta     SwapRt   GlbSwapRt\n";
+      s << "-----------------------------------------------------------------------------------------------------\n";
+      for (uint i = 0; i < m.chains.size(); i++)
+      {
+        const ChainMetrics& c = m.chains[i];
+        if (i % m.numChains == 0 && i != 0)
+          s << '\n';
+        s << std::setprecision(6) << std::showpoint << i << " " << std::setw(9) << c.length << " " << std::setw(10) << c.lowestEnergy
+            << " " << std::setw(10) << c.energy << " " << std::setw(10) << c.sigma << " " << std::setw(10) << c.acceptRate << " "
+            << std::setw(10) << c.globalAcceptRate << " " << std::setw(10) << c.beta << " " << std::setw(10) << c.swapRate << " "
+            << std::setw(10) << c.globalSwapRate << " \n";
+      }
+      if (m.screening)
+      {
+        s << "\nDelayed acceptance screened out " << m.nScreened << " of " << m.nProposed << " proposals\n";
+      }
+      if (m.speculation)
+      {
+        s << "\nSpeculative proposals used: " << m.nSpeculationHits << " of " << m.nSpeculated << "\n";
+      }
+      s << "\nEffective sample size: " << m.ess << " (" << m.essPerSecond << " per second, " << m.essPerEvaluation
+          << " per evaluation)\n";
+      if (m.ensemble)
+      {
+        s << "\nEnsemble proposals accepted: " << m.nEnsembleAccepted << " of " << m.nEnsembleProposed << "\n";
+      }
+      if (m.numChains > 1)
+      {
+        double chainSeconds = m.seconds * m.chains.size();
+        s << "\nTime deciding swaps: " << m.swapDecisionSeconds << " s ("
+            << 100.0 * m.swapDecisionSeconds / chainSeconds << "% of chain time)\n";
+      }
+      return s.str();
+    }
+
+    MetricsPublisher::MetricsPublisher(zmq::context_t& context, const std::string& endpoint)
+        : context_(context),
+          endpoint_(endpoint),
+          hasNext_(false),
+          logNext_(false),
+          stop_(false)
+    {
+      threadReturned_ = std::async(std::launch::async, &MetricsPublisher::run, this);
+    }
+
+    MetricsPublisher::~MetricsPublisher()
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+      }
+      ready_.notify_one();
+      threadReturned_.wait();
+    }
+
+    void MetricsPublisher::publish(Metrics metrics, bool log)
+    {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::swap(next_, metrics);
+        // A replaced snapshot that was due for the log still gets logged
+        logNext_ = log || (hasNext_ && logNext_);
+        hasNext_ = true;
+      }
+      ready_.notify_one();
+    }
+
+    bool MetricsPublisher::run()
+    {
+      // The socket belongs to this thread
+      std::unique_ptr<zmq::socket_t> publisher;
+      if (!endpoint_.empty())
+      {
+        publisher.reset(new zmq::socket_t(context_, ZMQ_PUB));
+        publisher->bind(endpoint_.c_str());
+      }
+
+      Metrics metrics;
+      while (true)
+      {
+        bool log;
+        {
+          std::unique_lock<std::mutex> lock(mutex_);
+          ready_.wait(lock, [this]() { return hasNext_ || stop_; });
+          if (!hasNext_)
+            break;
+          std::swap(metrics, next_);
+          log = logNext_;
+          hasNext_ = false;
+          logNext_ = false;
+        }
+
+        if (publisher)
+          comms::sendString(*publisher, comms::serialise(metrics));
+        if (log)
+          LOG(INFO)<< renderMetrics(metrics) << "\n";
+      }
+      return true;
+    }
+  }
+}
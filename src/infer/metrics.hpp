@@ -0,0 +1,71 @@
+//!
+//! Contains the interface for publishing the progress of the sampler.
+//!
+//! \file infer/metrics.hpp
+//! \date 2026
+//! \license Affero General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#pragma once
+
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <string>
+
+#include "comms/transport.hpp"
+#include "infer/mcmctypes.hpp"
+
+namespace stateline
+{
+  namespace mcmc
+  {
+    //! Render a metrics snapshot as the human-readable status table.
+    //!
+    //! \param metrics The metrics snapshot.
+    //! \return The table.
+    //!
+    std::string renderMetrics(const Metrics& metrics);
+
+    //! Publishes metrics snapshots from a thread of its own, so serialising,
+    //! sending and rendering never hold up the sampler. Snapshots that arrive
+    //! while the thread is busy replace the one waiting to be sent.
+    //!
+    class MetricsPublisher
+    {
+      public:
+        //! Start the publishing thread.
+        //!
+        //! \param context The ZeroMQ context.
+        //! \param endpoint The endpoint to bind a PUB socket to. Metrics are
+        //!        only logged if it is empty.
+        //!
+        MetricsPublisher(zmq::context_t& context, const std::string& endpoint);
+
+        //! Stop the publishing thread. The waiting snapshot is still sent.
+        //!
+        ~MetricsPublisher();
+
+        //! Hand a snapshot to the publishing thread.
+        //!
+        //! \param metrics The metrics snapshot.
+        //! \param log Whether to also write the snapshot to the log as a table.
+        //!
+        void publish(Metrics metrics, bool log);
+
+      private:
+        bool run();
+
+        zmq::context_t& context_;
+        std::string endpoint_;
+        std::mutex mutex_;
+        std::condition_variable ready_;
+        Metrics next_;
+        bool hasNext_;
+        bool logNext_;
+        bool stop_;
+        std::future<bool> threadReturned_;
+    };
+  }
+}
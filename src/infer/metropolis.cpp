@@ -15,34 +15,85 @@ namespace stateline
 {
   namespace mcmc
   {
-    bool acceptProposal(const State& newState, const State& oldState, double beta)
+    bool acceptProposal(const State& newState, const State& oldState, double beta, PhiloxGenerator& gen, double screenedDeltaEnergy)
     {
-      static std::random_device rd;
-      static std::mt19937 generator(rd());
-      static std::uniform_real_distribution<> rand; // defaults to [0,1)
-
       if (std::isinf(newState.energy))
         return false;
-      double deltaEnergy = newState.energy - oldState.energy;
+      return acceptEnergyDelta(newState.energy - oldState.energy - screenedDeltaEnergy, beta, gen);
+    }
+
+    bool acceptEnergyDelta(double deltaEnergy, double beta, PhiloxGenerator& gen)
+    {
+      std::uniform_real_distribution<> rand; // defaults to [0,1)
+
       double probToAccept = std::min(1.0, std::exp(-1.0 * beta * deltaEnergy));
 
       // Roll the dice to determine acceptance
-      bool accept = rand(generator) < probToAccept;
+      bool accept = rand(gen) < probToAccept;
       return accept;
     }
     
-    bool acceptSwap(const State& sL, const State& sH, double betaL, double betaH)
+    bool acceptSwap(const State& sL, const State& sH, double betaL, double betaH, PhiloxGenerator& gen)
     {
-      static std::random_device rd;
-      static std::mt19937 generator(rd());
-      static std::uniform_real_distribution<> rand; // defaults to [0,1)
+      std::uniform_real_distribution<> rand; // defaults to [0,1)
 
       // Compute the probability of swapping
       double deltaEnergy = sH.energy - sL.energy;
       double deltaBeta = betaH - betaL;
       double probToSwap = std::exp(deltaEnergy * deltaBeta);
-      bool swapAccepted = rand(generator) < probToSwap;
+      bool swapAccepted = rand(gen) < probToSwap;
       return swapAccepted;
     }
+
+    Eigen::VectorXd langevinProposal(const Eigen::VectorXd& state, const Eigen::VectorXd& gradient, double sigma, double beta,
+                                     PhiloxGenerator& gen)
+    {
+      std::normal_distribution<> rand; // zero mean, unit variance
+
+      Eigen::VectorXd step(state.size());
+      for (uint i = 0; i < step.size(); i++)
+        step(i) = rand(gen);
+      return state - (0.5 * sigma * sigma * beta) * gradient + sigma * step;
+    }
+
+    double langevinLogProposalRatio(const Eigen::VectorXd& state, const Eigen::VectorXd& proposed, const Eigen::VectorXd& gradient,
+                                    const Eigen::VectorXd& propGradient, double sigma, double beta)
+    {
+      double drift = 0.5 * sigma * sigma * beta;
+      double forward = (proposed - state + drift * gradient).squaredNorm();
+      double reverse = (state - proposed + drift * propGradient).squaredNorm();
+      return (forward - reverse) / (2.0 * sigma * sigma);
+    }
+
+    Eigen::VectorXd differentialEvolutionProposal(const Eigen::VectorXd& state, const std::vector<Eigen::VectorXd>& ensemble,
+                                                  PhiloxGenerator& gen)
+    {
+      std::uniform_int_distribution<uint> pickA(0, ensemble.size() - 1);
+      std::uniform_int_distribution<uint> pickB(0, ensemble.size() - 2);
+      std::uniform_real_distribution<> rand;
+      uint a = pickA(gen);
+      uint b = pickB(gen);
+      if (b >= a)
+        b++;
+
+      // The optimal scale for a Gaussian target, with occasional full steps
+      // to jump between modes
+      double gamma = rand(gen) < 0.1 ? 1.0 : 2.38 / std::sqrt(2.0 * state.size());
+      return state + gamma * (ensemble[a] - ensemble[b]);
+    }
+
+    Eigen::VectorXd stretchProposal(const Eigen::VectorXd& state, const std::vector<Eigen::VectorXd>& ensemble, PhiloxGenerator& gen,
+                                    double& logProposalRatio)
+    {
+      // Stretch factors z in [1/a, a] with density proportional to 1/sqrt(z)
+      constexpr double a = 2.0;
+      std::uniform_int_distribution<uint> pick(0, ensemble.size() - 1);
+      std::uniform_real_distribution<> rand;
+      const Eigen::VectorXd& other = ensemble[pick(gen)];
+      double u = rand(gen);
+      double z = std::pow((a - 1.0) * u + 1.0, 2.0) / a;
+      logProposalRatio = (state.size() - 1) * std::log(z);
+      return other + z * (state - other);
+    }
   }
 }
@@ -11,7 +11,11 @@
 
 #pragma once
 
-#include "mcmc.hpp"
+#include <random>
+#include <vector>
+
+#include "infer/mcmctypes.hpp"
+#include "infer/random.hpp"
 
 namespace stateline
 {
@@ -22,9 +26,23 @@ namespace stateline
     //! \param newState The proposed state.
     //! \param oldState The current state of the chain.
     //! \param beta The inverse temperature of the chain.
+    //! \param gen The random generator of the chain.
+    //! \param screenedDeltaEnergy The change in screening energy already
+    //!        accepted by a delayed acceptance first stage. It is removed from
+    //!        the energy difference so the chain still targets the full energy.
     //! \return True if the proposal was accepted.
     //!
-    bool acceptProposal(const State& newState, const State& oldState, double beta);
+    bool acceptProposal(const State& newState, const State& oldState, double beta, PhiloxGenerator& gen,
+                        double screenedDeltaEnergy = 0.0);
+
+    //! Returns true if we want to accept a step with a given change in energy.
+    //!
+    //! \param deltaEnergy The energy of the proposal minus the current energy.
+    //! \param beta The inverse temperature of the chain.
+    //! \param gen The random generator of the chain.
+    //! \return True if the step was accepted.
+    //!
+    bool acceptEnergyDelta(double deltaEnergy, double beta, PhiloxGenerator& gen);
     
     //! Returns true if we want to accept the MCMC swap.
     //!
@@ -32,9 +50,62 @@ namespace stateline
     //! \param stateHigh The state of the higher temperature chain.
     //! \param betaLow The inverse temperature of the lower temperature chain.
     //! \param betaHigh The inverse temperature of the high temperature chain.
+    //! \param gen The random generator of the lower temperature chain.
     //! \return True if the swap was accepted.
     //!
-    bool acceptSwap(const State& stateLow, const State& stateHigh, double betaLow, double betaHigh);
+    bool acceptSwap(const State& stateLow, const State& stateHigh, double betaLow, double betaHigh, PhiloxGenerator& gen);
+
+    //! Propose a new state with a Langevin step: a Gaussian random walk
+    //! drifting down the gradient of the energy.
+    //!
+    //! \param state The current state of the chain.
+    //! \param gradient The gradient of the energy at the current state.
+    //! \param sigma The standard deviation of the random walk.
+    //! \param beta The inverse temperature of the chain.
+    //! \param gen The random generator of the chain.
+    //! \return The proposed state.
+    //!
+    Eigen::VectorXd langevinProposal(const Eigen::VectorXd& state, const Eigen::VectorXd& gradient, double sigma, double beta,
+                                     PhiloxGenerator& gen);
+
+    //! The log of the reverse over the forward Langevin proposal density,
+    //! which corrects the acceptance probability for the drift.
+    //!
+    //! \param state The current state of the chain.
+    //! \param proposed The proposed state.
+    //! \param gradient The gradient of the energy at the current state.
+    //! \param propGradient The gradient of the energy at the proposed state.
+    //! \param sigma The standard deviation of the random walk.
+    //! \param beta The inverse temperature the proposal was made at.
+    //! \return log q(state | proposed) - log q(proposed | state).
+    //!
+    double langevinLogProposalRatio(const Eigen::VectorXd& state, const Eigen::VectorXd& proposed, const Eigen::VectorXd& gradient,
+                                    const Eigen::VectorXd& propGradient, double sigma, double beta);
+
+    //! Propose a new state with a differential evolution (DE-MC) step along
+    //! the difference of two randomly chosen members of an ensemble. The step
+    //! is symmetric so it needs no correction.
+    //!
+    //! \param state The current state of the chain.
+    //! \param ensemble The current states of the other chains (at least 2).
+    //! \param gen The random generator of the chain.
+    //! \return The proposed state.
+    //!
+    Eigen::VectorXd differentialEvolutionProposal(const Eigen::VectorXd& state, const std::vector<Eigen::VectorXd>& ensemble,
+                                                  PhiloxGenerator& gen);
+
+    //! Propose a new state with an affine-invariant stretch move along the
+    //! line through a randomly chosen member of an ensemble.
+    //!
+    //! \param state The current state of the chain.
+    //! \param ensemble The current states of the other chains (at least 1).
+    //! \param gen The random generator of the chain.
+    //! \param logProposalRatio Set to the log of the reverse over the forward
+    //!        proposal density.
+    //! \return The proposed state.
+    //!
+    Eigen::VectorXd stretchProposal(const Eigen::VectorXd& state, const std::vector<Eigen::VectorXd>& ensemble, PhiloxGenerator& gen,
+                                    double& logProposalRatio);
 
   }
 }
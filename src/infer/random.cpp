@@ -0,0 +1,54 @@
+//!
+//! Contains the implementation of the counter-based random generator of the chains.
+//!
+//! \file infer/random.cpp
+//! \date 2026
+//! \license Affero General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include "infer/random.hpp"
+
+namespace stateline
+{
+  namespace mcmc
+  {
+    std::array<std::uint32_t, 4> philox4x32(std::array<std::uint32_t, 4> counter, std::array<std::uint32_t, 2> key)
+    {
+      const std::uint64_t m0 = 0xD2511F53;
+      const std::uint64_t m1 = 0xCD9E8D57;
+      for (int round = 0; round < 10; round++)
+      {
+        std::uint64_t p0 = m0 * counter[0];
+        std::uint64_t p1 = m1 * counter[2];
+        counter = { std::uint32_t(p1 >> 32) ^ counter[1] ^ key[0], std::uint32_t(p1),
+                    std::uint32_t(p0 >> 32) ^ counter[3] ^ key[1], std::uint32_t(p0) };
+        key[0] += 0x9E3779B9;
+        key[1] += 0xBB67AE85;
+      }
+      return counter;
+    }
+
+    PhiloxGenerator::PhiloxGenerator(std::uint32_t seed, std::uint32_t stream, std::uint32_t epoch)
+        : counter_ { { 0, 0, stream, epoch } },
+          key_ { { seed, 0 } },
+          index_(4)
+    {
+    }
+
+    bool PhiloxGenerator::operator==(const PhiloxGenerator& other) const
+    {
+      // The buffered outputs follow from the counter and the key
+      return counter_ == other.counter_ && key_ == other.key_ && index_ == other.index_;
+    }
+
+    void PhiloxGenerator::refill()
+    {
+      output_ = philox4x32(counter_, key_);
+      // The low 64 bits of the counter count blocks
+      if (++counter_[0] == 0)
+        counter_[1]++;
+      index_ = 0;
+    }
+  }
+}
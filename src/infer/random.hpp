@@ -0,0 +1,80 @@
+//!
+//! Contains the interface for the counter-based random generator of the chains.
+//!
+//! \file infer/random.hpp
+//! \date 2026
+//! \license Affero General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace stateline
+{
+  namespace mcmc
+  {
+    //! The Philox4x32-10 block function (Salmon et al. 2011). Encrypts a
+    //! 128 bit counter under a 64 bit key.
+    //!
+    //! \param counter The counter to encrypt.
+    //! \param key The key.
+    //! \return Four independent uniform 32 bit values.
+    //!
+    std::array<std::uint32_t, 4> philox4x32(std::array<std::uint32_t, 4> counter, std::array<std::uint32_t, 2> key);
+
+    //! A counter-based random generator. The numbers are the Philox
+    //! encryption of an incrementing counter, so a generator is fully
+    //! determined by its seed and stream and independent streams are cheap.
+    //! Each chain owns one, so chains never share a generator and a run can
+    //! be replayed from its seed. Meets the requirements of a uniform random
+    //! bit generator, so it works with the standard distributions.
+    //!
+    class PhiloxGenerator
+    {
+      public:
+        typedef std::uint32_t result_type;
+
+        //! Create a generator.
+        //!
+        //! \param seed The seed of the run.
+        //! \param stream The stream of the generator, e.g. the chain id.
+        //! \param epoch Distinguishes restarts of the same stream.
+        //!
+        PhiloxGenerator(std::uint32_t seed = 0, std::uint32_t stream = 0, std::uint32_t epoch = 0);
+
+        static constexpr result_type min()
+        {
+          return 0;
+        }
+
+        static constexpr result_type max()
+        {
+          return 0xffffffff;
+        }
+
+        //! Get the next random number.
+        //!
+        result_type operator()()
+        {
+          if (index_ == 4)
+            refill();
+          return output_[index_++];
+        }
+
+        //! Whether two generators will produce the same numbers from here on.
+        //!
+        bool operator==(const PhiloxGenerator& other) const;
+
+      private:
+        void refill();
+
+        std::array<std::uint32_t, 4> counter_;
+        std::array<std::uint32_t, 2> key_;
+        std::array<std::uint32_t, 4> output_;
+        std::uint32_t index_;
+    };
+  }
+}
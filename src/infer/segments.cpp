@@ -0,0 +1,358 @@
+//!
+//! Contains the implementation of the append-only segment files of the chains.
+//!
+//! \file infer/segments.cpp
+//! \date 2026
+//! \license Affero General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include "infer/segments.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <glog/logging.h>
+
+namespace stateline
+{
+  namespace mcmc
+  {
+    namespace
+    {
+      const uint segmentMagic = 0x53544C53;
+
+      struct SegmentHeader
+      {
+        uint magic;
+        uint first;
+        uint length;
+        uint dim;
+        std::uint64_t checksum;
+      };
+
+      // A segment as it is laid out in the file
+      struct Segment
+      {
+        SegmentHeader header;
+
+        // The number of distinct rows, and of distinct runs of beta
+        uint rows;
+        uint betaRows;
+
+        // The columns. Row r repeats for runs[r] states, and beta b for
+        // betaRuns[b] states
+        const char* columns;
+        const double* samples;
+        const double* energies;
+        const double* betas;
+        const uint* runs;
+        const uint* betaRuns;
+        const unsigned char* flags;
+
+        // The bytes of the columns, and of the whole segment
+        std::uint64_t columnBytes;
+        std::uint64_t bytes;
+      };
+
+      std::uint64_t padToWords(std::uint64_t bytes)
+      {
+        return (bytes + 7) / 8 * 8;
+      }
+
+      // The bytes of the columns of a segment, padded so the next header
+      // stays aligned
+      std::uint64_t segmentColumnBytes(uint length, uint dim, uint rows, uint betaRows)
+      {
+        return sizeof(std::uint64_t) + (std::uint64_t(rows) * (dim + 1) + betaRows) * sizeof(double)
+            + padToWords((std::uint64_t(rows) + betaRows) * sizeof(uint)) + padToWords(length);
+      }
+
+      // Find the columns of the segment at data. False if it is not a
+      // segment or runs past the available bytes
+      bool locateSegment(const char* data, std::uint64_t available, Segment& s)
+      {
+        if (available < sizeof(SegmentHeader) + sizeof(std::uint64_t))
+          return false;
+        std::memcpy(&s.header, data, sizeof(SegmentHeader));
+        const SegmentHeader& h = s.header;
+        if (h.magic != segmentMagic)
+          return false;
+
+        s.columns = data + sizeof(SegmentHeader);
+        std::memcpy(&s.rows, s.columns, sizeof(uint));
+        std::memcpy(&s.betaRows, s.columns + sizeof(uint), sizeof(uint));
+        if (s.rows > h.length || s.betaRows > h.length)
+          return false;
+        s.columnBytes = segmentColumnBytes(h.length, h.dim, s.rows, s.betaRows);
+        s.bytes = sizeof(SegmentHeader) + s.columnBytes;
+        if (s.bytes > available)
+          return false;
+
+        s.samples = (const double*) (s.columns + sizeof(std::uint64_t));
+        s.energies = s.samples + std::uint64_t(s.rows) * h.dim;
+        s.betas = s.energies + s.rows;
+        s.runs = (const uint*) (s.betas + s.betaRows);
+        s.betaRuns = s.runs + s.rows;
+        s.flags = (const unsigned char*) s.runs + padToWords((std::uint64_t(s.rows) + s.betaRows) * sizeof(uint));
+        return true;
+      }
+
+      // FNV-1a over 8 byte words. The columns are a whole number of words
+      std::uint64_t segmentChecksum(const char* data, std::uint64_t size)
+      {
+        std::uint64_t h = 14695981039346656037ULL;
+        for (std::uint64_t i = 0; i < size; i += 8)
+        {
+          std::uint64_t word;
+          std::memcpy(&word, data + i, 8);
+          h = (h ^ word) * 1099511628211ULL;
+        }
+        return h;
+      }
+
+      // Whether a state repeats the sample and energy of the one before it,
+      // as a rejected proposal does
+      bool repeatsState(const State& s, const State& previous)
+      {
+        return s.energy == previous.energy && s.sample == previous.sample;
+      }
+    }
+
+    SegmentFile::SegmentFile(const std::string& path)
+        : path_(path),
+          size_(0),
+          length_(0),
+          data_(nullptr),
+          mapped_(0)
+    {
+      fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+      if (fd_ < 0)
+      {
+        LOG(ERROR)<< "Could not open chain segments " << path << ". Check disk write permissions";
+        exit(EXIT_FAILURE);
+      }
+
+      struct stat st;
+      CHECK(fstat(fd_, &st) == 0) << path;
+      std::uint64_t fileSize = st.st_size;
+      map(fileSize);
+
+      Segment s;
+      while (locateSegment(data_ + size_, fileSize - size_, s) && s.header.first <= length_
+          && segmentChecksum(s.columns, s.columnBytes) == s.header.checksum)
+      {
+        index(s.header.first, size_);
+        length_ = s.header.first + s.header.length;
+        size_ += s.bytes;
+      }
+
+      if (size_ < fileSize)
+      {
+        LOG(WARNING)<< "Dropping " << fileSize - size_ << " bytes of unfinished segments from " << path;
+        CHECK(ftruncate(fd_, size_) == 0) << path;
+        map(size_);
+      }
+    }
+
+    SegmentFile::~SegmentFile()
+    {
+      if (mapped_ > 0)
+        munmap((void*) data_, mapped_);
+      ::close(fd_);
+    }
+
+    uint SegmentFile::length() const
+    {
+      return length_;
+    }
+
+    void SegmentFile::append(uint first, const std::vector<State>& states, uint begin)
+    {
+      CHECK(first <= length_) << "Can't append state " << first << " to " << path_ << " of length " << length_;
+      uint length = states.size() - begin;
+      uint dim = length > 0 ? states[begin].sample.size() : 0;
+      uint rows = 0;
+      uint betaRows = 0;
+      for (uint i = 0; i < length; i++)
+      {
+        if (i == 0 || !repeatsState(states[begin + i], states[begin + i - 1]))
+          rows++;
+        if (i == 0 || states[begin + i].beta != states[begin + i - 1].beta)
+          betaRows++;
+      }
+
+      std::uint64_t bytes = segmentColumnBytes(length, dim, rows, betaRows);
+      std::vector<char> buffer(sizeof(SegmentHeader) + bytes, 0);
+      char* columns = &buffer[sizeof(SegmentHeader)];
+      std::memcpy(columns, &rows, sizeof(uint));
+      std::memcpy(columns + sizeof(uint), &betaRows, sizeof(uint));
+      double* samples = (double*) (columns + sizeof(std::uint64_t));
+      double* energies = samples + std::uint64_t(rows) * dim;
+      double* betas = energies + rows;
+      uint* runs = (uint*) (betas + betaRows);
+      uint* betaRuns = runs + rows;
+      unsigned char* flags = (unsigned char*) runs + padToWords((std::uint64_t(rows) + betaRows) * sizeof(uint));
+
+      uint row = 0;
+      uint betaRow = 0;
+      for (uint i = 0; i < length; i++)
+      {
+        const State& s = states[begin + i];
+        if (i > 0 && repeatsState(s, states[begin + i - 1]))
+        {
+          runs[row - 1]++;
+        } else
+        {
+          Eigen::Map<Eigen::VectorXd>(samples + std::uint64_t(row) * dim, dim) = s.sample;
+          energies[row] = s.energy;
+          runs[row] = 1;
+          row++;
+        }
+        if (i > 0 && s.beta == states[begin + i - 1].beta)
+        {
+          betaRuns[betaRow - 1]++;
+        } else
+        {
+          betas[betaRow] = s.beta;
+          betaRuns[betaRow] = 1;
+          betaRow++;
+        }
+        flags[i] = (s.accepted ? 1 : 0) | uint(s.swapType) << 1;
+      }
+
+      SegmentHeader h { segmentMagic, first, length, dim, segmentChecksum(columns, bytes) };
+      std::memcpy(&buffer[0], &h, sizeof(SegmentHeader));
+
+      // A segment from the first state replaces the whole file. It goes to a
+      // new file that is renamed over the old one, so the file stays at one
+      // segment and a run killed while writing it keeps the old file
+      if (first == 0 && size_ > 0)
+      {
+        std::string newPath = path_ + ".new";
+        int fd = ::open(newPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        CHECK(fd >= 0) << "Could not open " << newPath;
+        CHECK(pwrite(fd, &buffer[0], buffer.size(), 0) == (ssize_t) buffer.size()) << "Could not write to " << newPath;
+        CHECK(std::rename(newPath.c_str(), path_.c_str()) == 0) << "Could not replace " << path_;
+        map(0);
+        ::close(fd_);
+        fd_ = fd;
+        size_ = 0;
+        index_.clear();
+      } else
+      {
+        CHECK(pwrite(fd_, &buffer[0], buffer.size(), size_) == (ssize_t) buffer.size()) << "Could not write to " << path_;
+      }
+      index(first, size_);
+      length_ = first + length;
+      size_ += buffer.size();
+    }
+
+    State SegmentFile::state(uint idx)
+    {
+      std::vector<State> states;
+      read(idx, 1, 1, states);
+      return states[0];
+    }
+
+    void SegmentFile::read(uint first, uint count, uint stride, std::vector<State>& states)
+    {
+      if (count == 0)
+        return;
+      uint last = first + (count - 1) * stride;
+      CHECK(last < length_) << "Can't access state " << last << " in " << path_ << " of length " << length_;
+
+      // The file has grown since it was mapped
+      if (mapped_ < size_)
+        map(size_);
+
+      auto segment = std::upper_bound(index_.begin(), index_.end(), std::make_pair(first, ~std::uint64_t(0))) - 1;
+      Segment seg;
+      uint row = 0;
+      uint runEnd = 0;
+      uint betaRow = 0;
+      uint betaRunEnd = 0;
+      for (uint k = 0; k < count; k++)
+      {
+        uint idx = first + k * stride;
+        bool entered = k == 0;
+        while (segment + 1 != index_.end() && (segment + 1)->first <= idx)
+        {
+          ++segment;
+          entered = true;
+        }
+        if (entered)
+        {
+          CHECK(locateSegment(data_ + segment->second, size_ - segment->second, seg)) << "Corrupt segment in " << path_;
+          row = 0;
+          runEnd = seg.runs[0];
+          betaRow = 0;
+          betaRunEnd = seg.betaRuns[0];
+
+          // Read the rest of the segment ahead while this state is decoded
+          std::uint64_t page = sysconf(_SC_PAGESIZE);
+          std::uint64_t begin = segment->second / page * page;
+          madvise((void*) (data_ + begin), segment->second + seg.bytes - begin, MADV_WILLNEED);
+        }
+
+        // Follow the runs to the row and the beta of the state
+        uint i = idx - seg.header.first;
+        while (i >= runEnd)
+          runEnd += seg.runs[++row];
+        while (i >= betaRunEnd)
+          betaRunEnd += seg.betaRuns[++betaRow];
+
+        uint dim = seg.header.dim;
+        State s;
+        s.sample = Eigen::Map<const Eigen::VectorXd>(seg.samples + std::uint64_t(row) * dim, dim);
+        s.energy = seg.energies[row];
+        s.beta = seg.betas[betaRow];
+        s.accepted = seg.flags[i] & 1;
+        s.swapType = SwapType(seg.flags[i] >> 1);
+        states.push_back(s);
+      }
+    }
+
+    void SegmentFile::truncate(uint length)
+    {
+      if (mapped_ < size_)
+        map(size_);
+      while (!index_.empty() && index_.back().first >= length && length_ > length)
+      {
+        size_ = index_.back().second;
+        index_.pop_back();
+        SegmentHeader h;
+        std::memcpy(&h, data_ + (index_.empty() ? 0 : index_.back().second), sizeof(SegmentHeader));
+        length_ = index_.empty() ? 0 : h.first + h.length;
+      }
+      CHECK_EQ(length, length_) << "Can't truncate " << path_ << " within a segment";
+      CHECK(ftruncate(fd_, size_) == 0) << path_;
+      map(size_);
+    }
+
+    void SegmentFile::index(uint first, std::uint64_t offset)
+    {
+      while (!index_.empty() && index_.back().first >= first)
+        index_.pop_back();
+      index_.push_back(std::make_pair(first, offset));
+    }
+
+    void SegmentFile::map(std::uint64_t size)
+    {
+      if (mapped_ > 0)
+        munmap((void*) data_, mapped_);
+      data_ = nullptr;
+      mapped_ = 0;
+      if (size == 0)
+        return;
+      void* data = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd_, 0);
+      CHECK(data != MAP_FAILED) << "Could not map " << path_;
+      data_ = (const char*) data;
+      mapped_ = size;
+    }
+  }
+}
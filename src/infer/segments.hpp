@@ -0,0 +1,113 @@
+//!
+//! Contains the interface for the append-only segment files of the chains.
+//!
+//! \file infer/segments.hpp
+//! \date 2026
+//! \license Affero General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "infer/mcmctypes.hpp"
+
+namespace stateline
+{
+  namespace mcmc
+  {
+    //! The states of one chain, stored as a file of segments that are only
+    //! ever appended to. Each flush of a chain cache is one segment: a header
+    //! followed by columns. A state with the same sample and energy as the
+    //! state before it, as a rejected proposal has, repeats its row, so there
+    //! is a row of doubles for each distinct sample, its energy and the number
+    //! of states that repeat it. The inverse temperature only changes when it
+    //! adapts, so it is stored the same way, as values and the number of
+    //! states that repeat each. Then there is a byte of flags for every
+    //! state. The header carries a checksum of the columns.
+    //! States are read straight from a memory map of the file.
+    //!
+    //! A segment replaces the states from its first index on. A segment
+    //! from the first state replaces the whole file by writing a new file and
+    //! renaming it over the old one. The hotter chains keep only their last
+    //! state this way, so their files stay at one segment, and a run killed
+    //! while one is written still has the state before it.
+    //!
+    class SegmentFile
+    {
+      public:
+        //! Open the segments of a chain, creating the file if it does not
+        //! exist. A segment that is cut short or fails its checksum was being
+        //! written when a run was killed, and it is dropped along with
+        //! everything after it.
+        //!
+        //! \param path The path of the file.
+        //!
+        SegmentFile(const std::string& path);
+
+        //! Unmap and close the file.
+        //!
+        ~SegmentFile();
+
+        //! Get the number of states in the file.
+        //!
+        //! \return The number of states.
+        //!
+        uint length() const;
+
+        //! Append a segment. A segment from the first state rewrites the
+        //! file instead.
+        //!
+        //! \param first The index in the chain of the first state written.
+        //!        At most the length of the file.
+        //! \param states The states, of which those from begin on are written.
+        //! \param begin The first of the states to write.
+        //!
+        void append(uint first, const std::vector<State>& states, uint begin);
+
+        //! Read a state.
+        //!
+        //! \param index The index of the state in the chain.
+        //! \return The state.
+        //!
+        State state(uint index);
+
+        //! Read states in order.
+        //!
+        //! \param first The index of the first state.
+        //! \param count The number of states to read.
+        //! \param stride The step between the indices of the states.
+        //! \param states The states are appended to this.
+        //!
+        void read(uint first, uint count, uint stride, std::vector<State>& states);
+
+        //! Drop the segments beyond a length, such as segments written by a
+        //! run that was killed before it recorded their length.
+        //!
+        //! \param length The length to keep. It must end a segment.
+        //!
+        void truncate(uint length);
+
+      private:
+        void index(uint first, std::uint64_t offset);
+        void map(std::uint64_t size);
+
+        std::string path_;
+        int fd_;
+
+        // The bytes of valid segments in the file
+        std::uint64_t size_;
+
+        // The first state and the offset of each live segment, in order
+        std::vector<std::pair<uint, std::uint64_t>> index_;
+        uint length_;
+
+        const char* data_;
+        std::uint64_t mapped_;
+    };
+  }
+}
@@ -0,0 +1,84 @@
+//!
+//! Contains the implementation of the population annealing helpers.
+//!
+//! \file infer/smc.cpp
+//! \date 2026
+//! \license Affero General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include "infer/smc.hpp"
+
+#include <random>
+
+namespace stateline
+{
+  namespace mcmc
+  {
+    double weightEss(const Eigen::VectorXd& logWeights)
+    {
+      Eigen::VectorXd w = (logWeights.array() - logWeights.maxCoeff()).exp();
+      return w.sum() * w.sum() / w.squaredNorm();
+    }
+
+    double logMeanExp(const Eigen::VectorXd& logWeights)
+    {
+      double maxLogWeight = logWeights.maxCoeff();
+      return maxLogWeight + std::log((logWeights.array() - maxLogWeight).exp().mean());
+    }
+
+    double nextBeta(const Eigen::VectorXd& energies, double beta, double essFraction)
+    {
+      double target = essFraction * energies.size();
+      if (weightEss(-(1.0 - beta) * energies) >= target)
+        return 1.0;
+
+      // The effective sample size falls as the step grows
+      double lo = 0.0;
+      double hi = 1.0 - beta;
+      for (uint i = 0; i < 50; i++)
+      {
+        double mid = 0.5 * (lo + hi);
+        if (weightEss(-mid * energies) >= target)
+          lo = mid;
+        else
+          hi = mid;
+      }
+      return beta + (lo > 0.0 ? lo : hi);
+    }
+
+    std::vector<uint> systematicResample(const Eigen::VectorXd& logWeights, PhiloxGenerator& gen)
+    {
+      uint n = logWeights.size();
+      Eigen::VectorXd w = (logWeights.array() - logWeights.maxCoeff()).exp();
+      w /= w.sum();
+
+      std::uniform_real_distribution<> rand;
+      double u = rand(gen) / n;
+      std::vector<uint> parents(n);
+      double cumulative = w(0);
+      uint j = 0;
+      for (uint i = 0; i < n; i++)
+      {
+        while (u > cumulative && j < n - 1)
+          cumulative += w(++j);
+        parents[i] = j;
+        u += 1.0 / n;
+      }
+      return parents;
+    }
+
+    ProposalCovariance populationCovariance(const std::vector<Eigen::VectorXd>& samples, double sigma, uint priorLength)
+    {
+      Eigen::VectorXd mean = Eigen::VectorXd::Zero(samples[0].size());
+      for (const Eigen::VectorXd& s : samples)
+        mean += s;
+      mean /= samples.size();
+
+      ProposalCovariance covariance = initialCovariance(mean, sigma);
+      for (uint i = 0; i < samples.size(); i++)
+        updateCovariance(covariance, samples[i], 1.0 / (priorLength + i + 1));
+      return covariance;
+    }
+  }
+}
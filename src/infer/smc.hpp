@@ -0,0 +1,328 @@
+//!
+//! Contains the population annealing (sequential Monte Carlo) sampler.
+//!
+//! \file infer/smc.hpp
+//! \date 2026
+//! \license Affero General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#pragma once
+
+#include <chrono>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <Eigen/Dense>
+#include <glog/logging.h>
+
+#include "db/db.hpp"
+#include "app/settings.hpp"
+#include "infer/chainarray.hpp"
+#include "infer/covariance.hpp"
+#include "infer/metropolis.hpp"
+#include "infer/random.hpp"
+
+namespace stateline
+{
+  namespace mcmc
+  {
+    //! The effective sample size of a set of importance weights.
+    //!
+    //! \param logWeights The log of the unnormalised weights.
+    //! \return The effective sample size, between one and the number of weights.
+    //!
+    double weightEss(const Eigen::VectorXd& logWeights);
+
+    //! The log of the mean of a set of weights, computed without overflow.
+    //!
+    //! \param logWeights The log of the weights.
+    //! \return The log of their mean.
+    //!
+    double logMeanExp(const Eigen::VectorXd& logWeights);
+
+    //! Choose the next inverse temperature of a population: the largest step
+    //! for which the effective sample size of the incremental weights
+    //! exp(-(newBeta - beta) * energy) is still essFraction of the particles.
+    //!
+    //! \param energies The likelihood energies of the particles.
+    //! \param beta The current inverse temperature.
+    //! \param essFraction The fraction of the particles to keep effective.
+    //! \return The next inverse temperature, at most one.
+    //!
+    double nextBeta(const Eigen::VectorXd& energies, double beta, double essFraction);
+
+    //! Draw the parents of a new population with systematic resampling. Each
+    //! particle has floor(n w) or ceil(n w) children, where w is its
+    //! normalised weight.
+    //!
+    //! \param logWeights The log of the unnormalised weights.
+    //! \param gen The random generator to draw the offset from.
+    //! \return The index of the parent of each new particle, in order.
+    //!
+    std::vector<uint> systematicResample(const Eigen::VectorXd& logWeights, PhiloxGenerator& gen);
+
+    //! The covariance of a population as a proposal covariance. It starts as
+    //! the isotropic covariance of sigma, worth priorLength samples, so it
+    //! stays positive definite for populations smaller than the dimension.
+    //!
+    //! \param samples The samples of the particles.
+    //! \param sigma The proposal width.
+    //! \param priorLength The number of samples the isotropic guess is worth.
+    //! \return The proposal covariance.
+    //!
+    ProposalCovariance populationCovariance(const std::vector<Eigen::VectorXd>& samples, double sigma, uint priorLength);
+
+    //! The result of a population annealing run.
+    //!
+    struct Population
+    {
+      //! The particles, equally weighted.
+      std::vector<State> particles;
+
+      //! The inverse temperature the population reached. One unless the run
+      //! was stopped early.
+      double beta;
+
+      //! The estimate of the log of the integral of the likelihood over the
+      //! prior (the evidence), up to beta.
+      double logEvidence;
+
+      //! The number of tempering steps.
+      uint generations;
+    };
+
+    //! A population annealing sampler. A population of particles drawn from
+    //! the prior is tempered towards the posterior: each step reweights the
+    //! particles by a power of the likelihood, resamples them and moves every
+    //! particle with a few Metropolis steps. All the particles of a step are
+    //! evaluated together, so the workers stay busy without the swap
+    //! synchronisation of parallel tempering, and the weights give an
+    //! estimate of the evidence as a by-product.
+    //!
+    class PopulationAnnealer
+    {
+    public:
+      //! Create a new population annealer.
+      //!
+      //! \param s Settings of the population annealing.
+      //! \param m Settings of the proposals; the annealer shares them with the
+      //!        MCMC. Also gives the seed and the cache length.
+      //! \param d Settings for configuring the database for the final particles.
+      //! \param interrupted A flag used to monitor whether the sampler has been interrupted.
+      //!
+      PopulationAnnealer(const SMCSettings& s, const MCMCSettings& m, const DBSettings& d, volatile bool& interrupted)
+          : db_(d),
+            chains_(1, 1, 1.0, m.proposalInitialSigma, 1.0, db_, m.cacheLength, false, m.seed, d.writeQueueLength),
+            s_(s),
+            m_(m),
+            interrupted_(interrupted)
+      {
+      }
+
+      //! Get the chain array holding the final particles, as the states of
+      //! its one chain.
+      //!
+      ChainArray& chains()
+      {
+        return chains_;
+      }
+
+      //! Anneal a population from the prior to the posterior.
+      //!
+      //! \param policy Async policy to evaluate states.
+      //! \param initialStates The initial particles, drawn from the prior.
+      //! \param propFn The proposal function, as for Sampler::run. It is given
+      //!        the particle, the proposal width, the covariance of the
+      //!        population, the random generator of the particle and the
+      //!        whole of the particle as the block to move.
+      //! \param priorFn The energy of the prior (its negative log density),
+      //!        so the likelihood can be separated from the energy the policy
+      //!        returns. Proposals outside the prior are not evaluated.
+      //! \param numSeconds The maximum number of seconds to run for.
+      //! \return The final population.
+      //!
+      template<class AsyncPolicy, class PropFn>
+      Population run(AsyncPolicy &policy, const std::vector<Eigen::VectorXd>& initialStates, PropFn &propFn,
+                     const ScreenFn &priorFn, uint numSeconds)
+      {
+        using namespace std::chrono;
+
+        steady_clock::time_point startTime = steady_clock::now();
+        LOG(INFO)<< "Random seed: " << chains_.seed();
+
+        uint n = initialStates.size();
+        Population pop;
+        pop.particles.resize(n);
+        pop.beta = 0.0;
+        pop.logEvidence = 0.0;
+        pop.generations = 0;
+        priorEnergies_.resize(n);
+
+        // Evaluate the whole initial population at once
+        for (uint i = 0; i < n; i++)
+        {
+          State& p = pop.particles[i];
+          p.sample = initialStates[i];
+          p.accepted = true;
+          p.swapType = SwapType::NoAttempt;
+          priorEnergies_(i) = priorFn(p.sample);
+          policy.submit(i, p.sample);
+        }
+        for (uint i = 0; i < n; i++)
+        {
+          auto result = policy.retrieve();
+          pop.particles[result.first].energy = result.second;
+        }
+
+        double sigma = m_.proposalInitialSigma;
+        PhiloxGenerator resampleGen(chains_.seed(), n, 0);
+        while (pop.beta < 1.0 && !interrupted_
+            && duration_cast<seconds>(steady_clock::now() - startTime).count() < numSeconds)
+        {
+          pop.generations++;
+
+          // Reweight by the next power of the likelihood
+          Eigen::VectorXd energies = likelihoodEnergies(pop.particles);
+          double beta = nextBeta(energies, pop.beta, s_.essFraction);
+          Eigen::VectorXd logWeights = -(beta - pop.beta) * energies;
+          double ess = weightEss(logWeights);
+          pop.logEvidence += logMeanExp(logWeights);
+          pop.beta = beta;
+
+          // Resample
+          std::vector<uint> parents = systematicResample(logWeights, resampleGen);
+          std::vector<State> particles(n);
+          Eigen::VectorXd priorEnergies(n);
+          for (uint i = 0; i < n; i++)
+          {
+            particles[i] = pop.particles[parents[i]];
+            priorEnergies(i) = priorEnergies_(parents[i]);
+          }
+          std::swap(pop.particles, particles);
+          std::swap(priorEnergies_, priorEnergies);
+
+          // Rejuvenate the duplicates with Metropolis moves at the new beta
+          double acceptRate = rejuvenate(policy, pop, propFn, priorFn, sigma);
+          double factor = std::pow(acceptRate / m_.proposalOptimalAccept, m_.proposalAdaptRate);
+          sigma *= std::min(std::max(factor, m_.proposalMinFactor), m_.proposalMaxFactor);
+
+          LOG(INFO)<< "Generation " << pop.generations << ": beta " << pop.beta << ", ESS " << ess << ", accept rate "
+              << acceptRate << ", sigma " << sigma << ", log evidence " << pop.logEvidence;
+        }
+
+        if (pop.beta < 1.0)
+        {
+          LOG(WARNING)<< "Stopped at beta " << pop.beta << " before reaching the posterior";
+        }
+        LOG(INFO)<< "Log evidence: " << pop.logEvidence;
+
+        // Store the population as one chain, so it reads like MCMC output.
+        // The front state of a chain's cache is never written, so the chain
+        // starts with a copy of the first particle
+        chains_.setSigma(0, sigma);
+        chains_.setBeta(0, pop.beta);
+        for (State& p : pop.particles)
+          p.beta = pop.beta;
+        chains_.initialise(0, pop.particles[0]);
+        for (const State& p : pop.particles)
+          chains_.initialise(0, p);
+        chains_.flushCache(0);
+        chains_.sync();
+        return pop;
+      }
+
+    private:
+      //! The likelihood energies of the particles: their energy less the
+      //! energy of the prior. Infinite for particles the policy rejected.
+      //!
+      Eigen::VectorXd likelihoodEnergies(const std::vector<State>& particles)
+      {
+        Eigen::VectorXd energies(particles.size());
+        for (uint i = 0; i < particles.size(); i++)
+        {
+          double energy = particles[i].energy;
+          energies(i) = std::isfinite(energy) ? energy - priorEnergies_(i) : std::numeric_limits<double>::infinity();
+        }
+        return energies;
+      }
+
+      //! Move every particle with Metropolis steps targeting the prior times
+      //! the likelihood to the power of the population's beta. The proposals
+      //! of all the particles are evaluated together.
+      //!
+      //! \return The acceptance rate.
+      //!
+      template<class AsyncPolicy, class PropFn>
+      double rejuvenate(AsyncPolicy &policy, Population &pop, PropFn &propFn, const ScreenFn &priorFn, double sigma)
+      {
+        uint n = pop.particles.size();
+        std::vector<Eigen::VectorXd> samples(n);
+        for (uint i = 0; i < n; i++)
+          samples[i] = pop.particles[i].sample;
+        ProposalCovariance covariance;
+        if (m_.proposalCovarianceLength > 0)
+          covariance = populationCovariance(samples, sigma, m_.proposalCovarianceLength);
+
+        // Each particle draws from its own stream, so the moves do not
+        // depend on the order the results arrive in
+        std::vector<PhiloxGenerator> gens;
+        for (uint i = 0; i < n; i++)
+          gens.push_back(PhiloxGenerator(chains_.seed(), i, pop.generations));
+
+        uint nAccepted = 0;
+        uint nProposed = 0;
+        std::vector<Eigen::VectorXd> proposals(n);
+        Eigen::VectorXd propPriorEnergies(n);
+        for (uint move = 0; move < s_.moves && !interrupted_; move++)
+        {
+          uint nSubmitted = 0;
+          for (uint i = 0; i < n; i++)
+          {
+            proposals[i] = propFn(pop.particles[i].sample, sigma, covariance, gens[i], 0, pop.particles[i].sample.size());
+            propPriorEnergies(i) = priorFn(proposals[i]);
+            if (std::isfinite(propPriorEnergies(i)))
+            {
+              policy.submit(i, proposals[i]);
+              nSubmitted++;
+            }
+          }
+          nProposed += n;
+
+          for (uint k = 0; k < nSubmitted; k++)
+          {
+            auto result = policy.retrieve();
+            uint i = result.first;
+            double energy = result.second;
+            if (!std::isfinite(energy))
+              continue;
+            State& p = pop.particles[i];
+            double oldEnergy = priorEnergies_(i) + pop.beta * (p.energy - priorEnergies_(i));
+            double newEnergy = propPriorEnergies(i) + pop.beta * (energy - propPriorEnergies(i));
+            if (acceptEnergyDelta(newEnergy - oldEnergy, 1.0, gens[i]))
+            {
+              p.sample = proposals[i];
+              p.energy = energy;
+              priorEnergies_(i) = propPriorEnergies(i);
+              nAccepted++;
+            }
+          }
+        }
+        return nProposed > 0 ? nAccepted / (double) nProposed : m_.proposalOptimalAccept;
+      }
+
+      // The database the final particles are written to
+      db::Database db_;
+
+      // Holds the final particles
+      ChainArray chains_;
+
+      // The prior energy of each particle
+      Eigen::VectorXd priorEnergies_;
+
+      SMCSettings s_;
+      MCMCSettings m_;
+      volatile bool& interrupted_;
+    };
+  }
+}
@@ -0,0 +1,92 @@
+//!
+//! Contains the implementation of the learned surrogate of the energy.
+//!
+//! \file infer/surrogate.cpp
+//! \date 2026
+//! \license Affero General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include "infer/surrogate.hpp"
+
+#include <cmath>
+#include <random>
+
+namespace stateline
+{
+  namespace mcmc
+  {
+    namespace
+    {
+      // The ridge on the Gram matrix, relative to a unit prior variance of
+      // the weights. Far from the data the uncertainty of a prediction
+      // approaches 1 / sqrt(ridge) times the residual deviation
+      const double ridge = 1e-3;
+
+      Eigen::VectorXd features(const EnergySurrogate& surrogate, const Eigen::VectorXd& state)
+      {
+        Eigen::VectorXd x = (state - surrogate.offset).cwiseProduct(surrogate.scale);
+        Eigen::VectorXd phi = surrogate.frequencies * x + surrogate.phases;
+        return std::sqrt(2.0 / phi.size()) * phi.array().cos().matrix();
+      }
+    }
+
+    EnergySurrogate fitSurrogate(const std::vector<Eigen::VectorXd>& states, const std::vector<double>& energies,
+                                 uint nFeatures, double lengthScale, PhiloxGenerator& gen)
+    {
+      uint n = states.size();
+      uint dim = states[0].size();
+      EnergySurrogate surrogate;
+
+      // Standardise the states and the energies
+      surrogate.offset = Eigen::VectorXd::Zero(dim);
+      for (const Eigen::VectorXd& s : states)
+        surrogate.offset += s;
+      surrogate.offset /= n;
+      Eigen::VectorXd variance = Eigen::VectorXd::Zero(dim);
+      for (const Eigen::VectorXd& s : states)
+        variance += (s - surrogate.offset).cwiseAbs2();
+      surrogate.scale.resize(dim);
+      for (uint i = 0; i < dim; i++)
+        surrogate.scale(i) = variance(i) > 0.0 ? std::sqrt(n / variance(i)) : 1.0;
+
+      Eigen::VectorXd y = Eigen::Map<const Eigen::VectorXd>(energies.data(), n);
+      surrogate.energyMean = y.mean();
+      y.array() -= surrogate.energyMean;
+      surrogate.energyScale = y.norm() > 0.0 ? y.norm() / std::sqrt(n) : 1.0;
+      y /= surrogate.energyScale;
+
+      // Frequencies from the spectral density of the kernel
+      std::normal_distribution<> normal(0.0, 1.0 / lengthScale);
+      std::uniform_real_distribution<> phase(0.0, 2.0 * M_PI);
+      surrogate.frequencies.resize(nFeatures, dim);
+      surrogate.phases.resize(nFeatures);
+      for (uint i = 0; i < nFeatures; i++)
+      {
+        for (uint j = 0; j < dim; j++)
+          surrogate.frequencies(i, j) = normal(gen);
+        surrogate.phases(i) = phase(gen);
+      }
+
+      // Ridge regression on the features
+      Eigen::MatrixXd phi(n, nFeatures);
+      for (uint k = 0; k < n; k++)
+        phi.row(k) = features(surrogate, states[k]);
+      Eigen::MatrixXd gram = phi.transpose() * phi;
+      gram.diagonal().array() += ridge;
+      Eigen::LLT<Eigen::MatrixXd> llt(gram);
+      surrogate.cholesky = llt.matrixL();
+      surrogate.weights = llt.solve(phi.transpose() * y);
+      surrogate.noise = std::max((phi * surrogate.weights - y).squaredNorm() / n, 1e-12);
+      return surrogate;
+    }
+
+    double predictEnergy(const EnergySurrogate& surrogate, const Eigen::VectorXd& state, double& sd)
+    {
+      Eigen::VectorXd phi = features(surrogate, state);
+      Eigen::VectorXd v = surrogate.cholesky.triangularView<Eigen::Lower>().solve(phi);
+      sd = surrogate.energyScale * std::sqrt(surrogate.noise * (1.0 + v.squaredNorm()));
+      return surrogate.energyMean + surrogate.energyScale * phi.dot(surrogate.weights);
+    }
+  }
+}
@@ -0,0 +1,75 @@
+//!
+//! Contains the interface for the learned surrogate of the energy.
+//!
+//! \file infer/surrogate.hpp
+//! \date 2026
+//! \license Affero General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#pragma once
+
+#include <vector>
+#include <Eigen/Dense>
+
+#include "infer/random.hpp"
+
+namespace stateline
+{
+  namespace mcmc
+  {
+    //! A regression of the energy on the state over random Fourier features,
+    //! which approximates a Gaussian process with a squared exponential
+    //! kernel. Its cost is set by the number of features rather than by the
+    //! number of states it was fitted to.
+    //!
+    struct EnergySurrogate
+    {
+      //! The mean and the inverse standard deviation of the training states,
+      //! which standardise the states.
+      Eigen::VectorXd offset;
+      Eigen::VectorXd scale;
+
+      //! The frequencies (one row per feature) and phases of the features.
+      Eigen::MatrixXd frequencies;
+      Eigen::VectorXd phases;
+
+      //! The regression weights of the features.
+      Eigen::VectorXd weights;
+
+      //! The lower triangular Cholesky factor of the regularised Gram matrix
+      //! of the features, which gives the uncertainty of a prediction.
+      Eigen::MatrixXd cholesky;
+
+      //! The mean and standard deviation of the training energies.
+      double energyMean;
+      double energyScale;
+
+      //! The variance of the residuals of the fit, in standardised units.
+      double noise;
+    };
+
+    //! Fit a surrogate to evaluated states.
+    //!
+    //! \param states The states.
+    //! \param energies The energy of each state.
+    //! \param nFeatures The number of random features.
+    //! \param lengthScale The length scale of the kernel, in standard
+    //!        deviations of the states.
+    //! \param gen The random generator to draw the features from.
+    //! \return The fitted surrogate.
+    //!
+    EnergySurrogate fitSurrogate(const std::vector<Eigen::VectorXd>& states, const std::vector<double>& energies,
+                                 uint nFeatures, double lengthScale, PhiloxGenerator& gen);
+
+    //! Predict the energy of a state.
+    //!
+    //! \param surrogate The fitted surrogate.
+    //! \param state The state.
+    //! \param sd Set to the standard deviation of the prediction. It grows
+    //!        away from the training states.
+    //! \return The predicted energy.
+    //!
+    double predictEnergy(const EnergySurrogate& surrogate, const Eigen::VectorXd& state, double& sd);
+  }
+}
@@ -39,6 +39,8 @@ namespace stateline
           settings.directory = path;
           settings.recover = false;
           settings.cacheSizeMB = 1.0;
+          settings.writeQueueLength = 4;
+          settings.chainStore = ChainStore::Segments;
           boost::filesystem::remove_all(path);
         }
 
@@ -102,6 +104,354 @@ namespace stateline
       EXPECT_DOUBLE_EQ(1.0, chains.beta(0));
     }
     
+    TEST_F(ChainArrayTest, covarianceUpdatesMatchDirectCovariance)
+    {
+      Eigen::MatrixXd samples(3, 50);
+      for (uint i = 0; i < samples.cols(); i++)
+      {
+        samples(0, i) = std::sin(0.7 * i);
+        samples(1, i) = 2.0 * samples(0, i) + 0.1 * std::cos(1.3 * i);
+        samples(2, i) = 0.5 * std::cos(0.3 * i) - samples(0, i);
+      }
+
+      // An initial covariance worth 10 states, then equal weights
+      double priorLength = 10.0;
+      ProposalCovariance covariance = initialCovariance(samples.col(0), 0.5);
+      for (uint i = 1; i < samples.cols(); i++)
+        updateCovariance(covariance, samples.col(i), 1.0 / (priorLength + i));
+
+      Eigen::VectorXd mean = samples.col(0);
+      Eigen::MatrixXd expected = 0.25 * priorLength * Eigen::MatrixXd::Identity(3, 3);
+      for (uint i = 1; i < samples.cols(); i++)
+      {
+        Eigen::VectorXd delta = samples.col(i) - mean;
+        mean += delta / (priorLength + i);
+        expected += (priorLength + i - 1) / (priorLength + i) * delta * delta.transpose();
+      }
+      expected /= priorLength + samples.cols() - 1;
+
+      Eigen::MatrixXd L = covariance.cholesky.triangularView<Eigen::Lower>();
+      EXPECT_TRUE(mean.isApprox(covariance.mean, 1e-10));
+      EXPECT_TRUE(expected.isApprox(L * L.transpose(), 1e-10));
+    }
+
+    TEST_F(ChainArrayTest, covarianceOfConstantDimensionKeepsAFloor)
+    {
+      // The middle dimension never moves, so without a floor its diagonal
+      // would shrink like one over the root of the number of states
+      uint n = 100000;
+      ProposalCovariance covariance = initialCovariance(Eigen::Vector3d(0.0, 0.3, 0.5), 0.5);
+      Eigen::MatrixXd expected = 0.25 * Eigen::MatrixXd::Identity(3, 3);
+      Eigen::VectorXd mean = covariance.mean;
+      for (uint i = 1; i <= n; i++)
+      {
+        Eigen::Vector3d state(std::sin(0.7 * i), 0.3, 0.5 * std::cos(0.3 * i));
+        updateCovariance(covariance, state, 1.0 / (1.0 + i));
+        Eigen::VectorXd delta = state - mean;
+        mean += delta / (1.0 + i);
+        expected += i / (1.0 + i) * delta * delta.transpose();
+      }
+      expected /= 1.0 + n;
+
+      Eigen::MatrixXd L = covariance.cholesky.triangularView<Eigen::Lower>();
+      EXPECT_TRUE(L.allFinite());
+      double rms = L.norm() / std::sqrt(3.0);
+      EXPECT_GE(L(1, 1), 0.999 * COVARIANCE_DIAGONAL_FLOOR * rms);
+
+      // The dimensions that move are unaffected
+      Eigen::MatrixXd C = L * L.transpose();
+      EXPECT_NEAR(expected(0, 0), C(0, 0), 1e-10);
+      EXPECT_NEAR(expected(0, 2), C(0, 2), 1e-10);
+      EXPECT_NEAR(expected(2, 2), C(2, 2), 1e-10);
+      EXPECT_NEAR(0.0, C(1, 0), 1e-10);
+      EXPECT_NEAR(0.0, C(2, 1), 1e-10);
+    }
+
+    TEST_F(ChainArrayTest, covarianceIsRecovered)
+    {
+      Eigen::VectorXd m(3);
+      m << 1.0, 2.0, 3.0;
+      Eigen::VectorXd n(3);
+      n << 2.0, 1.0, 3.5;
+      ProposalCovariance expected;
+      {
+        db::Database db(settings);
+        ChainArray chains(nStacks, nChains, tempFactor, initialSigma, sigmaFactor, db, 10, false);
+        chains.initialise(0, State { m, 1.0, 1.0, true, SwapType::NoAttempt });
+        chains.initialise(0, State { n, 1.0, 1.0, true, SwapType::NoAttempt });
+        chains.adaptCovariance(0, 0.1);
+        expected = chains.covariance(0);
+        chains.flushCache(0);
+      }
+
+      settings.recover = true;
+      db::Database db(settings);
+      ChainArray chains(nStacks, nChains, tempFactor, initialSigma, sigmaFactor, db, 10, true);
+      EXPECT_TRUE(expected.mean.isApprox(chains.covariance(0).mean));
+      EXPECT_TRUE(expected.cholesky.isApprox(chains.covariance(0).cholesky));
+    }
+    
+    TEST_F(ChainArrayTest, philoxMatchesKnownAnswers)
+    {
+      // Known answer vectors of the Random123 reference implementation
+      std::array<std::uint32_t, 4> zero = philox4x32({ { 0, 0, 0, 0 } }, { { 0, 0 } });
+      std::array<std::uint32_t, 4> expectedZero { { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 } };
+      EXPECT_EQ(expectedZero, zero);
+
+      std::array<std::uint32_t, 4> pi = philox4x32({ { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 } }, { { 0xa4093822, 0x299f31d0 } });
+      std::array<std::uint32_t, 4> expectedPi { { 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 } };
+      EXPECT_EQ(expectedPi, pi);
+    }
+
+    TEST_F(ChainArrayTest, sameSeedReplaysAcceptsAndSwaps)
+    {
+      Eigen::VectorXd m(2);
+      m << 1.0, 2.0;
+      std::vector<bool> decisions[2];
+      for (uint run = 0; run < 2; run++)
+      {
+        boost::filesystem::remove_all(path);
+        db::Database db(settings);
+        ChainArray chains(nStacks, nChains, tempFactor, initialSigma, sigmaFactor, db, 10, false, 1234);
+        EXPECT_EQ(1234U, chains.seed());
+        chains.initialise(0, State { m, 1.0, 1.0, true, SwapType::NoAttempt });
+        chains.initialise(1, State { m, 2.0, 0.5, true, SwapType::NoAttempt });
+        for (uint i = 0; i < 100; i++)
+        {
+          decisions[run].push_back(chains.append(0, State { m, 1.0 + (i % 5) * 0.3, 1.0, false, SwapType::NoAttempt }));
+          decisions[run].push_back(chains.swap(0, 1));
+        }
+      }
+      EXPECT_EQ(decisions[0], decisions[1]);
+
+      // Chains draw from their own streams
+      PhiloxGenerator a(1234, 0), b(1234, 1);
+      EXPECT_NE(a(), b());
+    }
+
+    TEST_F(ChainArrayTest, seedIsRecovered)
+    {
+      {
+        db::Database db(settings);
+        ChainArray chains(nStacks, nChains, tempFactor, initialSigma, sigmaFactor, db, 10, false);
+      }
+
+      settings.recover = true;
+      uint seed;
+      {
+        db::Database db(settings);
+        seed = internal::uintFromDb(db.get(internal::toDbString(0, internal::DbEntryType::SEED)));
+      }
+
+      db::Database db(settings);
+      ChainArray chains(nStacks, nChains, tempFactor, initialSigma, sigmaFactor, db, 10, true, seed + 1);
+      EXPECT_EQ(seed, chains.seed());
+    }
+
+    TEST_F(ChainArrayTest, statesWrittenBehindAreReadAndRecovered)
+    {
+      Eigen::VectorXd m(2);
+      m << 1.0, 2.0;
+      for (uint run = 0; run < 6; run++)
+      {
+        uint writeQueueLength = run % 3 * 2;
+        settings.chainStore = run < 3 ? ChainStore::LevelDB : ChainStore::Segments;
+        settings.recover = false;
+        boost::filesystem::remove_all(path);
+        {
+          db::Database db(settings);
+          ChainArray chains(nStacks, nChains, tempFactor, initialSigma, sigmaFactor, db, 3, false, 0, writeQueueLength);
+          chains.initialise(0, State { m, 0.0, 1.0, true, SwapType::NoAttempt });
+          chains.initialise(1, State { m, 0.0, 0.5, true, SwapType::NoAttempt });
+          for (uint i = 1; i < 20; i++)
+          {
+            chains.initialise(0, State { m, double(i), 1.0, true, SwapType::NoAttempt });
+            chains.initialise(1, State { m, double(i), 0.5, true, SwapType::NoAttempt });
+          }
+
+          // The front state is never written
+          std::vector<State> states = chains.states(0);
+          ASSERT_EQ(19U, states.size());
+          for (uint i = 0; i < states.size(); i++)
+            EXPECT_DOUBLE_EQ(double(i + 1), states[i].energy);
+          chains.flushCache(0);
+          chains.flushCache(1);
+        }
+
+        // The writes are finished before the chain array is destroyed. The
+        // store the run was started with is kept
+        settings.recover = true;
+        settings.chainStore = run < 3 ? ChainStore::Segments : ChainStore::LevelDB;
+        db::Database db(settings);
+        ChainArray chains(nStacks, nChains, tempFactor, initialSigma, sigmaFactor, db, 3, true);
+        ASSERT_EQ(19U, chains.length(0));
+        EXPECT_DOUBLE_EQ(19.0, chains.lastState(0).energy);
+        EXPECT_DOUBLE_EQ(19.0, chains.lastState(1).energy);
+      }
+    }
+
+    TEST_F(ChainArrayTest, scanReadsEveryStrideOfTheChain)
+    {
+      Eigen::VectorXd m(2);
+      m << 1.0, 2.0;
+      for (ChainStore store : { ChainStore::LevelDB, ChainStore::Segments })
+      {
+        settings.chainStore = store;
+        boost::filesystem::remove_all(path);
+        db::Database db(settings);
+        ChainArray chains(nStacks, nChains, tempFactor, initialSigma, sigmaFactor, db, 100, false);
+
+        // Leave part of the chain in the cache
+        for (uint i = 0; i < 3000; i++)
+          chains.initialise(0, State { m, double(i), 1.0, true, SwapType::NoAttempt });
+        std::vector<State> states = chains.states(0);
+        ASSERT_EQ(2999U, states.size());
+
+        for (uint stride : { 1U, 7U, 1500U })
+        {
+          uint expected = 10;
+          for (ChainCursor c = chains.scan(0, 10, 5000, stride); !c.done(); c.next())
+          {
+            ASSERT_EQ(expected, c.index());
+            EXPECT_DOUBLE_EQ(states[expected].energy, c.state().energy);
+            expected += stride;
+          }
+          EXPECT_LE(2999U, expected);
+          EXPECT_GT(2999U + stride, expected);
+        }
+        EXPECT_TRUE(chains.scan(0, 2999, 5000).done());
+      }
+    }
+
+    TEST_F(ChainArrayTest, segmentsKeepEveryField)
+    {
+      std::string file = path + "/segments";
+      boost::filesystem::create_directories(file);
+      file += "/test";
+      std::vector<State> states;
+      for (uint i = 0; i < 5; i++)
+      {
+        Eigen::VectorXd m(3);
+        m << i, 2.0 * i, -1.0 * i;
+        states.push_back(State { m, 10.0 + i, 1.0 / (i + 1), i % 2 == 0, SwapType(i % 3) });
+      }
+      // A rejected proposal repeats the state before it
+      states[2].sample = states[1].sample;
+      states[2].energy = states[1].energy;
+      states[3].sample = states[1].sample;
+      states[3].energy = states[1].energy;
+      // and the inverse temperature only changes when it adapts
+      states[3].beta = states[2].beta;
+
+      {
+        SegmentFile segments(file);
+        segments.append(0, states, 1);
+        segments.append(4, states, 3);
+        // Replaces the last state
+        segments.append(5, states, 4);
+        segments.append(5, states, 0);
+        EXPECT_EQ(10U, segments.length());
+      }
+
+      SegmentFile segments(file);
+      ASSERT_EQ(10U, segments.length());
+      for (uint i = 0; i < 10; i++)
+      {
+        const State& expected = i < 4 ? states[i + 1] : i == 4 ? states[3] : states[i - 5];
+        State s = segments.state(i);
+        EXPECT_EQ(expected.sample, s.sample);
+        EXPECT_EQ(expected.energy, s.energy);
+        EXPECT_EQ(expected.beta, s.beta);
+        EXPECT_EQ(expected.accepted, s.accepted);
+        EXPECT_EQ(expected.swapType, s.swapType);
+      }
+    }
+
+    TEST_F(ChainArrayTest, segmentsFromTheStartRewriteTheFile)
+    {
+      std::string file = path + "/segments";
+      boost::filesystem::create_directories(file);
+      file += "/hot";
+      std::vector<State> states;
+      for (uint i = 0; i < 5; i++)
+        states.push_back(State { Eigen::VectorXd::Constant(2, i), double(i), 0.5, true, SwapType::NoAttempt });
+
+      // A hot chain writes its last state from the start at every flush
+      std::uintmax_t oneState = 0;
+      {
+        SegmentFile segments(file);
+        segments.append(0, states, 0);
+        for (uint i = 0; i < states.size(); i++)
+        {
+          segments.append(0, states, i);
+          segments.append(0, states, states.size() - 1);
+          if (i == 0)
+            oneState = boost::filesystem::file_size(file);
+          ASSERT_EQ(1U, segments.length());
+          EXPECT_EQ(states.back().energy, segments.state(0).energy);
+        }
+      }
+      EXPECT_EQ(oneState, boost::filesystem::file_size(file));
+      EXPECT_FALSE(boost::filesystem::exists(file + ".new"));
+
+      SegmentFile segments(file);
+      ASSERT_EQ(1U, segments.length());
+      EXPECT_EQ(states.back().sample, segments.state(0).sample);
+    }
+
+    TEST_F(ChainArrayTest, rejectedStatesAreStoredAsRepeats)
+    {
+      Eigen::VectorXd m(50);
+      m.setZero();
+      std::string file = path + "/segments";
+      boost::filesystem::create_directories(file);
+      std::vector<State> states;
+      for (uint i = 0; i < 1000; i++)
+      {
+        if (i % 4 == 0)
+          m(i % 50) += 1.0;
+        states.push_back(State { m, double(i / 4), 1.0, i % 4 == 0, SwapType::NoAttempt });
+      }
+      {
+        SegmentFile segments(file + "/repeats");
+        segments.append(0, states, 0);
+        for (uint i = 0; i < states.size(); i += 3)
+        {
+          State s = segments.state(i);
+          EXPECT_EQ(states[i].sample, s.sample);
+          EXPECT_EQ(states[i].energy, s.energy);
+          EXPECT_EQ(states[i].accepted, s.accepted);
+        }
+      }
+
+      // A quarter of the rows, each of 51 doubles and a run, one beta, and
+      // the flags of every state
+      EXPECT_GE(states.size() / 4 * (51 * sizeof(double) + sizeof(uint)) + states.size() + 128,
+                boost::filesystem::file_size(file + "/repeats"));
+    }
+
+    TEST_F(ChainArrayTest, unfinishedSegmentsAreDropped)
+    {
+      Eigen::VectorXd m(2);
+      m << 1.0, 2.0;
+      {
+        db::Database db(settings);
+        ChainArray chains(nStacks, nChains, tempFactor, initialSigma, sigmaFactor, db, 5, false);
+        for (uint i = 0; i < 9; i++)
+          chains.initialise(0, State { m, double(i), 1.0, true, SwapType::NoAttempt });
+      }
+
+      // Cut the second segment short, as if the run was killed writing it
+      std::string file = path + "/segments/chain0";
+      boost::filesystem::resize_file(file, boost::filesystem::file_size(file) - 8);
+
+      settings.recover = true;
+      db::Database db(settings);
+      ChainArray chains(nStacks, nChains, tempFactor, initialSigma, sigmaFactor, db, 5, true);
+      ASSERT_EQ(4U, chains.length(0));
+      EXPECT_DOUBLE_EQ(4.0, chains.lastState(0).energy);
+    }
+
     //TEST_F(ChainArrayTest, canAppendToDifferentChains)
     //{
     //  db::Database db(settings);
@@ -13,6 +13,8 @@
 #include "gtest/gtest.h"
 #include "boost/filesystem.hpp"
 
+#include <random>
+
 #include "infer/diagnostics.hpp"
      
 namespace stateline
@@ -73,5 +75,141 @@ namespace stateline
 
       EXPECT_NEAR(1.340739719234503, epsr.rHat()(0), 1e-10);
     }
+
+    TEST(DiagnosticsTest, EssOfIndependentSamples)
+    {
+      std::mt19937 gen(1);
+      std::normal_distribution<> rand;
+      EffectiveSampleSize ess(2, 1);
+      for (int i = 0; i < 100000; i++)
+      {
+        ess.update(0, Eigen::VectorXd::Ones(1) * rand(gen));
+        ess.update(1, Eigen::VectorXd::Ones(1) * rand(gen));
+      }
+
+      // Batch means are noisy with few batches, but never exceed the length
+      EXPECT_GT(ess.ess(0)(0), 0.5 * 100000);
+      EXPECT_LE(ess.ess(0)(0), 100000);
+      EXPECT_GT(ess.ess()(0), 0.5 * 200000);
+      EXPECT_LE(ess.ess()(0), 200000);
+    }
+
+    TEST(DiagnosticsTest, EssOfAutoregressiveChain)
+    {
+      // An AR(1) chain with coefficient phi has autocorrelation time
+      // (1 + phi) / (1 - phi) = 19
+      std::mt19937 gen(2);
+      std::normal_distribution<> rand;
+      EffectiveSampleSize ess(1, 2);
+      Eigen::VectorXd x = Eigen::VectorXd::Zero(2);
+      double phi = 0.9;
+      for (int i = 0; i < 200000; i++)
+      {
+        x(0) = phi * x(0) + rand(gen);
+        x(1) = rand(gen);
+        ess.update(0, x);
+      }
+
+      EXPECT_NEAR(19.0, 200000 / ess.ess(0)(0), 5.0);
+      EXPECT_GT(ess.ess(0)(1), 5 * ess.ess(0)(0));
+    }
+
+    TEST(DiagnosticsTest, EssNeedsTwoBatches)
+    {
+      EffectiveSampleSize ess(1, 1, 4);
+      ess.update(0, Eigen::VectorXd::Ones(1));
+      EXPECT_EQ(0.0, ess.ess(0)(0));
+    }
+
+    TEST(DiagnosticsTest, EssOfConstantDimensionIsZero)
+    {
+      // A chain stuck in one dimension, and one that never moves at all,
+      // must not meet a target on the effective sample size
+      std::mt19937 gen(3);
+      std::normal_distribution<> rand;
+      EffectiveSampleSize ess(2, 2, 4);
+      Eigen::VectorXd x(2);
+      for (int i = 0; i < 1000; i++)
+      {
+        x << rand(gen), 0.3;
+        ess.update(0, x);
+        ess.update(1, Eigen::VectorXd::Constant(2, 0.7));
+      }
+
+      double target = 10.0;
+      EXPECT_GT(ess.ess(0)(0), target);
+      EXPECT_EQ(0.0, ess.ess(0)(1));
+      EXPECT_EQ(0.0, ess.ess(1)(0));
+      EXPECT_EQ(0.0, ess.ess(1)(1));
+      EXPECT_LT(ess.ess().minCoeff(), target);
+    }
+
+    //! Feed two chains of independent samples to the diagnostics, the
+    //! second shifted by an offset.
+    //!
+    void sampleTwoChains(double offset, EpsrConvergenceCriteria& cc, EffectiveSampleSize& ess)
+    {
+      std::mt19937 gen(4);
+      std::normal_distribution<> rand;
+      for (int i = 0; i < 2000; i++)
+      {
+        for (int j = 0; j < 2; j++)
+        {
+          Eigen::VectorXd x = Eigen::VectorXd::Ones(1) * (rand(gen) + j * offset);
+          cc.update(j, x);
+          ess.update(j, x);
+        }
+      }
+    }
+
+    TEST(DiagnosticsTest, NoTargetsAreNeverMet)
+    {
+      EpsrConvergenceCriteria cc(2, 1);
+      EffectiveSampleSize ess(2, 1);
+      sampleTwoChains(0.0, cc, ess);
+      EXPECT_FALSE(hasMetTargets(cc, ess, 0.0, 0.0));
+    }
+
+    TEST(DiagnosticsTest, TargetOnRHatOnly)
+    {
+      EpsrConvergenceCriteria cc(2, 1), apartCc(2, 1), oneCc(1, 1);
+      EffectiveSampleSize ess(2, 1), apartEss(2, 1), oneEss(1, 1);
+      sampleTwoChains(0.0, cc, ess);
+      sampleTwoChains(5.0, apartCc, apartEss);
+      for (int i = 0; i < 2000; i++)
+      {
+        oneCc.update(0, Eigen::VectorXd::Ones(1) * std::sin(i));
+        oneEss.update(0, Eigen::VectorXd::Ones(1) * std::sin(i));
+      }
+
+      EXPECT_TRUE(hasMetTargets(cc, ess, 1.1, 0.0));
+      EXPECT_FALSE(hasMetTargets(apartCc, apartEss, 1.1, 0.0));
+      EXPECT_FALSE(hasMetTargets(oneCc, oneEss, 1.1, 0.0));
+    }
+
+    TEST(DiagnosticsTest, TargetOnEssOnly)
+    {
+      EpsrConvergenceCriteria cc(2, 1), apartCc(2, 1);
+      EffectiveSampleSize ess(2, 1), apartEss(2, 1);
+      sampleTwoChains(0.0, cc, ess);
+      sampleTwoChains(5.0, apartCc, apartEss);
+
+      // The chains apart still have as many effective samples
+      EXPECT_TRUE(hasMetTargets(cc, ess, 0.0, 1000.0));
+      EXPECT_TRUE(hasMetTargets(apartCc, apartEss, 0.0, 1000.0));
+      EXPECT_FALSE(hasMetTargets(cc, ess, 0.0, 10000.0));
+    }
+
+    TEST(DiagnosticsTest, TargetsOnBoth)
+    {
+      EpsrConvergenceCriteria cc(2, 1), apartCc(2, 1);
+      EffectiveSampleSize ess(2, 1), apartEss(2, 1);
+      sampleTwoChains(0.0, cc, ess);
+      sampleTwoChains(5.0, apartCc, apartEss);
+
+      EXPECT_TRUE(hasMetTargets(cc, ess, 1.1, 1000.0));
+      EXPECT_FALSE(hasMetTargets(cc, ess, 1.1, 10000.0));
+      EXPECT_FALSE(hasMetTargets(apartCc, apartEss, 1.1, 1000.0));
+    }
   } // namespace db
 } // namespace obsidian
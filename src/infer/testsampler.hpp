@@ -0,0 +1,581 @@
+//!
+//! Contains tests for the parallel tempering sampler and its Metropolis steps.
+//!
+//! \file infer/testsampler.hpp
+//! \date 2026
+//! \license Affero General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include <glog/logging.h>
+#include "gtest/gtest.h"
+#include "boost/filesystem.hpp"
+
+#include <array>
+#include <cmath>
+#include <deque>
+#include <limits>
+
+#include "infer/adaptive.hpp"
+#include "infer/mcmc.hpp"
+
+namespace stateline
+{
+  namespace mcmc
+  {
+    //! Evaluates jobs as they are submitted: a narrow Gaussian energy centred
+    //! on the origin, infinite beyond a wall in the first dimension. Results
+    //! come back first in, first out or last in, first out, so the order of
+    //! results is the same every run. Interrupts the sampler after a number
+    //! of evaluations.
+    //!
+    class DeterministicPolicy
+    {
+      public:
+        //! \param widths The standard deviation of the energy in each
+        //!        dimension, if not 0.1 in all of them.
+        //!
+        DeterministicPolicy(bool lastInFirstOut, double wall, uint evaluations, volatile bool& interrupted,
+                            const Eigen::VectorXd& widths = Eigen::VectorXd())
+            : lastInFirstOut_(lastInFirstOut), wall_(wall), evaluations_(evaluations), interrupted_(interrupted), widths_(widths)
+        {
+        }
+
+        void submit(uint id, const Eigen::VectorXd& x, int priority = 0)
+        {
+          double energy = widths_.size() > 0 ? 0.5 * x.cwiseQuotient(widths_).squaredNorm() : 0.5 * x.squaredNorm() / 0.01;
+          if (x(0) > wall_)
+            energy = std::numeric_limits<double>::infinity();
+          results_.push_back(std::make_pair(id, energy));
+        }
+
+        std::pair<uint, double> retrieve()
+        {
+          if (evaluations_ == 0)
+            interrupted_ = true;
+          else
+            evaluations_--;
+          std::pair<uint, double> result;
+          if (lastInFirstOut_)
+          {
+            result = results_.back();
+            results_.pop_back();
+          } else
+          {
+            result = results_.front();
+            results_.pop_front();
+          }
+          return result;
+        }
+
+      private:
+        bool lastInFirstOut_;
+        double wall_;
+        uint evaluations_;
+        volatile bool& interrupted_;
+        Eigen::VectorXd widths_;
+        std::deque<std::pair<uint, double>> results_;
+    };
+
+    //! The database settings of the test runs.
+    //!
+    DBSettings testDBSettings(const std::string& path)
+    {
+      DBSettings d;
+      d.directory = path;
+      d.recover = false;
+      d.cacheSizeMB = 1.0;
+      d.writeQueueLength = 4;
+      d.chainStore = ChainStore::Segments;
+      return d;
+    }
+
+    //! The sampler settings of the test runs.
+    //!
+    MCMCSettings testMCMCSettings(uint nStacks, uint nChains, uint depth)
+    {
+      MCMCSettings s = MCMCSettings();
+      s.chains = nChains;
+      s.stacks = nStacks;
+      s.swapInterval = 1;
+      s.adaptionLength = 1000;
+      s.cacheLength = 100;
+      s.initialSigmaFactor = 1.5;
+      s.proposalInitialSigma = 0.1;
+      s.proposalMinFactor = 0.8;
+      s.proposalMaxFactor = 1.25;
+      s.proposalOptimalAccept = 0.24;
+      s.proposalAdaptRate = 0.2;
+      s.proposalAdaptInterval = 50;
+      s.betaOptimalSwapRate = 0.24;
+      s.betaAdaptRate = 0.04;
+      s.betaMinFactor = 0.8;
+      s.betaMaxFactor = 1.25;
+      s.betaAdaptInterval = 100000000;
+      s.initialTempFactor = 10.0;
+      s.seed = 42;
+      s.metricsInterval = 20;
+      s.speculationDepth = depth;
+      return s;
+    }
+
+    //! Run the sampler on a deterministic policy.
+    //!
+    //! \param depth The speculation depth.
+    //! \param lastInFirstOut The order the policy returns results in.
+    //! \param wall The energy is infinite beyond this in the first dimension.
+    //! \param initial The initial states, one per chain.
+    //! \param nChains The number of chains per stack.
+    //! \param screenFn The screening energy of delayed acceptance, if any.
+    //! \return The coldest chain of each stack.
+    //!
+    std::vector<std::vector<State>> sampleChains(uint depth, bool lastInFirstOut, double wall,
+                                                 const std::vector<Eigen::VectorXd>& initial, uint nChains,
+                                                 const ScreenFn& screenFn = ScreenFn())
+    {
+      std::string path = "./AUTOGENtestSampler";
+      boost::filesystem::remove_all(path);
+      DBSettings d = testDBSettings(path);
+      MCMCSettings s = testMCMCSettings(initial.size() / nChains, nChains, depth);
+
+      Eigen::VectorXd lower = Eigen::VectorXd::Constant(2, -100.0);
+      Eigen::VectorXd upper = Eigen::VectorXd::Constant(2, 100.0);
+      auto propFn = [&](const Eigen::VectorXd& x, double sigma, const ProposalCovariance& c, PhiloxGenerator& g, uint begin,
+                        uint length)
+      {
+        return adaptiveGaussianProposal(x, sigma, lower, upper, g, begin, length);
+      };
+
+      volatile bool interrupted = false;
+      DeterministicPolicy policy(lastInFirstOut, wall, 20000, interrupted);
+      std::vector<std::vector<State>> chains;
+      {
+        Sampler sampler(s, d, 2, interrupted);
+        sampler.run(policy, initial, propFn, 60, screenFn);
+        for (uint i = 0; i < s.stacks; i++)
+          chains.push_back(sampler.chains().states(i * nChains));
+      }
+      boost::filesystem::remove_all(path);
+      return chains;
+    }
+
+    //! Run one chain with block updates on an energy that is narrow in the
+    //! first block and wide in the second.
+    //!
+    //! \param mode How the chain picks the block to move.
+    //! \param blockSigmas Set to the final proposal width of each block.
+    //! \return The states of the chain.
+    //!
+    std::vector<State> sampleBlocks(BlockUpdate mode, std::vector<double>& blockSigmas)
+    {
+      std::string path = "./AUTOGENtestSampler";
+      boost::filesystem::remove_all(path);
+      DBSettings d = testDBSettings(path);
+      MCMCSettings s = testMCMCSettings(1, 1, 0);
+      s.proposalBlocks = mode;
+      std::vector<uint> blocks = { 0, 1, 3 };
+
+      Eigen::VectorXd lower = Eigen::VectorXd::Constant(3, -100.0);
+      Eigen::VectorXd upper = Eigen::VectorXd::Constant(3, 100.0);
+      auto propFn = [&](const Eigen::VectorXd& x, double sigma, const ProposalCovariance& c, PhiloxGenerator& g, uint begin,
+                        uint length)
+      {
+        return adaptiveGaussianProposal(x, sigma, lower, upper, g, begin, length);
+      };
+
+      volatile bool interrupted = false;
+      Eigen::VectorXd widths(3);
+      widths << 0.01, 1.0, 1.0;
+      DeterministicPolicy policy(false, std::numeric_limits<double>::infinity(), 20000, interrupted, widths);
+      std::vector<State> chain;
+      {
+        Sampler sampler(s, d, 3, interrupted);
+        sampler.run(policy, { Eigen::VectorXd::Zero(3) }, propFn, 60, ScreenFn(), GradientFn(), blocks);
+        chain = sampler.chains().states(0);
+        blockSigmas = sampler.blockSigmas(0);
+      }
+      boost::filesystem::remove_all(path);
+      return chain;
+    }
+
+    //! Check that each step of a chain moves one block, that every block
+    //! moves, and that the narrow block ends up with the narrower proposal.
+    //!
+    void expectBlockSteps(BlockUpdate mode)
+    {
+      std::vector<double> blockSigmas;
+      std::vector<State> chain = sampleBlocks(mode, blockSigmas);
+      ASSERT_GT(chain.size(), 10000U);
+      std::array<uint, 2> nMoves = { { 0, 0 } };
+      for (uint i = 1; i < chain.size(); i++)
+      {
+        Eigen::VectorXd step = chain[i].sample - chain[i - 1].sample;
+        bool first = step(0) != 0.0;
+        bool second = step.tail(2).squaredNorm() != 0.0;
+        ASSERT_FALSE(first && second) << "state " << i;
+        ASSERT_EQ(second, step(1) != 0.0 && step(2) != 0.0) << "state " << i;
+        nMoves[0] += first;
+        nMoves[1] += second;
+      }
+      EXPECT_GT(nMoves[0], chain.size() / 20);
+      EXPECT_GT(nMoves[1], chain.size() / 20);
+
+      ASSERT_EQ(2U, blockSigmas.size());
+      EXPECT_GT(blockSigmas[1], 10.0 * blockSigmas[0]);
+    }
+
+    TEST(SamplerTest, cycledBlocksMoveOneAtATime)
+    {
+      expectBlockSteps(BlockUpdate::Cycle);
+    }
+
+    TEST(SamplerTest, randomBlocksMoveOneAtATime)
+    {
+      expectBlockSteps(BlockUpdate::Random);
+    }
+
+    //! The states both runs got to must be the same.
+    //!
+    void expectSameChains(const std::vector<std::vector<State>>& a, const std::vector<std::vector<State>>& b)
+    {
+      ASSERT_EQ(a.size(), b.size());
+      for (uint i = 0; i < a.size(); i++)
+      {
+        uint length = std::min(a[i].size(), b[i].size());
+        EXPECT_GT(length, 500U);
+        for (uint j = 0; j < length; j++)
+        {
+          ASSERT_EQ(a[i][j].sample, b[i][j].sample) << "chain " << i << " state " << j;
+          ASSERT_EQ(a[i][j].energy, b[i][j].energy) << "chain " << i << " state " << j;
+          ASSERT_EQ(a[i][j].accepted, b[i][j].accepted) << "chain " << i << " state " << j;
+          ASSERT_EQ(a[i][j].swapType, b[i][j].swapType) << "chain " << i << " state " << j;
+        }
+      }
+    }
+
+    TEST(SamplerTest, speculationKeepsTheChains)
+    {
+      std::vector<Eigen::VectorXd> initial(3, Eigen::VectorXd::Zero(2));
+      double wall = std::numeric_limits<double>::infinity();
+      expectSameChains(sampleChains(0, false, wall, initial, 1), sampleChains(2, false, wall, initial, 1));
+    }
+
+    TEST(SamplerTest, speculationKeepsTheChainsWithInfiniteEnergies)
+    {
+      // Accepting or rejecting an infinite energy draws no random number, so
+      // the speculations after it are of no use
+      std::vector<Eigen::VectorXd> initial(3, Eigen::VectorXd::Zero(2));
+      auto a = sampleChains(0, false, 0.05, initial, 1);
+      auto b = sampleChains(2, false, 0.05, initial, 1);
+      expectSameChains(a, b);
+      for (const State& s : a[0])
+        EXPECT_LE(s.sample(0), 0.05);
+    }
+
+    //! Count the swap attempts that can be told apart in a chain. A state
+    //! copied by a rejected proposal keeps the swap type of the state before
+    //! it, so attempts between two rejections look like one.
+    //!
+    uint countSwapAttempts(const std::vector<State>& chain)
+    {
+      uint n = 0;
+      for (uint i = 0; i < chain.size(); i++)
+      {
+        bool attempted = chain[i].swapType != SwapType::NoAttempt;
+        n += attempted && (i == 0 || chain[i].accepted || chain[i - 1].swapType == SwapType::NoAttempt);
+      }
+      return n;
+    }
+
+    TEST(SamplerTest, speculationKeepsTheChainsWithSwaps)
+    {
+      // The order the chains move in changes with speculation, and swaps
+      // depend on it; taking the newest result first keeps the order, as
+      // only the coldest chain ever moves. It swaps in the first sweep of
+      // the stack. The hotter chains start far out, so the attempt draws a
+      // random number of the coldest chain and is rejected
+      std::vector<Eigen::VectorXd> initial(3, Eigen::VectorXd::Constant(2, 0.5));
+      initial[0].setZero();
+      auto a = sampleChains(0, true, std::numeric_limits<double>::infinity(), initial, 3);
+      auto b = sampleChains(2, true, std::numeric_limits<double>::infinity(), initial, 3);
+      expectSameChains(a, b);
+      uint nSwaps = 0;
+      for (const State& s : a[0])
+        nSwaps += s.swapType != SwapType::NoAttempt;
+      EXPECT_GT(nSwaps, 0U);
+    }
+
+    TEST(SamplerTest, swapsWaitForTheSweepOfTheStack)
+    {
+      // Taking the newest result first, only the coldest chain moves, so the
+      // stack never finishes a sweep after the first and the coldest chain
+      // does not swap again however far ahead it gets
+      std::vector<Eigen::VectorXd> initial(3, Eigen::VectorXd::Constant(2, 0.5));
+      initial[0].setZero();
+      double noWall = std::numeric_limits<double>::infinity();
+      auto racing = sampleChains(0, true, noWall, initial, 3);
+      EXPECT_GT(racing[0].size(), 1000U);
+      EXPECT_EQ(1U, countSwapAttempts(racing[0]));
+
+      // In turn, the pair of the coldest chain tries every other sweep
+      auto inTurn = sampleChains(0, false, noWall, initial, 3);
+      EXPECT_GT(countSwapAttempts(inTurn[0]), inTurn[0].size() / 20);
+      EXPECT_LE(countSwapAttempts(inTurn[0]), inTurn[0].size() / 2 + 1);
+    }
+
+    TEST(SamplerTest, screenRejectionsMatchInfiniteEnergies)
+    {
+      // A flat prior with a wall screens out what the policy would give an
+      // infinite energy
+      std::vector<Eigen::VectorXd> initial(3, Eigen::VectorXd::Zero(2));
+      auto wallFn = [](const Eigen::VectorXd& x)
+      {
+        return x(0) > 0.05 ? std::numeric_limits<double>::infinity() : 0.0;
+      };
+      double noWall = std::numeric_limits<double>::infinity();
+      expectSameChains(sampleChains(0, false, noWall, initial, 1, wallFn), sampleChains(0, false, 0.05, initial, 1));
+    }
+
+    //! Run one chain screened on a cheap energy centred away from the target,
+    //! and then on the surrogate if it has any features.
+    //!
+    //! \param surrogateFeatures The number of features of the surrogate.
+    //! \return The states of the chain.
+    //!
+    std::vector<State> sampleScreened(uint surrogateFeatures)
+    {
+      std::string path = "./AUTOGENtestSampler";
+      boost::filesystem::remove_all(path);
+      DBSettings d = testDBSettings(path);
+      MCMCSettings s = testMCMCSettings(1, 1, 0);
+      s.surrogateFeatures = surrogateFeatures;
+      s.surrogateLengthScale = 1.0;
+      s.surrogateMaxError = std::numeric_limits<double>::infinity();
+      s.surrogateTrainingLength = 500;
+      s.surrogateRefitInterval = 200;
+
+      Eigen::VectorXd lower = Eigen::VectorXd::Constant(2, -100.0);
+      Eigen::VectorXd upper = Eigen::VectorXd::Constant(2, 100.0);
+      auto propFn = [&](const Eigen::VectorXd& x, double sigma, const ProposalCovariance& c, PhiloxGenerator& g, uint begin,
+                        uint length)
+      {
+        return adaptiveGaussianProposal(x, sigma, lower, upper, g, begin, length);
+      };
+      auto screenFn = [](const Eigen::VectorXd& x)
+      {
+        return 0.5 * ((x(0) - 0.2) * (x(0) - 0.2) + x(1) * x(1)) / 0.01;
+      };
+
+      volatile bool interrupted = false;
+      DeterministicPolicy policy(false, std::numeric_limits<double>::infinity(), 50000, interrupted);
+      std::vector<State> chain;
+      {
+        Sampler sampler(s, d, 2, interrupted);
+        sampler.run(policy, { Eigen::VectorXd::Zero(2) }, propFn, 60, screenFn);
+        chain = sampler.chains().states(0);
+      }
+      boost::filesystem::remove_all(path);
+      return chain;
+    }
+
+    TEST(SamplerTest, surrogateScreenKeepsTheTarget)
+    {
+      std::vector<State> chain = sampleScreened(50);
+      ASSERT_GT(chain.size(), 20000U);
+
+      // The policy's energy is a Gaussian with standard deviation 0.1
+      // centred on the origin, whatever the two screening stages approve
+      Eigen::VectorXd sum = Eigen::VectorXd::Zero(2);
+      Eigen::VectorXd sumSq = Eigen::VectorXd::Zero(2);
+      uint n = 0;
+      for (uint i = 1000; i < chain.size(); i++)
+      {
+        sum += chain[i].sample;
+        sumSq += chain[i].sample.cwiseProduct(chain[i].sample);
+        n++;
+      }
+      Eigen::VectorXd mean = sum / n;
+      Eigen::VectorXd var = sumSq / n - mean.cwiseProduct(mean);
+      for (uint j = 0; j < 2; j++)
+      {
+        EXPECT_NEAR(0.0, mean(j), 0.02) << "dimension " << j;
+        EXPECT_NEAR(0.01, var(j), 0.002) << "dimension " << j;
+      }
+
+      // The surrogate took part, and the run replays
+      std::vector<State> withoutSurrogate = sampleScreened(0);
+      uint length = std::min(chain.size(), withoutSurrogate.size());
+      uint nDifferent = 0;
+      for (uint i = 0; i < length; i++)
+        nDifferent += chain[i].sample != withoutSurrogate[i].sample;
+      EXPECT_GT(nDifferent, length / 2);
+      expectSameChains({ chain }, { sampleScreened(50) });
+    }
+
+    TEST(MetropolisTest, exactScreenAlwaysPassesTheSecondStage)
+    {
+      std::mt19937 energyGen(1);
+      std::uniform_real_distribution<> rand(-10.0, 10.0);
+      PhiloxGenerator gen(1);
+      for (uint i = 0; i < 1000; i++)
+      {
+        State oldState, newState;
+        oldState.energy = rand(energyGen);
+        newState.energy = rand(energyGen);
+        EXPECT_TRUE(acceptProposal(newState, oldState, 0.5, gen, newState.energy - oldState.energy));
+      }
+    }
+
+    //! The log density of the Langevin proposal from one state to another.
+    //!
+    double langevinLogDensity(const Eigen::VectorXd& from, const Eigen::VectorXd& to, const Eigen::VectorXd& gradient, double sigma,
+                              double beta)
+    {
+      Eigen::VectorXd mean = from - 0.5 * sigma * sigma * beta * gradient;
+      return -0.5 * (to - mean).squaredNorm() / (sigma * sigma) - from.size() * std::log(sigma * std::sqrt(2.0 * M_PI));
+    }
+
+    TEST(MetropolisTest, langevinRatioIsAntisymmetric)
+    {
+      std::mt19937 gen(3);
+      std::normal_distribution<> rand;
+      for (uint i = 0; i < 100; i++)
+      {
+        Eigen::VectorXd x(3), y(3), gx(3), gy(3);
+        for (uint j = 0; j < 3; j++)
+        {
+          x(j) = rand(gen);
+          y(j) = rand(gen);
+          gx(j) = 5.0 * rand(gen);
+          gy(j) = 5.0 * rand(gen);
+        }
+        double sigma = 0.1 + std::abs(rand(gen));
+        double beta = 0.2 + std::abs(rand(gen));
+
+        double ratio = langevinLogProposalRatio(x, y, gx, gy, sigma, beta);
+        EXPECT_NEAR(-ratio, langevinLogProposalRatio(y, x, gy, gx, sigma, beta), 1e-9 * (1.0 + std::abs(ratio)));
+        double expected = langevinLogDensity(y, x, gy, sigma, beta) - langevinLogDensity(x, y, gx, sigma, beta);
+        EXPECT_NEAR(expected, ratio, 1e-9 * (1.0 + std::abs(expected)));
+        EXPECT_EQ(0.0, langevinLogProposalRatio(x, x, gx, gx, sigma, beta));
+      }
+    }
+
+    //! Sample a correlated Gaussian with an ensemble of walkers, moving one
+    //! walker at a time against the rest held fixed, and return the mean and
+    //! covariance of all the states visited.
+    //!
+    //! \param move The ensemble proposal.
+    //! \param corrected Whether to correct the acceptance with the log
+    //!        proposal ratio of the move.
+    //!
+    std::pair<Eigen::VectorXd, Eigen::MatrixXd> sampleEnsemble(EnsembleMove move, bool corrected, const Eigen::VectorXd& mu,
+                                                               const Eigen::MatrixXd& cov)
+    {
+      Eigen::MatrixXd precision = cov.inverse();
+      auto energy = [&](const Eigen::VectorXd& x)
+      {
+        return 0.5 * (x - mu).dot(precision * (x - mu));
+      };
+
+      PhiloxGenerator gen(5);
+      std::normal_distribution<> rand;
+      uint nWalkers = 10;
+      std::vector<Eigen::VectorXd> walkers(nWalkers, Eigen::VectorXd(mu.size()));
+      for (auto& w : walkers)
+        for (uint j = 0; j < w.size(); j++)
+          w(j) = rand(gen);
+
+      Eigen::VectorXd sum = Eigen::VectorXd::Zero(mu.size());
+      Eigen::MatrixXd sumSq = Eigen::MatrixXd::Zero(mu.size(), mu.size());
+      uint n = 0;
+      for (uint sweep = 0; sweep < 20000; sweep++)
+      {
+        for (uint i = 0; i < nWalkers; i++)
+        {
+          std::vector<Eigen::VectorXd> others;
+          for (uint k = 0; k < nWalkers; k++)
+            if (k != i)
+              others.push_back(walkers[k]);
+          double logRatio = 0.0;
+          Eigen::VectorXd prop = move == EnsembleMove::Stretch ? stretchProposal(walkers[i], others, gen, logRatio)
+                                                                : differentialEvolutionProposal(walkers[i], others, gen);
+          if (acceptEnergyDelta(energy(prop) - energy(walkers[i]) - corrected * logRatio, 1.0, gen))
+            walkers[i] = prop;
+          if (sweep >= 1000)
+          {
+            sum += walkers[i];
+            sumSq += walkers[i] * walkers[i].transpose();
+            n++;
+          }
+        }
+      }
+      Eigen::VectorXd mean = sum / n;
+      return std::make_pair(mean, sumSq / n - mean * mean.transpose());
+    }
+
+    //! A correlated Gaussian with a wide range of scales.
+    //!
+    std::pair<Eigen::VectorXd, Eigen::MatrixXd> ensembleTarget()
+    {
+      Eigen::VectorXd mu(3);
+      mu << 1.0, -2.0, 0.5;
+      Eigen::MatrixXd l(3, 3);
+      l << 1.0, 0.0, 0.0, 0.8, 0.6, 0.0, -0.5, 0.3, 2.0;
+      return std::make_pair(mu, l * l.transpose());
+    }
+
+    void expectMoments(const std::pair<Eigen::VectorXd, Eigen::MatrixXd>& expected,
+                       const std::pair<Eigen::VectorXd, Eigen::MatrixXd>& moments)
+    {
+      for (uint i = 0; i < expected.first.size(); i++)
+      {
+        EXPECT_NEAR(expected.first(i), moments.first(i), 0.1) << "mean " << i;
+        for (uint j = 0; j < expected.first.size(); j++)
+          EXPECT_NEAR(expected.second(i, j), moments.second(i, j), 0.1 * expected.second(i, i)) << "covariance " << i << " " << j;
+      }
+    }
+
+    TEST(EnsembleTest, differentialEvolutionRecoversAGaussian)
+    {
+      auto target = ensembleTarget();
+      expectMoments(target, sampleEnsemble(EnsembleMove::DifferentialEvolution, false, target.first, target.second));
+    }
+
+    TEST(EnsembleTest, stretchRecoversAGaussian)
+    {
+      auto target = ensembleTarget();
+      expectMoments(target, sampleEnsemble(EnsembleMove::Stretch, true, target.first, target.second));
+    }
+
+    TEST(EnsembleTest, stretchNeedsItsCorrection)
+    {
+      // Without the z^(d-1) factor the walkers are drawn together
+      auto target = ensembleTarget();
+      auto moments = sampleEnsemble(EnsembleMove::Stretch, false, target.first, target.second);
+      EXPECT_LT(moments.second.trace(), 0.8 * target.second.trace());
+    }
+
+    TEST(MetropolisTest, secondStageAcceptsOnTheRestOfTheEnergy)
+    {
+      State oldState, newState;
+      oldState.energy = 1.0;
+      newState.energy = 4.0;
+      for (double screened : { -2.0, 0.0, 1.0, 2.5 })
+      {
+        double beta = 0.5;
+        double probToAccept = std::min(1.0, std::exp(-beta * (3.0 - screened)));
+        PhiloxGenerator gen(2);
+        PhiloxGenerator expectedGen(2);
+        std::uniform_real_distribution<> rand;
+        uint nAccepted = 0;
+        for (uint i = 0; i < 100000; i++)
+        {
+          bool accepted = acceptProposal(newState, oldState, beta, gen, screened);
+          ASSERT_EQ(rand(expectedGen) < probToAccept, accepted);
+          nAccepted += accepted;
+        }
+        EXPECT_NEAR(probToAccept, nAccepted / 100000.0, 0.01);
+      }
+    }
+  }
+}
@@ -0,0 +1,15 @@
+#include "infer/testsmc.hpp"
+#include "app/console.hpp"
+
+const int logLevel = -3;
+const bool stdErr = false;
+std::string directory = ".";
+
+int main (int ac, char** av)
+{
+  obsidian::init::initialiseLogging("testsmc", logLevel, stdErr, directory);
+  testing::InitGoogleTest(&ac, av);
+  auto result = RUN_ALL_TESTS();
+  return result;
+}
+
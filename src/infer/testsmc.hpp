@@ -0,0 +1,156 @@
+//!
+//! Contains tests for the population annealing sampler.
+//!
+//! \file infer/testsmc.hpp
+//! \date 2026
+//! \license Affero General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include <glog/logging.h>
+#include "gtest/gtest.h"
+#include "boost/filesystem.hpp"
+
+#include <queue>
+#include <random>
+
+#include "infer/smc.hpp"
+
+namespace stateline
+{
+  namespace mcmc
+  {
+    //! Evaluates jobs as they are submitted: a standard normal prior in two
+    //! dimensions and a Gaussian likelihood centred on (1, -1) with a width
+    //! of 0.5.
+    //!
+    class GaussianPolicy
+    {
+      public:
+        static double priorEnergy(const Eigen::VectorXd& x)
+        {
+          return 0.5 * x.squaredNorm() + 0.5 * x.size() * std::log(2.0 * M_PI);
+        }
+
+        static Eigen::VectorXd mu()
+        {
+          return (Eigen::VectorXd(2) << 1.0, -1.0).finished();
+        }
+
+        void submit(uint id, const Eigen::VectorXd& x)
+        {
+          results_.push(std::make_pair(id, priorEnergy(x) + 0.5 * (x - mu()).squaredNorm() / 0.25));
+        }
+
+        std::pair<uint, double> retrieve()
+        {
+          auto result = results_.front();
+          results_.pop();
+          return result;
+        }
+
+      private:
+        std::queue<std::pair<uint, double>> results_;
+    };
+
+    TEST(SMCTest, nextBetaKeepsTheEssFraction)
+    {
+      std::mt19937 gen(1);
+      std::exponential_distribution<> rand(0.01);
+      Eigen::VectorXd energies(1000);
+      for (uint i = 0; i < energies.size(); i++)
+        energies(i) = rand(gen);
+
+      double beta = nextBeta(energies, 0.0, 0.5);
+      EXPECT_GT(beta, 0.0);
+      EXPECT_LT(beta, 1.0);
+      EXPECT_NEAR(500.0, weightEss(-beta * energies), 1e-6);
+
+      // A step to one that keeps enough particles is taken whole
+      EXPECT_EQ(1.0, nextBeta(Eigen::VectorXd::Constant(10, 3.0), 0.2, 0.5));
+    }
+
+    TEST(SMCTest, systematicResampleFollowsWeights)
+    {
+      Eigen::VectorXd w(4);
+      w << 0.1, 0.2, 0.3, 0.4;
+      PhiloxGenerator gen(1);
+      for (uint trial = 0; trial < 20; trial++)
+      {
+        std::vector<uint> parents = systematicResample(w.array().log(), gen);
+        ASSERT_EQ(4U, parents.size());
+        std::vector<uint> counts(4, 0);
+        for (uint p : parents)
+          counts[p]++;
+        for (uint i = 0; i < 4; i++)
+        {
+          EXPECT_GE(counts[i], std::floor(4 * w(i)));
+          EXPECT_LE(counts[i], std::ceil(4 * w(i)));
+        }
+      }
+    }
+
+    TEST(SMCTest, annealsGaussianWithEvidence)
+    {
+      std::string path = "./AUTOGENtestSMC";
+      boost::filesystem::remove_all(path);
+      DBSettings d;
+      d.directory = path;
+      d.recover = false;
+      d.cacheSizeMB = 1.0;
+      d.writeQueueLength = 4;
+      d.chainStore = ChainStore::Segments;
+      MCMCSettings m;
+      m.proposalInitialSigma = 0.5;
+      m.proposalOptimalAccept = 0.3;
+      m.proposalAdaptRate = 0.2;
+      m.proposalMinFactor = 0.8;
+      m.proposalMaxFactor = 1.25;
+      m.proposalCovarianceLength = 0;
+      m.cacheLength = 100;
+      m.seed = 7;
+      SMCSettings s;
+      s.particles = 2000;
+      s.essFraction = 0.5;
+      s.moves = 5;
+
+      std::vector<Eigen::VectorXd> initial;
+      std::mt19937 gen(3);
+      std::normal_distribution<> rand;
+      for (uint i = 0; i < s.particles; i++)
+        initial.push_back((Eigen::VectorXd(2) << rand(gen), rand(gen)).finished());
+
+      auto propFn = [](const Eigen::VectorXd& x, double sigma, const ProposalCovariance& c, PhiloxGenerator& g, uint begin,
+                       uint length)
+      {
+        std::normal_distribution<> r;
+        Eigen::VectorXd y = x;
+        for (uint i = begin; i < begin + length; i++)
+          y(i) += sigma * r(g);
+        return y;
+      };
+
+      volatile bool interrupted = false;
+      GaussianPolicy policy;
+      Population pop;
+      {
+        PopulationAnnealer smc(s, m, d, interrupted);
+        pop = smc.run(policy, initial, propFn, &GaussianPolicy::priorEnergy, 60);
+        EXPECT_EQ(s.particles, smc.chains().length(0));
+      }
+      boost::filesystem::remove_all(path);
+
+      // The posterior is normal with mean mu / (1 + v) and the evidence is
+      // (v / (1 + v)) exp(-|mu|^2 / 2(1 + v)) for a likelihood variance v
+      double v = 0.25;
+      EXPECT_EQ(1.0, pop.beta);
+      EXPECT_GT(pop.generations, 1U);
+      EXPECT_NEAR(std::log(v / (1 + v)) - 0.5 * GaussianPolicy::mu().squaredNorm() / (1 + v), pop.logEvidence, 0.15);
+      Eigen::VectorXd mean = Eigen::VectorXd::Zero(2);
+      for (const State& p : pop.particles)
+        mean += p.sample / pop.particles.size();
+      EXPECT_NEAR(0.8, mean(0), 0.05);
+      EXPECT_NEAR(-0.8, mean(1), 0.05);
+    }
+  }
+}
@@ -0,0 +1,73 @@
+//!
+//! Contains tests for the learned surrogate of the energy.
+//!
+//! \file infer/testsurrogate.hpp
+//! \date 2026
+//! \license Affero General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include <glog/logging.h>
+#include "gtest/gtest.h"
+
+#include <random>
+
+#include "infer/surrogate.hpp"
+
+namespace stateline
+{
+  namespace mcmc
+  {
+    //! A quadratic energy in three dimensions, and states scattered around
+    //! its minimum.
+    //!
+    class QuadraticTest : public testing::Test
+    {
+      protected:
+        static double energy(const Eigen::VectorXd& x)
+        {
+          return 10.0 + 0.5 * x.squaredNorm() / 0.04;
+        }
+
+        void SetUp()
+        {
+          std::mt19937 gen(3);
+          std::normal_distribution<> normal(0.0, 0.2);
+          for (uint i = 0; i < 1000; i++)
+          {
+            Eigen::VectorXd x(3);
+            for (uint j = 0; j < 3; j++)
+              x(j) = normal(gen);
+            states.push_back(x);
+            energies.push_back(energy(x));
+          }
+        }
+
+        std::vector<Eigen::VectorXd> states;
+        std::vector<double> energies;
+    };
+
+    TEST_F(QuadraticTest, predictsNearTheTrainingStates)
+    {
+      PhiloxGenerator gen(1);
+      EnergySurrogate surrogate = fitSurrogate(states, energies, 200, 1.0, gen);
+      Eigen::VectorXd x(3);
+      x << 0.1, -0.2, 0.05;
+      double sd;
+      double predicted = predictEnergy(surrogate, x, sd);
+      EXPECT_NEAR(energy(x), predicted, 0.5);
+      EXPECT_LT(sd, 0.5);
+      EXPECT_LT(std::abs(predicted - energy(x)), 3.0 * sd + 0.1);
+    }
+
+    TEST_F(QuadraticTest, isUnsureFarFromTheTrainingStates)
+    {
+      PhiloxGenerator gen(1);
+      EnergySurrogate surrogate = fitSurrogate(states, energies, 200, 1.0, gen);
+      double nearSd, farSd;
+      predictEnergy(surrogate, Eigen::VectorXd::Zero(3), nearSd);
+      predictEnergy(surrogate, Eigen::VectorXd::Constant(3, 3.0), farSd);
+      EXPECT_GT(farSd, 10.0 * nearSd);
+    }
+  }
+}
@@ -48,6 +48,10 @@ namespace obsidian
   //!
   stateline::MCMCSettings parseMCMCSettings(const po::variables_map& vm);
 
+  //! Parse population annealing settings from loaded input.obsidian file
+  //!
+  stateline::SMCSettings parseSMCSettings(const po::variables_map& vm);
+
   //! Parse which sensors are enabled from loaded input.obsidian file
   //!
   std::set<ForwardModel> parseSensorsEnabled(const po::variables_map& vm);
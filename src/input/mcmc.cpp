@@ -12,29 +12,59 @@
 
 namespace obsidian
 {
+  const std::map<std::string, stateline::EnsembleMove> ensembleMoveMap { { "none", stateline::EnsembleMove::None },
+      { "differential", stateline::EnsembleMove::DifferentialEvolution }, { "stretch", stateline::EnsembleMove::Stretch } };
+
+  const std::map<std::string, stateline::BlockUpdate> blockUpdateMap { { "none", stateline::BlockUpdate::None },
+      { "cycle", stateline::BlockUpdate::Cycle }, { "random", stateline::BlockUpdate::Random } };
+
+  const std::map<std::string, stateline::JobPriority> jobPriorityMap { { "none", stateline::JobPriority::None },
+      { "coldest", stateline::JobPriority::Coldest } };
+
   void initMCMCOptions(po::options_description & options)
   {
-    options.add_options()("mcmc.chains", po::value<uint>(), "number of chains per stack")("mcmc.stacks", po::value<uint>(),
-                                                                                          "number of stacks")(
-        "mcmc.wallTime", po::value<uint>(), "number of seconds to run (approximately)")("mcmc.swapInterval", po::value<uint>(),
-                                                                                        "steps before PT swap attempted")(
-        "mcmc.initialTempFactor", po::value<double>(), "geometric multiplier for temperature sequence")("mcmc.betaOptimalSwapRate",
-                                                                                                        po::value<double>(), "")(
-        "mcmc.betaAdaptRate", po::value<double>(), "adaption rate for beta")("mcmc.betaMinFactor", po::value<double>(),
-                                                                             "minimum beta adaption factor")("mcmc.betaMaxFactor",
-                                                                                                             po::value<double>(),
-                                                                                                             "maximum beta adaption factor")(
-        "mcmc.betaAdaptInterval", po::value<uint>(), "interval over which beta is adapted")("mcmc.adaptionLength", po::value<uint>(),
-                                                                                            "Total chain length before adaption stops")(
-        "mcmc.cacheLength", po::value<uint>(), "Total chain length before adaption stops")("proposal.initialSigma", po::value<double>(),
-                                                                                           "initial proposal standard deviation")(
-        "proposal.initialSigmaFactor", po::value<double>(), "initial proposal standard deviation")("proposal.maxFactor",
-                                                                                                   po::value<double>(),
-                                                                                                   "maximum adaption factor")(
-        "proposal.minFactor", po::value<double>(), "minimum adaption factor")("proposal.optimalAccept", po::value<double>(),
-                                                                              "optimal acceptance ratio")(
-        "proposal.adaptRate", po::value<double>(), "controls the amount by which the proposal width changes")(
-        "proposal.adaptInterval", po::value<uint>(), "steps before proposal function re-adapts");
+    options.add_options() //
+    ("mcmc.chains", po::value<uint>(), "number of chains per stack") //
+    ("mcmc.stacks", po::value<uint>(), "number of stacks") //
+    ("mcmc.wallTime", po::value<uint>(), "number of seconds to run (approximately)") //
+    ("mcmc.targetRHat", po::value<double>()->default_value(0.0), "stop when every R-hat is below this (0 to disable)") //
+    ("mcmc.targetEss", po::value<double>()->default_value(0.0), "stop when every effective sample size is above this (0 to disable)") //
+    ("mcmc.checkpointInterval", po::value<uint>()->default_value(0), "seconds between flushing the chains to disk (0 to disable)") //
+    ("mcmc.metricsEndpoint", po::value<std::string>()->default_value("tcp://*:5556"), "endpoint to publish metrics on (empty to disable)") //
+    ("mcmc.metricsInterval", po::value<uint>()->default_value(50), "milliseconds between metrics messages") //
+    ("mcmc.swapInterval", po::value<uint>(), "steps before PT swap attempted") //
+    ("mcmc.initialTempFactor", po::value<double>(), "geometric multiplier for temperature sequence") //
+    ("mcmc.betaOptimalSwapRate", po::value<double>(), "") //
+    ("mcmc.betaAdaptRate", po::value<double>(), "adaption rate for beta") //
+    ("mcmc.betaMinFactor", po::value<double>(), "minimum beta adaption factor") //
+    ("mcmc.betaMaxFactor", po::value<double>(), "maximum beta adaption factor") //
+    ("mcmc.betaAdaptInterval", po::value<uint>(), "interval over which beta is adapted") //
+    ("mcmc.adaptionLength", po::value<uint>(), "Total chain length before adaption stops") //
+    ("mcmc.cacheLength", po::value<uint>(), "Total chain length before adaption stops") //
+    ("mcmc.delayedAcceptance", po::value<bool>()->default_value(false), "screen proposals with the prior before evaluating them") //
+    ("mcmc.speculationDepth", po::value<uint>()->default_value(0), "steps of proposals to evaluate ahead of the accept decisions") //
+    ("mcmc.jobPriority", po::value<std::string>()->default_value("coldest"), "order of queued proposals: none or coldest") //
+    ("mcmc.seed", po::value<uint>()->default_value(0), "random seed of the chains, or 0 for a random one") //
+    ("proposal.initialSigma", po::value<double>(), "initial proposal standard deviation") //
+    ("proposal.initialSigmaFactor", po::value<double>(), "initial proposal standard deviation") //
+    ("proposal.maxFactor", po::value<double>(), "maximum adaption factor") //
+    ("proposal.minFactor", po::value<double>(), "minimum adaption factor") //
+    ("proposal.optimalAccept", po::value<double>(), "optimal acceptance ratio") //
+    ("proposal.adaptRate", po::value<double>(), "controls the amount by which the proposal width changes") //
+    ("proposal.adaptInterval", po::value<uint>(), "steps before proposal function re-adapts") //
+    ("proposal.covarianceLength", po::value<uint>()->default_value(0), "samples the initial proposal covariance is worth") //
+    ("proposal.langevin", po::value<bool>()->default_value(false), "use gradient-based Langevin proposals") //
+    ("proposal.ensemble", po::value<std::string>()->default_value("none"), "ensemble proposal across stacks") //
+    ("proposal.ensembleRate", po::value<double>()->default_value(0.5), "fraction of proposals that are ensemble proposals") //
+    ("proposal.blocks", po::value<std::string>()->default_value("none"), "propose one block of parameters at a time") //
+    ("surrogate.features", po::value<uint>()->default_value(0), "random features of the surrogate that screens proposals (0 to disable)") //
+    ("surrogate.lengthScale", po::value<double>()->default_value(1.0), "length scale of the surrogate in standard deviations of the states") //
+    ("surrogate.maxError", po::value<double>()->default_value(1.0), "largest predicted energy error the surrogate screens with") //
+    ("surrogate.trainingLength", po::value<uint>()->default_value(2000), "recent evaluations the surrogate is fitted to") //
+    ("surrogate.refitInterval", po::value<uint>()->default_value(1000), "evaluations between refits of the surrogate") //
+    ("smc.particles", po::value<uint>()->default_value(0), "number of population annealing particles (0 for parallel tempering)") //
+    ("smc.essFraction", po::value<double>()->default_value(0.5), "fraction of the particles kept effective by each tempering step") //
+    ("smc.moves", po::value<uint>()->default_value(5), "Metropolis moves per particle after each resampling");
   }
 
   stateline::MCMCSettings parseMCMCSettings(const po::variables_map& vm)
@@ -44,6 +74,11 @@ namespace obsidian
   s.chains = vm["mcmc.chains"].as<uint>();
   s.stacks = vm["mcmc.stacks"].as<uint>();
   s.wallTime = vm["mcmc.wallTime"].as<uint>();
+  s.targetRHat = vm["mcmc.targetRHat"].as<double>();
+  s.targetEss = vm["mcmc.targetEss"].as<double>();
+  s.checkpointInterval = vm["mcmc.checkpointInterval"].as<uint>();
+  s.metricsEndpoint = vm["mcmc.metricsEndpoint"].as<std::string>();
+  s.metricsInterval = vm["mcmc.metricsInterval"].as<uint>();
   s.swapInterval = vm["mcmc.swapInterval"].as<uint>();
   s.initialTempFactor = vm["mcmc.initialTempFactor"].as<double>();
   s.proposalInitialSigma = vm["proposal.initialSigma"].as<double>();
@@ -53,6 +88,11 @@ namespace obsidian
   s.proposalOptimalAccept = vm["proposal.optimalAccept"].as<double>();
   s.proposalAdaptRate = vm["proposal.adaptRate"].as<double>();
   s.proposalAdaptInterval = vm["proposal.adaptInterval"].as<uint>();
+  s.proposalCovarianceLength = vm["proposal.covarianceLength"].as<uint>();
+  s.proposalLangevin = vm["proposal.langevin"].as<bool>();
+  s.proposalEnsemble = ensembleMoveMap.at(vm["proposal.ensemble"].as<std::string>());
+  s.proposalEnsembleRate = vm["proposal.ensembleRate"].as<double>();
+  s.proposalBlocks = blockUpdateMap.at(vm["proposal.blocks"].as<std::string>());
   s.betaOptimalSwapRate = vm["mcmc.betaOptimalSwapRate"].as<double>();
   s.betaAdaptRate = vm["mcmc.betaAdaptRate"].as<double>();
   s.betaMinFactor = vm["mcmc.betaMinFactor"].as<double>();
@@ -60,6 +100,24 @@ namespace obsidian
   s.betaAdaptInterval = vm["mcmc.betaAdaptInterval"].as<uint>();
   s.adaptionLength = vm["mcmc.adaptionLength"].as<uint>();
   s.cacheLength = vm["mcmc.cacheLength"].as<uint>();
+  s.delayedAcceptance = vm["mcmc.delayedAcceptance"].as<bool>();
+  s.speculationDepth = vm["mcmc.speculationDepth"].as<uint>();
+  s.jobPriority = jobPriorityMap.at(vm["mcmc.jobPriority"].as<std::string>());
+  s.surrogateFeatures = vm["surrogate.features"].as<uint>();
+  s.surrogateLengthScale = vm["surrogate.lengthScale"].as<double>();
+  s.surrogateMaxError = vm["surrogate.maxError"].as<double>();
+  s.surrogateTrainingLength = vm["surrogate.trainingLength"].as<uint>();
+  s.surrogateRefitInterval = vm["surrogate.refitInterval"].as<uint>();
+  s.seed = vm["mcmc.seed"].as<uint>();
   return s;
 }
+
+  stateline::SMCSettings parseSMCSettings(const po::variables_map& vm)
+  {
+    stateline::SMCSettings s;
+    s.particles = vm["smc.particles"].as<uint>();
+    s.essFraction = vm["smc.essFraction"].as<double>();
+    s.moves = vm["smc.moves"].as<uint>();
+    return s;
+  }
 }
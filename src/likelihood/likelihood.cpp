@@ -20,7 +20,9 @@ namespace obsidian
       return std::sqrt((x.array() - x.mean()).pow(2.0).sum() / (double) (x.size()));
     }
 
-    double stdDev(const std::vector<Eigen::VectorXd>& x)
+    //! Concatenate a list of readings into a single vector.
+    //!
+    Eigen::VectorXd concatenate(const std::vector<Eigen::VectorXd>& x)
     {
       uint totalSize = 0;
       for (auto const& i : x)
@@ -32,7 +34,7 @@ namespace obsidian
         full.segment(start, i.size()) = i;
         start += i.size();
       }
-      return stdDev(full);
+      return full;
     }
 
     double gaussian(const Eigen::VectorXd &real, const Eigen::VectorXd &candidate, double sensorSd)
@@ -49,38 +51,152 @@ namespace obsidian
       return (-(A + 0.5) * (B + 0.5 * delta.array().square()).log() + norm).sum();
     }
 
+    //! Set up the parts of a likelihood context shared by every forward model.
+    //!
+    template<ForwardModel f>
+    LikelihoodContext<f> baseContext(const Eigen::VectorXd& observed, double sigma, const NoiseSpec& noise)
+    {
+      LikelihoodContext<f> context;
+      context.hasData = observed.size() > 0;
+      context.sigma = sigma;
+      context.observed = observed / sigma;
+      context.A = noise.inverseGammaAlpha;
+      context.B = noise.inverseGammaBeta;
+      context.norm = std::lgamma(context.A + 0.5) - std::lgamma(context.A) - 0.5 * std::log(6.28318530718) + std::log(context.B) * context.A;
+      return context;
+    }
+
+    //! The data dependent term of the normal inverse Gamma for one element,
+    //! where delta is the normalised difference between the readings.
+    //!
+    inline double normalInverseGammaTerm(double delta, double A, double B)
+    {
+      return -(A + 0.5) * std::log(B + 0.5 * delta * delta);
+    }
+
+    //! Likelihood context for sensors whose readings are shifted to zero mean.
+    //!
+    template<ForwardModel f>
+    LikelihoodContext<f> shiftedContext(const Eigen::VectorXd& readings, const NoiseSpec& noise)
+    {
+      if (readings.size() == 0)
+        return baseContext<f>(readings, 1.0, noise);
+      Eigen::VectorXd realShifted = readings.array() - readings.mean();
+      double sigma = stdDev(realShifted);
+      VLOG(3) << forwardModelLabel<f>() << " likelihood sigma: " << sigma;
+      return baseContext<f>(realShifted, sigma, noise);
+    }
+
+    //! Likelihood of readings shifted to zero mean against a shifted context.
+    //!
+    template<ForwardModel f>
+    double shiftedLikelihood(const Eigen::VectorXd& synthetic, const LikelihoodContext<f>& context)
+    {
+      CHECK_EQ(synthetic.size(), context.observed.size());
+      double mean = synthetic.mean();
+      double l = 0;
+      for (uint i = 0; i < synthetic.size(); i++)
+        l += normalInverseGammaTerm((synthetic(i) - mean) / context.sigma - context.observed(i), context.A, context.B);
+      return l + context.norm * synthetic.size();
+    }
+
+    //! Gradient of shiftedLikelihood() with respect to the synthetic readings.
+    //!
+    template<ForwardModel f>
+    Eigen::VectorXd shiftedLikelihoodGradient(const Eigen::VectorXd& synthetic, const LikelihoodContext<f>& context)
+    {
+      CHECK_EQ(synthetic.size(), context.observed.size());
+      double mean = synthetic.mean();
+      Eigen::VectorXd gradient(synthetic.size());
+      for (uint i = 0; i < synthetic.size(); i++)
+      {
+        double delta = (synthetic(i) - mean) / context.sigma - context.observed(i);
+        gradient(i) = -(context.A + 0.5) * delta / (context.B + 0.5 * delta * delta);
+      }
+      // Every reading also moves the mean
+      return (gradient.array() - gradient.mean()).matrix() / context.sigma;
+    }
+
+    //! Likelihood of a list of readings against a context of the concatenated
+    //! readings.
+    //!
+    template<ForwardModel f>
+    double concatenatedLikelihood(const std::vector<Eigen::VectorXd>& synthetic, const LikelihoodContext<f>& context, const char* label)
+    {
+      double l = 0;
+      uint start = 0;
+      for (uint i = 0; i < synthetic.size(); i++)
+      {
+        CHECK_LE(start + synthetic[i].size(), context.observed.size());
+        double t = 0;
+        for (uint j = 0; j < synthetic[i].size(); j++)
+          t += normalInverseGammaTerm(context.observed(start + j) - synthetic[i](j) / context.sigma, context.A, context.B);
+        t += context.norm * synthetic[i].size();
+        start += synthetic[i].size();
+        VLOG(3) << label << " Reading " << i << " likelihood:" << t;
+        l += t;
+      }
+      return l;
+    }
+
     template<>
-    double likelihood<ForwardModel::GRAVITY>(const GravResults& synthetic, const GravResults& real, const GravSpec& spec)
+    LikelihoodContext<ForwardModel::GRAVITY> likelihoodContext<ForwardModel::GRAVITY>(const GravResults& real, const GravSpec& spec)
     {
       // We shift both readings to have mean zero (no-one gets the dc offsets
       // right)
-      if (real.readings.size() == 0)
+      return shiftedContext<ForwardModel::GRAVITY>(real.readings, spec.noise);
+    }
+
+    template<>
+    double likelihood<ForwardModel::GRAVITY>(const GravResults& synthetic, const LikelihoodContext<ForwardModel::GRAVITY>& context,
+                                             const GravSpec& spec)
+    {
+      if (!context.hasData)
         return 0.0;
-      Eigen::VectorXd synShifted = synthetic.readings.array() - synthetic.readings.mean();
-      Eigen::VectorXd realShifted = real.readings.array() - real.readings.mean();
-      double sigma = stdDev(realShifted);
-      VLOG(3) << "gravity likelihood sigma: " << sigma;
-      double l = lh::normalInverseGamma(synShifted / sigma, realShifted / sigma, spec.noise.inverseGammaAlpha, spec.noise.inverseGammaBeta);
+      double l = shiftedLikelihood(synthetic.readings, context);
       VLOG(2) << "Gravity Likelihood: " << l;
       return l;
     }
 
     template<>
-    double likelihood<ForwardModel::MAGNETICS>(const MagResults& synthetic, const MagResults& real, const MagSpec& spec)
+    Eigen::VectorXd likelihoodGradient<ForwardModel::GRAVITY>(const GravResults& synthetic,
+                                                              const LikelihoodContext<ForwardModel::GRAVITY>& context,
+                                                              const GravSpec& spec)
+    {
+      if (!context.hasData)
+        return Eigen::VectorXd::Zero(synthetic.readings.size());
+      return shiftedLikelihoodGradient(synthetic.readings, context);
+    }
+
+    template<>
+    LikelihoodContext<ForwardModel::MAGNETICS> likelihoodContext<ForwardModel::MAGNETICS>(const MagResults& real, const MagSpec& spec)
     {
       // We shift both readings to have mean zero (no-one gets the dc offsets
       // right)
-      if (real.readings.size() == 0)
+      return shiftedContext<ForwardModel::MAGNETICS>(real.readings, spec.noise);
+    }
+
+    template<>
+    double likelihood<ForwardModel::MAGNETICS>(const MagResults& synthetic, const LikelihoodContext<ForwardModel::MAGNETICS>& context,
+                                               const MagSpec& spec)
+    {
+      if (!context.hasData)
         return 0.0;
-      Eigen::VectorXd synShifted = synthetic.readings.array() - synthetic.readings.mean();
-      Eigen::VectorXd realShifted = real.readings.array() - real.readings.mean();
-      double sigma = stdDev(realShifted);
-      VLOG(3) << "magnetic likelihood sigma: " << sigma;
-      double l = lh::normalInverseGamma(synShifted / sigma, realShifted / sigma, spec.noise.inverseGammaAlpha, spec.noise.inverseGammaBeta);
+      double l = shiftedLikelihood(synthetic.readings, context);
       VLOG(2) << "Magnetics Likelihood: " << l;
       return l;
     }
 
+    template<>
+    Eigen::VectorXd likelihoodGradient<ForwardModel::MAGNETICS>(const MagResults& synthetic,
+                                                                const LikelihoodContext<ForwardModel::MAGNETICS>& context,
+                                                                const MagSpec& spec)
+    {
+      if (!context.hasData)
+        return Eigen::VectorXd::Zero(synthetic.readings.size());
+      return shiftedLikelihoodGradient(synthetic.readings, context);
+    }
+
     Eigen::VectorXd mtLikelihoodVector(const Eigen::MatrixX4cd& impedences)
     {
       Eigen::VectorXd v(2 * 4 * impedences.rows());
@@ -111,26 +227,47 @@ namespace obsidian
     }
 
     template<>
-    double likelihood<ForwardModel::MTANISO>(const MtAnisoResults& synthetic, const MtAnisoResults& real, const MtAnisoSpec& spec)
+    LikelihoodContext<ForwardModel::MTANISO> likelihoodContext<ForwardModel::MTANISO>(const MtAnisoResults& real, const MtAnisoSpec& spec)
     {
-      if (real.readings.size() == 0)
-        return 0.0;
-      double likelihood = 0;
       std::vector<Eigen::VectorXd> realReadings;
-      std::vector<Eigen::VectorXd> synReadings;
       for (uint i = 0; i < real.readings.size(); i++)
-      {
         realReadings.push_back(mtApparentResLikelihoodVector(real.readings[i], spec.freqs[i]));
-        synReadings.push_back(mtApparentResLikelihoodVector(synthetic.readings[i], spec.freqs[i]));
-      }
-      double sigma = stdDev(realReadings);
+      Eigen::VectorXd observed = concatenate(realReadings);
+      double sigma = observed.size() > 0 ? stdDev(observed) : 1.0;
       VLOG(3) << "MT likelihood sigma: " << sigma;
-      for (uint i = 0; i < real.readings.size(); i++)
+      return baseContext<ForwardModel::MTANISO>(observed, sigma, spec.noise);
+    }
+
+    template<>
+    double likelihood<ForwardModel::MTANISO>(const MtAnisoResults& synthetic, const LikelihoodContext<ForwardModel::MTANISO>& context,
+                                             const MtAnisoSpec& spec)
+    {
+      if (!context.hasData)
+        return 0.0;
+      double likelihood = 0;
+      uint start = 0;
+      for (uint i = 0; i < synthetic.readings.size(); i++)
       {
+        const Eigen::MatrixX4cd& z = synthetic.readings[i];
+        CHECK_EQ(spec.freqs[i].size(), z.rows());
+        CHECK_LE(start + 2 * z.rows(), context.observed.size());
+        double t = 0;
+        for (uint r = 0; r < z.rows(); r++)
+        {
+          // Apparent resistivity of both modes, which are equal when the
+          // synthetic readings come from the isotropic recursion
+          double scale = 0.2 / (spec.freqs[i][r] * context.sigma);
+          double te = std::norm(z(r, 1)) * scale;
+          double tm = spec.ignoreAniso ? te : std::norm(z(r, 2)) * scale;
+          t += normalInverseGammaTerm(context.observed(start + 2 * r) - te, context.A, context.B);
+          t += normalInverseGammaTerm(context.observed(start + 2 * r + 1) - tm, context.A, context.B);
+        }
+        t += context.norm * 2 * z.rows();
+        start += 2 * z.rows();
+
         // 0.5 because we're essentially doubling the MT with the TE and TM
         // modes
-        double t = 0.5 * lh::normalInverseGamma(realReadings[i] / sigma, synReadings[i] / sigma, spec.noise.inverseGammaAlpha,
-                                          spec.noise.inverseGammaBeta);
+        t *= 0.5;
         VLOG(3) << "MT Reading " << i << " likelihood:" << t;
         likelihood += t;
       }
@@ -140,53 +277,70 @@ namespace obsidian
     }
 
     template<>
-    double likelihood<ForwardModel::SEISMIC1D>(const Seismic1dResults& synthetic, const Seismic1dResults& real, const Seismic1dSpec& spec)
+    LikelihoodContext<ForwardModel::SEISMIC1D> likelihoodContext<ForwardModel::SEISMIC1D>(const Seismic1dResults& real,
+                                                                                          const Seismic1dSpec& spec)
     {
-      if (real.readings.size() == 0)
-        return 0.0;
-      double l = 0;
-      double sigma = stdDev(real.readings);
+      Eigen::VectorXd observed = concatenate(real.readings);
+      double sigma = real.readings.size() > 0 ? stdDev(observed) : 1.0;
       VLOG(3) << "Seismic likelihood sigma: " << sigma;
-      for (uint i = 0; i < synthetic.readings.size(); i++)
-      {
-        double t = normalInverseGamma(real.readings[i] / sigma, synthetic.readings[i] / sigma, spec.noise.inverseGammaAlpha,
-                                      spec.noise.inverseGammaBeta);
-        l += t;
-        VLOG(3) << "Seismic Reading " << i << " likelihood:" << t;
-      }
+      LikelihoodContext<ForwardModel::SEISMIC1D> context = baseContext<ForwardModel::SEISMIC1D>(observed, sigma, spec.noise);
+      context.hasData = real.readings.size() > 0;
+      return context;
+    }
+
+    template<>
+    double likelihood<ForwardModel::SEISMIC1D>(const Seismic1dResults& synthetic, const LikelihoodContext<ForwardModel::SEISMIC1D>& context,
+                                               const Seismic1dSpec& spec)
+    {
+      if (!context.hasData)
+        return 0.0;
+      double l = concatenatedLikelihood(synthetic.readings, context, "Seismic");
       VLOG(2) << "Seismic Likelihood: " << l;
       return l;
     }
 
     template<>
-    double likelihood<ForwardModel::CONTACTPOINT>(const ContactPointResults& synthetic, const ContactPointResults& real,
-                                                  const ContactPointSpec& spec)
+    LikelihoodContext<ForwardModel::CONTACTPOINT> likelihoodContext<ForwardModel::CONTACTPOINT>(const ContactPointResults& real,
+                                                                                                const ContactPointSpec& spec)
     {
-      if (real.readings.size() == 0)
-        return 0.0;
-      double l = 0;
-      double sigma = stdDev(real.readings);
+      Eigen::VectorXd observed = concatenate(real.readings);
+      double sigma = real.readings.size() > 0 ? stdDev(observed) : 1.0;
       VLOG(3) << "Contact Point likelihood sigma: " << sigma;
-      for (uint i = 0; i < synthetic.readings.size(); i++)
-      {
-        double t = normalInverseGamma(real.readings[i] / sigma, synthetic.readings[i] / sigma, spec.noise.inverseGammaAlpha,
-                                      spec.noise.inverseGammaBeta);
-        l += t;
-        VLOG(3) << "Contact Point Reading " << i << " likelihood:" << t;
-      }
+      LikelihoodContext<ForwardModel::CONTACTPOINT> context = baseContext<ForwardModel::CONTACTPOINT>(observed, sigma, spec.noise);
+      context.hasData = real.readings.size() > 0;
+      return context;
+    }
+
+    template<>
+    double likelihood<ForwardModel::CONTACTPOINT>(const ContactPointResults& synthetic,
+                                                  const LikelihoodContext<ForwardModel::CONTACTPOINT>& context, const ContactPointSpec& spec)
+    {
+      if (!context.hasData)
+        return 0.0;
+      double l = concatenatedLikelihood(synthetic.readings, context, "Contact Point");
       VLOG(2) << "Contact point Likelihood: " << l;
       return l;
     }
 
     template<>
-    double likelihood<ForwardModel::THERMAL>(const ThermalResults& synthetic, const ThermalResults& real, const ThermalSpec& spec)
+    LikelihoodContext<ForwardModel::THERMAL> likelihoodContext<ForwardModel::THERMAL>(const ThermalResults& real, const ThermalSpec& spec)
     {
-      if (real.readings.size() == 0)
-        return 0.0;
-      double sigma = stdDev(real.readings);
+      double sigma = real.readings.size() > 0 ? stdDev(real.readings) : 1.0;
       VLOG(3) << "Thermal likelihood sigma: " << sigma;
-      double l = lh::normalInverseGamma(synthetic.readings / sigma, real.readings / sigma, spec.noise.inverseGammaAlpha,
-                                        spec.noise.inverseGammaBeta);
+      return baseContext<ForwardModel::THERMAL>(real.readings, sigma, spec.noise);
+    }
+
+    template<>
+    double likelihood<ForwardModel::THERMAL>(const ThermalResults& synthetic, const LikelihoodContext<ForwardModel::THERMAL>& context,
+                                             const ThermalSpec& spec)
+    {
+      if (!context.hasData)
+        return 0.0;
+      CHECK_EQ(synthetic.readings.size(), context.observed.size());
+      double l = 0;
+      for (uint i = 0; i < synthetic.readings.size(); i++)
+        l += normalInverseGammaTerm(synthetic.readings(i) / context.sigma - context.observed(i), context.A, context.B);
+      l += context.norm * synthetic.readings.size();
       VLOG(2) << "Thermal Likelihood: " << l;
       return l;
     }
@@ -35,10 +35,75 @@ namespace obsidian
     //!
     double normalInverseGamma(const Eigen::VectorXd &real, const Eigen::VectorXd &candidate, double A, double B);
 
+    //! Statistics of the observed data of a forward model. They never change
+    //! during a run, so they are computed once per shard by
+    //! likelihoodContext() and the likelihood only makes a pass over the
+    //! synthetic readings.
+    //!
     template<ForwardModel f>
-    double likelihood(const typename Types<f>::Results& synthetic, const typename Types<f>::Results& real,
+    struct LikelihoodContext
+    {
+      //! Whether there is any observed data. The likelihood is zero otherwise.
+      bool hasData;
+
+      //! The observed readings of every sensor concatenated in order, in the
+      //! form the likelihood compares them (e.g. shifted to zero mean) and
+      //! divided by sigma.
+      Eigen::VectorXd observed;
+
+      //! The standard deviation of the observed readings.
+      double sigma;
+
+      //! Alpha and beta parameters of the normal inverse Gamma noise model.
+      double A, B;
+
+      //! The normalising constant of the normal inverse Gamma for one element.
+      double norm;
+    };
+
+    //! Compute the likelihood context of a forward model.
+    //!
+    //! \param real The real sensor data.
+    //! \param spec The forward model specification.
+    //! \return The likelihood context.
+    //!
+    template<ForwardModel f>
+    LikelihoodContext<f> likelihoodContext(const typename Types<f>::Results& real, const typename Types<f>::Spec& spec);
+
+    //! Calculate the likelihood of synthetic readings against the observed
+    //! data held in a likelihood context. Does not allocate.
+    //!
+    //! \param synthetic The synthetic sensor data.
+    //! \param context The likelihood context of the real data.
+    //! \param spec The forward model specification.
+    //!
+    template<ForwardModel f>
+    double likelihood(const typename Types<f>::Results& synthetic, const LikelihoodContext<f>& context,
                       const typename Types<f>::Spec& spec);
 
+    //! Calculate the gradient of likelihood() with respect to the synthetic
+    //! readings. Only gravity and magnetics specialise this.
+    //!
+    //! \param synthetic The synthetic sensor data.
+    //! \param context The likelihood context of the real data.
+    //! \param spec The forward model specification.
+    //! \return The gradient with respect to each synthetic reading.
+    //!
+    template<ForwardModel f>
+    Eigen::VectorXd likelihoodGradient(const typename Types<f>::Results& synthetic, const LikelihoodContext<f>& context,
+                                       const typename Types<f>::Spec& spec);
+
+    //! Calculate the likelihood of synthetic readings against the real data.
+    //! Convenience for one-off evaluations; repeated evaluations should build
+    //! the likelihood context once.
+    //!
+    template<ForwardModel f>
+    double likelihood(const typename Types<f>::Results& synthetic, const typename Types<f>::Results& real,
+                      const typename Types<f>::Spec& spec)
+    {
+      return likelihood<f>(synthetic, likelihoodContext<f>(real, spec), spec);
+    }
+
     Eigen::VectorXd mtLikelihoodVector(const Eigen::MatrixX4cd& impedences);
 
     std::vector<double> likelihoodAll(const GlobalResults& synthetic, const GlobalResults& real, const GlobalSpec& spec,
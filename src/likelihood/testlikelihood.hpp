@@ -0,0 +1,247 @@
+//!
+//! Contains tests for the likelihoods of the forward models.
+//!
+//! \file likelihood/testlikelihood.hpp
+//! \date 2026
+//! \license General Public License version 3 or later
+//! \copyright (c) 2014, NICTA
+//!
+
+#include <gtest/gtest.h>
+#include <cmath>
+
+#include "likelihood/likelihood.hpp"
+#include "test/gravity.hpp"
+#include "test/magnetism.hpp"
+#include "test/mt.hpp"
+#include "test/seismic.hpp"
+#include "test/contactpoint.hpp"
+#include "test/thermal.hpp"
+
+namespace obsidian
+{
+  namespace lh
+  {
+    //! The likelihoods as they were computed from the readings on every call,
+    //! before the observed statistics were kept in a context.
+    //!
+    template<ForwardModel f>
+    double readingsLikelihood(const typename Types<f>::Results& synthetic, const typename Types<f>::Results& real,
+                              const typename Types<f>::Spec& spec);
+
+    //! Whether synthetic and real readings can be compared under a spec.
+    //!
+    template<ForwardModel f>
+    bool comparable(const typename Types<f>::Results& synthetic, const typename Types<f>::Results& real,
+                    const typename Types<f>::Spec& spec)
+    {
+      return synthetic.readings.size() == real.readings.size();
+    }
+
+    double sd(const Eigen::VectorXd& x)
+    {
+      return std::sqrt((x.array() - x.mean()).pow(2.0).sum() / (double) (x.size()));
+    }
+
+    double sd(const std::vector<Eigen::VectorXd>& x)
+    {
+      uint totalSize = 0;
+      for (auto const& i : x)
+        totalSize += i.size();
+      Eigen::VectorXd full(totalSize);
+      uint start = 0;
+      for (auto const& i : x)
+      {
+        full.segment(start, i.size()) = i;
+        start += i.size();
+      }
+      return sd(full);
+    }
+
+    double shiftedReadingsLikelihood(const Eigen::VectorXd& synthetic, const Eigen::VectorXd& real, const NoiseSpec& noise)
+    {
+      if (real.size() == 0)
+        return 0.0;
+      Eigen::VectorXd synShifted = synthetic.array() - synthetic.mean();
+      Eigen::VectorXd realShifted = real.array() - real.mean();
+      double sigma = sd(realShifted);
+      return normalInverseGamma(synShifted / sigma, realShifted / sigma, noise.inverseGammaAlpha, noise.inverseGammaBeta);
+    }
+
+    double listReadingsLikelihood(const std::vector<Eigen::VectorXd>& synthetic, const std::vector<Eigen::VectorXd>& real,
+                                  const NoiseSpec& noise)
+    {
+      if (real.size() == 0)
+        return 0.0;
+      double l = 0;
+      double sigma = sd(real);
+      for (uint i = 0; i < synthetic.size(); i++)
+        l += normalInverseGamma(real[i] / sigma, synthetic[i] / sigma, noise.inverseGammaAlpha, noise.inverseGammaBeta);
+      return l;
+    }
+
+    template<>
+    double readingsLikelihood<ForwardModel::GRAVITY>(const GravResults& synthetic, const GravResults& real, const GravSpec& spec)
+    {
+      return shiftedReadingsLikelihood(synthetic.readings, real.readings, spec.noise);
+    }
+
+    template<>
+    double readingsLikelihood<ForwardModel::MAGNETICS>(const MagResults& synthetic, const MagResults& real, const MagSpec& spec)
+    {
+      return shiftedReadingsLikelihood(synthetic.readings, real.readings, spec.noise);
+    }
+
+    //! Apparent resistivity of the two modes, or of the first mode twice if
+    //! the readings are isotropic.
+    //!
+    Eigen::VectorXd apparentRes(const Eigen::MatrixX4cd& impedences, const Eigen::VectorXd& freqs, bool isotropic)
+    {
+      Eigen::VectorXd v(impedences.rows() * 2);
+      for (uint r = 0; r < impedences.rows(); r++)
+      {
+        v(2 * r) = std::pow(std::abs(impedences(r, 1)), 2) * 0.2 / freqs[r];
+        v(2 * r + 1) = std::pow(std::abs(impedences(r, isotropic ? 1 : 2)), 2) * 0.2 / freqs[r];
+      }
+      return v;
+    }
+
+    template<>
+    double readingsLikelihood<ForwardModel::MTANISO>(const MtAnisoResults& synthetic, const MtAnisoResults& real,
+                                                     const MtAnisoSpec& spec)
+    {
+      if (real.readings.size() == 0)
+        return 0.0;
+      std::vector<Eigen::VectorXd> realReadings;
+      std::vector<Eigen::VectorXd> synReadings;
+      for (uint i = 0; i < real.readings.size(); i++)
+      {
+        realReadings.push_back(apparentRes(real.readings[i], spec.freqs[i], false));
+        synReadings.push_back(apparentRes(synthetic.readings[i], spec.freqs[i], spec.ignoreAniso));
+      }
+      double sigma = sd(realReadings);
+      double l = 0;
+      for (uint i = 0; i < real.readings.size(); i++)
+        l += 0.5 * normalInverseGamma(realReadings[i] / sigma, synReadings[i] / sigma, spec.noise.inverseGammaAlpha,
+                                      spec.noise.inverseGammaBeta);
+      return l;
+    }
+
+    template<>
+    bool comparable<ForwardModel::MTANISO>(const MtAnisoResults& synthetic, const MtAnisoResults& real, const MtAnisoSpec& spec)
+    {
+      if (synthetic.readings.size() != real.readings.size() || real.readings.size() != spec.freqs.size())
+        return false;
+      for (uint i = 0; i < real.readings.size(); i++)
+      {
+        if (synthetic.readings[i].rows() != spec.freqs[i].size() || real.readings[i].rows() != spec.freqs[i].size())
+          return false;
+      }
+      return true;
+    }
+
+    template<>
+    double readingsLikelihood<ForwardModel::SEISMIC1D>(const Seismic1dResults& synthetic, const Seismic1dResults& real,
+                                                       const Seismic1dSpec& spec)
+    {
+      return listReadingsLikelihood(synthetic.readings, real.readings, spec.noise);
+    }
+
+    template<>
+    bool comparable<ForwardModel::SEISMIC1D>(const Seismic1dResults& synthetic, const Seismic1dResults& real,
+                                             const Seismic1dSpec& spec)
+    {
+      return synthetic.readings.size() == real.readings.size()
+          && (real.readings.size() == 0 || synthetic.readings[0].size() == real.readings[0].size());
+    }
+
+    template<>
+    double readingsLikelihood<ForwardModel::CONTACTPOINT>(const ContactPointResults& synthetic, const ContactPointResults& real,
+                                                          const ContactPointSpec& spec)
+    {
+      return listReadingsLikelihood(synthetic.readings, real.readings, spec.noise);
+    }
+
+    template<>
+    bool comparable<ForwardModel::CONTACTPOINT>(const ContactPointResults& synthetic, const ContactPointResults& real,
+                                                const ContactPointSpec& spec)
+    {
+      return synthetic.readings.size() == real.readings.size()
+          && (real.readings.size() == 0 || synthetic.readings[0].size() == real.readings[0].size());
+    }
+
+    template<>
+    double readingsLikelihood<ForwardModel::THERMAL>(const ThermalResults& synthetic, const ThermalResults& real,
+                                                     const ThermalSpec& spec)
+    {
+      if (real.readings.size() == 0)
+        return 0.0;
+      double sigma = sd(real.readings);
+      return normalInverseGamma(synthetic.readings / sigma, real.readings / sigma, spec.noise.inverseGammaAlpha,
+                                spec.noise.inverseGammaBeta);
+    }
+
+    //! Compare the likelihoods against a context with those computed from the
+    //! readings, for every pair of comparable results of the test fixtures.
+    //!
+    template<ForwardModel f>
+    void expectContextMatchesReadings()
+    {
+      uint nCompared = 0;
+      generateVariations<typename Types<f>::Spec>([&](typename Types<f>::Spec spec)
+      {
+        // The normal inverse Gamma needs positive parameters
+        spec.noise.inverseGammaAlpha = std::abs(spec.noise.inverseGammaAlpha) + 0.1;
+        spec.noise.inverseGammaBeta = std::abs(spec.noise.inverseGammaBeta) + 0.1;
+        generateVariations<typename Types<f>::Results>([&](typename Types<f>::Results real)
+        {
+          if (!comparable<f>(real, real, spec))
+            return;
+          LikelihoodContext<f> context = likelihoodContext<f>(real, spec);
+          generateVariations<typename Types<f>::Results>([&](typename Types<f>::Results synthetic)
+          {
+            if (!comparable<f>(synthetic, real, spec))
+              return;
+            double expected = readingsLikelihood<f>(synthetic, real, spec);
+            double l = likelihood<f>(synthetic, context, spec);
+            ASSERT_TRUE(std::isfinite(expected));
+            EXPECT_NEAR(expected, l, 1e-9 * (1.0 + std::abs(expected)));
+            EXPECT_EQ(l, likelihood<f>(synthetic, real, spec));
+            nCompared++;
+          });
+        });
+      });
+      EXPECT_GT(nCompared, 0U);
+    }
+
+    TEST(LikelihoodTest, gravityContextMatchesReadings)
+    {
+      expectContextMatchesReadings<ForwardModel::GRAVITY>();
+    }
+
+    TEST(LikelihoodTest, magneticsContextMatchesReadings)
+    {
+      expectContextMatchesReadings<ForwardModel::MAGNETICS>();
+    }
+
+    TEST(LikelihoodTest, mtContextMatchesReadings)
+    {
+      expectContextMatchesReadings<ForwardModel::MTANISO>();
+    }
+
+    TEST(LikelihoodTest, seismicContextMatchesReadings)
+    {
+      expectContextMatchesReadings<ForwardModel::SEISMIC1D>();
+    }
+
+    TEST(LikelihoodTest, contactPointContextMatchesReadings)
+    {
+      expectContextMatchesReadings<ForwardModel::CONTACTPOINT>();
+    }
+
+    TEST(LikelihoodTest, thermalContextMatchesReadings)
+    {
+      expectContextMatchesReadings<ForwardModel::THERMAL>();
+    }
+  }
+}
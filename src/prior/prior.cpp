@@ -35,6 +35,23 @@ namespace obsidian
     return logPDF;
   }
 
+  WorldParams GlobalPrior::logPDFGradient(const Eigen::VectorXd& theta)
+  {
+    return world.logPDFGradient(reconstruct(theta).world);
+  }
+
+  Eigen::VectorXd GlobalPrior::thetaGradient(const WorldParams& gradient)
+  {
+    // elaborate for other priors...
+    return world.thetaGradient(gradient);
+  }
+
+  std::vector<uint> GlobalPrior::thetaBlocks()
+  {
+    // elaborate for other priors...
+    return world.thetaBlocks();
+  }
+
   Eigen::VectorXd GlobalPrior::sample(std::mt19937 &gen)
   {
     Eigen::VectorXd worldTheta = world.sample(gen);
@@ -44,6 +44,13 @@ namespace obsidian
 
     GlobalParams reconstruct(const Eigen::VectorXd& theta);
     double evaluate(const Eigen::VectorXd& theta);
+    // Gradient of evaluate with respect to the world params
+    WorldParams logPDFGradient(const Eigen::VectorXd& theta);
+    // Chain a gradient with respect to the world params back to theta
+    Eigen::VectorXd thetaGradient(const WorldParams& gradient);
+    // Offsets of the blocks of theta that belong to one layer's properties
+    // or control points, followed by the size of theta
+    std::vector<uint> thetaBlocks();
     Eigen::VectorXd sample(std::mt19937 &gen);
 
     uint size();
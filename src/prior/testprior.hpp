@@ -154,6 +154,15 @@ namespace obsidian
     EXPECT_EQ(testParams, params);
   }
 
+  TEST_F(PriorTest, thetaBlocks)
+  {
+    // The unmasked properties of each layer, then the unmasked control
+    // points of each layer
+    std::vector<uint> expected = { 0, 9, 18, 23, 32, 33, 36, 45, 94 };
+    EXPECT_EQ(expected, ptrPrior->thetaBlocks());
+    EXPECT_EQ(ptrPrior->size(), ptrPrior->thetaBlocks().back());
+  }
+
   TEST_F(PriorTest, sample)
   {
     std::random_device rd;
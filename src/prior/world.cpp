@@ -155,6 +155,82 @@ namespace obsidian
       return wParams;
     }
 
+    std::vector<uint> WorldParamsPrior::thetaBlocks()
+    {
+      uint nLayers = propertyPrior.size();
+      std::vector<uint> offsets;
+      uint count = 0;
+      for (uint i = 0; i < nLayers; i++)
+      {
+        uint n = propMasks[i].sum();
+        if (n > 0)
+          offsets.push_back(count);
+        count += n;
+      }
+      for (uint i = 0; i < nLayers; i++)
+      {
+        uint n = ctrlptMasks[i].sum();
+        if (n > 0)
+          offsets.push_back(count);
+        count += n;
+      }
+      offsets.push_back(count);
+      return offsets;
+    }
+
+    // Same order as deconstruct; the derivative of unwhiten is its scale
+    Eigen::VectorXd WorldParamsPrior::thetaGradient(const WorldParams& gradient)
+    {
+      uint nLayers = propertyPrior.size();
+      CHECK_EQ(nLayers, gradient.rockProperties.size());
+      CHECK_EQ(nLayers, gradient.controlPoints.size());
+      Eigen::VectorXd theta(size());
+      uint count = 0;
+      for (uint i = 0; i < nLayers; i++)
+      {
+        uint sizeRock = prod(propertyPrior[i].shape);
+        for (uint j = 0; j < sizeRock; j++)
+        {
+          if (propMasks[i](j))
+            theta(count++) = gradient.rockProperties[i](j)
+                * unwhiten(1.0, 0.0, propertyPrior[i].sigma(j, j), propMins[i](j), propMaxs[i](j));
+        }
+      }
+      for (uint i = 0; i < nLayers; i++)
+      {
+        for (uint j = 0; j < ctrlptPrior[i].shape.first; j++)
+          for (uint k = 0; k < ctrlptPrior[i].shape.second; k++)
+          {
+            auto ej = j * ctrlptPrior[i].shape.second + k;
+            if (ctrlptMasks[i](j, k))
+              theta(count++) = gradient.controlPoints[i](j, k)
+                  * unwhiten(1.0, 0.0, ctrlptPrior[i].sigma(ej, ej), ctrlptMins[i](j, k), ctrlptMaxs[i](j, k));
+          }
+      }
+      return theta;
+    }
+
+    WorldParams WorldParamsPrior::logPDFGradient(const WorldParams& params)
+    {
+      uint nLayers = propertyPrior.size();
+      WorldParams gradient;
+      for (uint i = 0; i < nLayers; i++)
+      {
+        gradient.rockProperties.push_back(distrib::logPDFGradient(params.rockProperties[i], propertyPrior[i]));
+        const Eigen::MatrixXd& ctrlpts = params.controlPoints[i];
+        if (classes[i] == BoundaryClass::Warped)
+        {
+          gradient.controlPoints.push_back(Eigen::MatrixXd::Zero(ctrlpts.rows(), ctrlpts.cols()));
+        } else
+        {
+          // logPDF sees the control points in storage order
+          Eigen::VectorXd flat = distrib::logPDFGradient(Eigen::VectorXd::Map(ctrlpts.data(), ctrlpts.size()), ctrlptPrior[i]);
+          gradient.controlPoints.push_back(Eigen::MatrixXd::Map(flat.data(), ctrlpts.rows(), ctrlpts.cols()));
+        }
+      }
+      return gradient;
+    }
+
     Eigen::VectorXd WorldParamsPrior::sample(std::mt19937 &gen)
     {
       std::vector<bool> uniformFlags;
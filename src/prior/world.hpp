@@ -93,6 +93,13 @@ namespace obsidian
       // Evaluate log likelihood of theta under this prior
       double evaluatePDF(const Eigen::VectorXd& theta);
 
+      // Gradient of evaluatePDF with respect to the world params, ignoring
+      // the bounds. Uniform (warped) layers have no gradient
+      WorldParams logPDFGradient(const WorldParams& params);
+
+      // Chain a gradient with respect to the world params back to theta
+      Eigen::VectorXd thetaGradient(const WorldParams& gradient);
+
       // randomly sample a valid set of parameters
       Eigen::VectorXd sample(std::mt19937 &gen);
 
@@ -102,6 +109,11 @@ namespace obsidian
       // turn a WorldParams object into a flat vector
       Eigen::VectorXd deconstruct(const WorldParams& params);
 
+      // The offsets in theta of the properties of each layer followed by the
+      // control points of each layer, skipping blocks with nothing unmasked.
+      // The last element is the size of theta
+      std::vector<uint> thetaBlocks();
+
       // private:
       std::vector<Eigen::MatrixXi> ctrlptMasks;
       std::vector<Eigen::MatrixXd> ctrlptMins;
@@ -9,6 +9,7 @@
 #include "serial/gravity.hpp"
 #include "serial/serialtypes.pb.h" // should have been generated in current dir
 #include "serial/utility.hpp"
+#include "serial/world.hpp"
 
 namespace obsidian
 {
@@ -47,6 +48,7 @@ namespace obsidian
     {
       GravParamsProtobuf pb;
       pb.set_returnsensordata(g.returnSensorData);
+      pb.set_returngradient(g.returnGradient);
       return protobufToString(pb);
     }
 
@@ -55,6 +57,7 @@ namespace obsidian
       GravParamsProtobuf pb;
       pb.ParseFromString(s);
       g.returnSensorData = pb.returnsensordata();
+      g.returnGradient = pb.returngradient();
     }
 
     std::string serialise(const GravResults& g)
@@ -66,6 +69,10 @@ namespace obsidian
         pb.set_numreadings(g.readings.size());
         pb.set_readings(matrixString(g.readings));
       }
+      if (g.gradient.rockProperties.size() > 0)
+      {
+        pb.set_gradient(serialise(g.gradient));
+      }
       return protobufToString(pb);
     }
 
@@ -78,6 +85,10 @@ namespace obsidian
       {
         g.readings = stringMatrix(pb.readings(), pb.numreadings());
       }
+      if (pb.has_gradient())
+      {
+        unserialise(pb.gradient(), g.gradient);
+      }
     }
 
   } // namespace comms
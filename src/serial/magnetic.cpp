@@ -9,6 +9,7 @@
 #include "serial/magnetic.hpp"
 #include "serial/serialtypes.pb.h" // should have been generated in current dir
 #include "serial/utility.hpp"
+#include "serial/world.hpp"
 
 namespace obsidian
 {
@@ -49,6 +50,7 @@ namespace obsidian
     {
       MagParamsProtobuf pb;
       pb.set_returnsensordata(m.returnSensorData);
+      pb.set_returngradient(m.returnGradient);
       return protobufToString(pb);
     }
 
@@ -57,6 +59,7 @@ namespace obsidian
       MagParamsProtobuf pb;
       pb.ParseFromString(s);
       m.returnSensorData = pb.returnsensordata();
+      m.returnGradient = pb.returngradient();
     }
 
     std::string serialise(const MagResults& m)
@@ -68,6 +71,10 @@ namespace obsidian
         pb.set_numreadings(m.readings.size());
         pb.set_readings(matrixString(m.readings));
       }
+      if (m.gradient.rockProperties.size() > 0)
+      {
+        pb.set_gradient(serialise(m.gradient));
+      }
       return protobufToString(pb);
     }
 
@@ -80,6 +87,10 @@ namespace obsidian
       {
         m.readings = stringMatrix(pb.readings(), pb.numreadings());
       }
+      if (pb.has_gradient())
+      {
+        unserialise(pb.gradient(), m.gradient);
+      }
     }
 
   } // namespace comms
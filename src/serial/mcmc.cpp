@@ -35,5 +35,67 @@ namespace stateline
       g.accepted = pb.accepted();
       g.swapType = (mcmc::SwapType) pb.swaptype();
     }
+
+    std::string serialise(const mcmc::Metrics& m)
+    {
+      MCMCMetricsProtobuf pb;
+      pb.set_seconds(m.seconds);
+      pb.set_numchains(m.numChains);
+      for (const mcmc::ChainMetrics& c : m.chains)
+      {
+        MCMCChainMetricsProtobuf* chain = pb.add_chain();
+        chain->set_length(c.length);
+        chain->set_lowestenergy(c.lowestEnergy);
+        chain->set_energy(c.energy);
+        chain->set_sigma(c.sigma);
+        chain->set_acceptrate(c.acceptRate);
+        chain->set_globalacceptrate(c.globalAcceptRate);
+        chain->set_beta(c.beta);
+        chain->set_swaprate(c.swapRate);
+        chain->set_globalswaprate(c.globalSwapRate);
+      }
+      pb.set_ess(m.ess);
+      pb.set_esspersecond(m.essPerSecond);
+      pb.set_essperevaluation(m.essPerEvaluation);
+      pb.set_screening(m.screening);
+      pb.set_nproposed(m.nProposed);
+      pb.set_nscreened(m.nScreened);
+      pb.set_ensemble(m.ensemble);
+      pb.set_nensembleproposed(m.nEnsembleProposed);
+      pb.set_nensembleaccepted(m.nEnsembleAccepted);
+      pb.set_swapdecisionseconds(m.swapDecisionSeconds);
+      pb.set_speculation(m.speculation);
+      pb.set_nspeculated(m.nSpeculated);
+      pb.set_nspeculationhits(m.nSpeculationHits);
+      return obsidian::comms::protobufToString(pb);
+    }
+
+    void unserialise(const std::string& s, mcmc::Metrics& g)
+    {
+      MCMCMetricsProtobuf pb;
+      pb.ParseFromString(s);
+      g.seconds = pb.seconds();
+      g.numChains = pb.numchains();
+      g.chains.resize(pb.chain_size());
+      for (int i = 0; i < pb.chain_size(); i++)
+      {
+        const MCMCChainMetricsProtobuf& chain = pb.chain(i);
+        g.chains[i] = mcmc::ChainMetrics { chain.length(), chain.lowestenergy(), chain.energy(), chain.sigma(), chain.acceptrate(),
+                                           chain.globalacceptrate(), chain.beta(), chain.swaprate(), chain.globalswaprate() };
+      }
+      g.ess = pb.ess();
+      g.essPerSecond = pb.esspersecond();
+      g.essPerEvaluation = pb.essperevaluation();
+      g.screening = pb.screening();
+      g.nProposed = pb.nproposed();
+      g.nScreened = pb.nscreened();
+      g.ensemble = pb.ensemble();
+      g.nEnsembleProposed = pb.nensembleproposed();
+      g.nEnsembleAccepted = pb.nensembleaccepted();
+      g.swapDecisionSeconds = pb.swapdecisionseconds();
+      g.speculation = pb.speculation();
+      g.nSpeculated = pb.nspeculated();
+      g.nSpeculationHits = pb.nspeculationhits();
+    }
   }
 }
@@ -20,5 +20,7 @@ namespace stateline
   {
     std::string serialise(const mcmc::State& g);
     void unserialise(const std::string& s, mcmc::State& g);
+    std::string serialise(const mcmc::Metrics& g);
+    void unserialise(const std::string& s, mcmc::Metrics& g);
   }
 }
@@ -0,0 +1,50 @@
+// Copyright (c) 2014, NICTA.
+// This file is licensed under the General Public License version 3 or later.
+// See the COPYRIGHT file.
+
+/**
+ * Contains tests for serialising the MCMC datatypes.
+ *
+ * @file testmcmc.cpp
+ * @date 2026
+ */
+
+#include "serial/mcmc.hpp"
+#include "test/serial.hpp"
+
+namespace stateline
+{
+TEST(SerialiseMCMC, testMetrics)
+{
+  mcmc::Metrics original;
+  original.seconds = 12.5;
+  original.numChains = 2;
+  original.chains.push_back(mcmc::ChainMetrics { 10, -3.0, -2.5, 0.1, 0.24, 0.3, 1.0, 0.2, 0.25 });
+  original.chains.push_back(mcmc::ChainMetrics { 11, -2.0, -1.5, 0.2, 0.22, 0.28, 0.5, 0.0, 0.0 });
+  original.ess = 4.5;
+  original.essPerSecond = 0.36;
+  original.essPerEvaluation = 0.2;
+  original.screening = true;
+  original.nProposed = 23;
+  original.nScreened = 3;
+  original.ensemble = false;
+  original.nEnsembleProposed = 0;
+  original.nEnsembleAccepted = 0;
+  original.swapDecisionSeconds = 0.01;
+  original.speculation = true;
+  original.nSpeculated = 40;
+  original.nSpeculationHits = 12;
+
+  std::string encoded = comms::serialise(original);
+  mcmc::Metrics decoded;
+  comms::unserialise(encoded, decoded);
+  EXPECT_EQ(encoded, comms::serialise(decoded));
+  ASSERT_EQ(2U, decoded.chains.size());
+  EXPECT_EQ(11U, decoded.chains[1].length);
+  EXPECT_DOUBLE_EQ(0.5, decoded.chains[1].beta);
+  EXPECT_DOUBLE_EQ(4.5, decoded.ess);
+  EXPECT_EQ(3U, decoded.nScreened);
+  EXPECT_TRUE(decoded.screening);
+  EXPECT_EQ(12U, decoded.nSpeculationHits);
+}
+}
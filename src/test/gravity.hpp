@@ -23,12 +23,14 @@ namespace obsidian
 
   inline bool operator==(const GravParams& g, const GravParams& p)
   {
-    return (g.returnSensorData == p.returnSensorData);
+    return (g.returnSensorData == p.returnSensorData) && (g.returnGradient == p.returnGradient);
   }
 
   inline bool operator==(const GravResults& g, const GravResults& p)
   {
-    return (g.likelihood == p.likelihood) && (g.readings == p.readings);
+    return (g.likelihood == p.likelihood) && (g.readings == p.readings)
+        && (g.gradient.rockProperties == p.gradient.rockProperties)
+        && (g.gradient.controlPoints == p.gradient.controlPoints);
   }
 
   inline std::ostream& operator<<(std::ostream& os, const GravSpec& spec)
@@ -65,6 +67,7 @@ namespace obsidian
     {
       GravParams param;
       param.returnSensorData = u;
+      param.returnGradient = !u;
       test(param);
     }
   }
@@ -77,6 +80,11 @@ namespace obsidian
       GravResults g;
       g.likelihood = testing::randomDouble();
       g.readings = testing::randomMatrix(u, 1);
+      for (uint i = 0; i < u / 5; i++)
+      {
+        g.gradient.rockProperties.push_back(testing::randomMatrix(3, 1));
+        g.gradient.controlPoints.push_back(testing::randomMatrix(2, 2));
+      }
       test(g);
     }
   }
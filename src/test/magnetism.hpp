@@ -24,12 +24,14 @@ namespace obsidian
 
   bool operator==(const MagParams& g, const MagParams& p)
   {
-    return (g.returnSensorData == p.returnSensorData);
+    return (g.returnSensorData == p.returnSensorData) && (g.returnGradient == p.returnGradient);
   }
 
   bool operator==(const MagResults& g, const MagResults& p)
   {
-    return (g.likelihood == p.likelihood) && (g.readings == p.readings);
+    return (g.likelihood == p.likelihood) && (g.readings == p.readings)
+        && (g.gradient.rockProperties == p.gradient.rockProperties)
+        && (g.gradient.controlPoints == p.gradient.controlPoints);
   }
 
   inline std::ostream& operator<<(std::ostream& os, const MagSpec& spec)
@@ -68,6 +70,7 @@ namespace obsidian
     {
       MagParams param;
       param.returnSensorData = u;
+      param.returnGradient = !u;
       test(param);
     }
   }
@@ -80,6 +83,11 @@ namespace obsidian
       MagResults g;
       g.likelihood = testing::randomDouble();
       g.readings = testing::randomMatrix(u, 1);
+      for (uint i = 0; i < u / 5; i++)
+      {
+        g.gradient.rockProperties.push_back(testing::randomMatrix(3, 1));
+        g.gradient.controlPoints.push_back(testing::randomMatrix(2, 2));
+      }
       test(g);
     }
   }
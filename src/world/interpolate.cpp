@@ -38,8 +38,13 @@ namespace obsidian
 
     Eigen::VectorXd linearInterpolate(const Query& query, InterpolatorSpec interpolator)
     {
-      uint nQuery = query.positionXY.rows();
+      return linearInterpolate(query, interpolator, query.positionXY.rows());
+    }
+
+    Eigen::VectorXd linearInterpolate(const Query& query, const InterpolatorSpec& interpolator, uint nQuery)
+    {
       CHECK(query.positionXY.cols() == 2);
+      CHECK(nQuery <= query.positionXY.rows());
 
       double imWidth  = interpolator.offsetFunction.rows();
       double imHeight = interpolator.offsetFunction.cols();
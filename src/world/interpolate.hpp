@@ -47,5 +47,15 @@ namespace obsidian
     //!
     Eigen::VectorXd linearInterpolate(const Query& query, InterpolatorSpec interpolator);
 
+    //! Linearly interpolate the depth of the first few points of a query.
+    //!
+    //! \param query The 3D query.
+    //! \param interpolator The interpolator specificaitons.
+    //! \param nQuery The number of leading query points to interpolate.
+    //!
+    //! \returns A vector of depths that correspond to the first nQuery points.
+    //!
+    Eigen::VectorXd linearInterpolate(const Query& query, const InterpolatorSpec& interpolator, uint nQuery);
+
   } // world namespace
 } // gdf namespace
@@ -210,5 +210,33 @@ namespace obsidian
       }
       return properties;
     }
+
+    void propertyGradient(const WorldParams& input, obsidian::RockProperty desiredProp, const Eigen::VectorXd& gradient,
+                          WorldParams& worldGradient)
+    {
+      const bool isExp = desiredProp == RockProperty::Susceptibility || desiredProp == RockProperty::ResistivityX
+          || desiredProp == RockProperty::ResistivityY || desiredProp == RockProperty::ResistivityZ;
+      uint propIndex = static_cast<uint>(desiredProp);
+      if (desiredProp == RockProperty::Susceptibility)
+        propIndex = static_cast<uint>(RockProperty::LogSusceptibility);
+      else if (desiredProp == RockProperty::ResistivityX)
+        propIndex = static_cast<uint>(RockProperty::LogResistivityX);
+      else if (desiredProp == RockProperty::ResistivityY)
+        propIndex = static_cast<uint>(RockProperty::LogResistivityY);
+      else if (desiredProp == RockProperty::ResistivityZ)
+        propIndex = static_cast<uint>(RockProperty::LogResistivityZ);
+
+      Eigen::VectorXd properties = extractProperty(input, desiredProp);
+      for (uint i = 0; i < properties.size(); i++)
+      {
+        double raw = input.rockProperties[i](propIndex);
+        double d;
+        if (isExp)
+          d = properties(i) > 0.0 ? properties(i) * std::log(10) : 0.0; // d/dx 10^x
+        else
+          d = properties(i) == raw ? 1.0 : 0.0; // zero where the bound is active
+        worldGradient.rockProperties[i](propIndex) += gradient(i) * d;
+      }
+    }
   } // namespace world
 } // namespace obsidian
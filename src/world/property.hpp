@@ -25,6 +25,18 @@ namespace obsidian
     //!
     Eigen::VectorXd extractProperty(const WorldParams& input, obsidian::RockProperty desiredProp);
 
+    //! Chain a gradient with respect to a property of each layer (as returned
+    //! by extractProperty()) back to the rock properties of the world.
+    //!
+    //! \param input The worldParams object.
+    //! \param desiredProp The property the gradient is with respect to.
+    //! \param gradient The gradient with respect to the property of each layer.
+    //! \param worldGradient The gradient with respect to the world
+    //!        parameters. The rock property gradients are added to it.
+    //!
+    void propertyGradient(const WorldParams& input, obsidian::RockProperty desiredProp, const Eigen::VectorXd& gradient,
+                          WorldParams& worldGradient);
+
   } // namespace world
 } // namespace obsidian
 
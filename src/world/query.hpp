@@ -12,6 +12,8 @@
 #pragma once
 
 #include <Eigen/Core>
+#include <algorithm>
+#include <numeric>
 #include "datatype/world.hpp"
 #include "world/interpolatorspec.hpp"
 #include "world/grid.hpp"
@@ -64,18 +66,61 @@ namespace obsidian
 
         cacheInitialised = false;
         boundariesAreTimes = region.boundariesAreTimes;
+        partial = false;
         initInterpolatorWeights(boundaries);
       }
 
       // MT needs a scatter sample
       // note:locations should be n*2
       Query(const std::vector<InterpolatorSpec>& boundaries, WorldSpec region, Eigen::MatrixXd locations)
-       : positionXY(locations), cacheInitialised(false)
+       : positionXY(locations), cacheInitialised(false), partial(false)
       {
         boundariesAreTimes = region.boundariesAreTimes;
         initInterpolatorWeights(boundaries);
       }
 
+      //! Scatter query for point sensors that only need the boundaries down to
+      //! a given depth. Because boundaries are clamped to lie below the ones
+      //! above them, a point needing boundary i also needs all boundaries
+      //! above it. The points are stored ordered by decreasing depth so the
+      //! points needing each boundary form a prefix, and the weights of each
+      //! boundary are only computed for that prefix.
+      //!
+      //! \param boundaries List of interpolator specifications.
+      //! \param region The world specifications.
+      //! \param locations The n*2 query locations.
+      //! \param deepestBoundary The deepest boundary needed at each location,
+      //!        or -1 if none is needed.
+      //!
+      Query(const std::vector<InterpolatorSpec>& boundaries, WorldSpec region, Eigen::MatrixXd locations,
+          const Eigen::VectorXi &deepestBoundary)
+       : cacheInitialised(false), partial(true)
+      {
+        boundariesAreTimes = region.boundariesAreTimes;
+        uint nPoints = locations.rows();
+
+        pointOrder.resize(nPoints);
+        std::iota(pointOrder.begin(), pointOrder.end(), 0);
+        std::stable_sort(pointOrder.begin(), pointOrder.end(), [&](uint a, uint b)
+        {
+          return deepestBoundary(a) > deepestBoundary(b);
+        });
+
+        positionXY.resize(nPoints, locations.cols());
+        for (uint k = 0; k < nPoints; k++)
+          positionXY.row(k) = locations.row(pointOrder[k]);
+
+        int deepest = nPoints > 0 ? std::min<int>(deepestBoundary.maxCoeff(), boundaries.size() - 1) : -1;
+        uint nActive = nPoints;
+        for (int i = 0; i <= deepest; i++)
+        {
+          while (nActive > 0 && deepestBoundary(pointOrder[nActive - 1]) < i)
+            nActive--;
+          activePoints.push_back(nActive);
+          interpolatorWeights.push_back(boundaries[i].getWeights(positionXY.topRows(nActive)).transpose());
+        }
+      }
+
       //! Initialise interpolator weights.
       //!
       //! \param boundaries List of interpolator specifications.
@@ -89,7 +134,7 @@ namespace obsidian
       }
 
       //! Default constructor for global objects
-      Query(){}
+      Query() : partial(false) {}
 
       //! Get the number of points in the query.
       //!
@@ -132,6 +177,17 @@ namespace obsidian
 
       //!
       std::vector<Eigen::MatrixXd> interpolatorWeights;
+
+      //! Whether the points only need the boundaries down to a given depth.
+      //! A partial query may have no points at all.
+      bool partial;
+
+      //! For partial queries, the original index of each (sorted) point.
+      std::vector<uint> pointOrder;
+
+      //! For partial queries, the number of leading points that need each
+      //! boundary. Boundaries past the end are not needed by any point.
+      std::vector<uint> activePoints;
     };
   }
 }
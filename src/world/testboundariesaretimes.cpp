@@ -53,6 +53,73 @@ namespace obsidian
     double error = (transitions - expected_transitions).norm();
     EXPECT_LT(error, 0.01);
   }
+
+  TEST_F(WorldTest, partialTransitionsMatchFull)
+  {
+    WorldSpec spec;
+    WorldParams params;
+
+    testing::initWorld(spec, params, -10, 10, 20, -10, 10, 20, 0,
+        20, 5, [](double x, double y, uint boundary)
+        {
+        return boundary + 0.1 * x - 0.05 * y;
+        }, [](double x, double y, double boundary)
+        {
+        return 0;
+        }, [](uint layer, uint property)
+        {
+        if (property == static_cast<uint>(RockProperty::PWaveVelocity))
+        {
+        return 1.0 + (layer % 2);
+        }
+        return 0.0;
+        });
+    spec.boundariesAreTimes = true;
+    std::vector<world::InterpolatorSpec> interpolation = world::worldspec2Interp(spec);
+    Eigen::MatrixXd locations(4, 2);
+    locations << -5, 3, 2, -1, 7, 7, 0, -8;
+    Eigen::VectorXi deepest(4);
+    deepest << 1, 3, -1, 2;
+
+    world::Query fullQuery(interpolation, spec, locations);
+    world::Query partialQuery(interpolation, spec, locations, deepest);
+    Eigen::MatrixXd full = world::getTransitions(interpolation, params, fullQuery);
+    Eigen::MatrixXd partial = world::getTransitions(interpolation, params, partialQuery);
+
+    ASSERT_EQ(4, partial.rows());
+    ASSERT_EQ(4, partial.cols());
+    for (uint location = 0; location < 4; location++)
+    {
+      for (int boundary = 0; boundary <= deepest(location); boundary++)
+        EXPECT_NEAR(full(boundary, location), partial(boundary, location), 1e-9);
+    }
+  }
+
+  TEST_F(WorldTest, partialTransitionsOfNoPoints)
+  {
+    WorldSpec spec;
+    WorldParams params;
+
+    testing::initWorld(spec, params, -10, 10, 20, -10, 10, 20, 0,
+        20, 5, [](double x, double y, uint boundary)
+        {
+        return boundary;
+        }, [](double x, double y, double boundary)
+        {
+        return 0;
+        }, [](uint layer, uint property)
+        {
+        return 1.0;
+        });
+    std::vector<world::InterpolatorSpec> interpolation = world::worldspec2Interp(spec);
+    Eigen::MatrixXd locations(0, 2);
+    Eigen::VectorXi deepest(0);
+
+    world::Query query(interpolation, spec, locations, deepest);
+    Eigen::MatrixXd transitions = world::getTransitions(interpolation, params, query);
+    EXPECT_EQ(0, transitions.rows());
+    EXPECT_EQ(0, transitions.cols());
+  }
 }
 
 const int logLevel = -3;
@@ -11,15 +11,21 @@
 
 #include "world/transitions.hpp"
 
+#include <limits>
+#include <glog/logging.h>
+
 namespace obsidian
 {
   namespace world
   {
     Eigen::MatrixXd getTransitions(const std::vector<world::InterpolatorSpec>& region, const WorldParams& inputs, const Query& query)
     {
-      uint nBoundaries = region.size();
+      bool partial = query.partial;
+      uint nBoundaries = partial ? query.activePoints.size() : region.size();
       uint nQuery = query.numPoints();
       Eigen::MatrixXd transitions(nBoundaries, nQuery);
+      if (partial)
+        transitions.setConstant(std::numeric_limits<double>::quiet_NaN());
       Eigen::VectorXd lastTransition; // the previous transition
       Eigen::VectorXd transitioni = Eigen::VectorXd::Zero(nQuery); // special transition...
       double floorHeight = region[0].floorHeight; // assume same for all
@@ -28,20 +34,22 @@ namespace obsidian
       Eigen::VectorXd last_offset;
       for (uint i = 0; i < nBoundaries; i++)
       {
-        lastTransition = transitioni;
+        // Only the leading points of a partial query need this boundary
+        uint nActive = partial ? query.activePoints[i] : nQuery;
+        lastTransition = transitioni.head(nActive);
         // We pass i into kernelInterpolate so it knows which weights to cache
         transitioni = kernelInterpolate(query, i, ctrlPts[i]);
         // clip
 
         // Add in the mean function here - need to change interpolator spec
         // its input free (we could really cache this per layer per query!)
-        Eigen::VectorXd offseti = linearInterpolate(query, region[i]);
+        Eigen::VectorXd offseti = linearInterpolate(query, region[i], nActive);
 
         if (query.boundariesAreTimes)
         {
           if (i > 0)
           {
-            offseti = last_offset
+            offseti = last_offset.head(nActive)
               + offseti * inputs.rockProperties[i - 1][static_cast<uint>(RockProperty::PWaveVelocity)];
           }
 
@@ -59,15 +67,78 @@ namespace obsidian
           transitioni = postProcessGranites(transitioni, offseti, lastTransition, query,  i, inputs.controlPoints[i], floorHeight);
 
         // Enforce clipping between rows
-        transitions.row(i) = transitioni;
+        transitions.row(i).head(nActive) = transitioni;
 
       }
       // Now we can mark it as cached :)
       //query.cacheInitialised = true;
 
+      if (partial)
+      {
+        // Put the points back in their original order
+        Eigen::MatrixXd ordered(nBoundaries, nQuery);
+        for (uint k = 0; k < nQuery; k++)
+          ordered.col(query.pointOrder[k]) = transitions.col(k);
+        return ordered;
+      }
       return transitions;
     }
 
+    std::vector<Eigen::MatrixXd> getTransitionsGradient(const std::vector<world::InterpolatorSpec>& region,
+        const WorldParams& inputs, const Query& query, const Eigen::MatrixXd& transitions,
+        const Eigen::MatrixXd& gradient)
+    {
+      CHECK(!query.partial) << "Transition gradients of partial queries are not supported";
+      uint nBoundaries = region.size();
+      uint nQuery = query.numPoints();
+      double floorHeight = region[0].floorHeight;
+      const std::vector<Eigen::MatrixXd> &ctrlPts = inputs.controlPoints;
+
+      // Recompute the unclipped transitions to see which clip was active
+      std::vector<Eigen::VectorXd> raw(nBoundaries);
+      Eigen::VectorXd last_offset;
+      for (uint i = 0; i < nBoundaries; i++)
+      {
+        Eigen::VectorXd offseti = linearInterpolate(query, region[i], nQuery);
+        if (query.boundariesAreTimes)
+        {
+          if (i > 0)
+          {
+            offseti = last_offset
+              + offseti * inputs.rockProperties[i - 1][static_cast<uint>(RockProperty::PWaveVelocity)];
+          }
+          last_offset = offseti;
+        }
+        raw[i] = kernelInterpolate(query, i, ctrlPts[i]) + offseti;
+      }
+
+      // Pass the gradients up through the boundaries
+      std::vector<Eigen::MatrixXd> ctrlGradient(nBoundaries);
+      Eigen::MatrixXd g = gradient;
+      for (int i = nBoundaries - 1; i >= 0; i--)
+      {
+        Eigen::VectorXd rawGradient = Eigen::VectorXd::Zero(nQuery);
+        for (uint k = 0; k < nQuery; k++)
+        {
+          double lastTransition = i > 0 ? transitions(i - 1, k) : 0.0;
+          if (std::max(raw[i](k), lastTransition) > floorHeight)
+            continue;
+          if (raw[i](k) >= lastTransition)
+            rawGradient(k) = g(i, k);
+          else if (i > 0)
+            g(i - 1, k) += g(i, k);
+        }
+
+        ctrlGradient[i] = Eigen::MatrixXd::Zero(ctrlPts[i].rows(), ctrlPts[i].cols());
+        if (region[i].boundaryClass != obsidian::BoundaryClass::Warped)
+        {
+          Eigen::VectorXd flatGradient = query.interpolatorWeights[i].transpose() * rawGradient;
+          ctrlGradient[i] = Eigen::Map<Eigen::MatrixXd>(flatGradient.data(), ctrlPts[i].rows(), ctrlPts[i].cols());
+        }
+      }
+      return ctrlGradient;
+    }
+
     Eigen::MatrixXd thickness(const Eigen::MatrixXd& transitions)
     {
       uint mqueries = transitions.cols();
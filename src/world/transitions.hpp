@@ -28,9 +28,32 @@ namespace obsidian
     //! \return A matrix with rows containing the depths of the query points at
     //!         every layer.
     //!
+    //! For a partial query (see Query) only the rows down to the deepest
+    //! needed boundary are returned, and entries a point does not need are NaN.
+    //! The columns are always in the original location order.
+    //!
     Eigen::MatrixXd getTransitions(const std::vector<world::InterpolatorSpec>& boundaries,
         const WorldParams &inputs, const Query &query);
 
+    //! Chain a gradient with respect to the transitions of getTransitions()
+    //! back to the control points. Where a transition is clipped to the one
+    //! above it, its gradient goes to that transition; where it is clipped to
+    //! the floor it has none. Warped boundaries and the dependence of time
+    //! boundaries on the wave velocities are held fixed. Partial queries are
+    //! not supported.
+    //!
+    //! \param boundaries The interpolator specs for each layer.
+    //! \param inputs The world model parameters.
+    //! \param query The query containing the query points.
+    //! \param transitions The transitions returned by getTransitions().
+    //! \param gradient The gradient with respect to the transitions.
+    //!
+    //! \return The gradient with respect to the control points of each layer.
+    //!
+    std::vector<Eigen::MatrixXd> getTransitionsGradient(const std::vector<world::InterpolatorSpec>& boundaries,
+        const WorldParams &inputs, const Query &query, const Eigen::MatrixXd &transitions,
+        const Eigen::MatrixXd &gradient);
+
     //! Get the thickness of each layer at each query point.
     //! 
     //! \param transitions A nlayers by mqueries matrix of the transitions between layers at each sensor location.
@@ -31,6 +31,75 @@ namespace obsidian
       return properties;
     }
 
+    WorldParams getVoxelsGradient(const std::vector<world::InterpolatorSpec>& interpolators,
+        const WorldParams& inputs, const Query& query, obsidian::RockProperty desiredProp,
+        const Eigen::MatrixXd& gradient)
+    {
+      WorldParams worldGradient;
+      for (uint i = 0; i < inputs.rockProperties.size(); i++)
+        worldGradient.rockProperties.push_back(Eigen::VectorXd::Zero(inputs.rockProperties[i].size()));
+
+      Eigen::MatrixXd transitions = getTransitions(interpolators, inputs, query);
+      Eigen::VectorXd props = extractProperty(inputs, desiredProp);
+      Eigen::MatrixXd transitionsGradient;
+      Eigen::VectorXd propsGradient;
+      voxeliseGradient(transitions, query.edgeZ, props, gradient, transitionsGradient, propsGradient);
+
+      propertyGradient(inputs, desiredProp, propsGradient, worldGradient);
+      worldGradient.controlPoints = getTransitionsGradient(interpolators, inputs, query, transitions, transitionsGradient);
+      return worldGradient;
+    }
+
+    void voxeliseGradient(const Eigen::MatrixXd &transitions, const Eigen::VectorXd &zIntercepts,
+        const Eigen::VectorXd &props, const Eigen::MatrixXd &gradient,
+        Eigen::MatrixXd &transitionsGradient, Eigen::VectorXd &propsGradient)
+    {
+      // Walks the cells exactly as voxelise() does
+      uint nCellsVert = zIntercepts.rows()-1;
+      uint nTransitions = transitions.rows();
+      uint nQuery = transitions.cols();
+      uint finalLayer = nTransitions-1;
+      transitionsGradient = Eigen::MatrixXd::Zero(nTransitions, nQuery);
+      propsGradient = Eigen::VectorXd::Zero(props.rows());
+
+      for (uint i = 0; i < nQuery; i++)
+      {
+        uint thisLayer = 0;
+        double nextTransition = transitions(thisLayer+1, i);
+
+        for (uint z = 0; z < nCellsVert; ++z)
+        {
+          double lastZVal = zIntercepts(z);
+          double thisZVal = zIntercepts(z+1);
+          double g = gradient(z, i);
+
+          if ((thisLayer == finalLayer) || (thisZVal < nextTransition))
+          {
+            propsGradient(thisLayer) += g;
+          }
+          else
+          {
+            // The voxel is the thickness weighted mean of the layers in it.
+            // Moving a transition down grows the layer above it and shrinks
+            // the one below
+            double scale = g / (thisZVal - lastZVal);
+            double lastTransition = lastZVal;
+            while (nextTransition <= thisZVal)
+            {
+              propsGradient(thisLayer) += scale*(nextTransition-lastTransition);
+              transitionsGradient(thisLayer+1, i) += scale*(props(thisLayer) - props(thisLayer+1));
+              thisLayer++;
+              lastTransition = nextTransition;
+              if (thisLayer == finalLayer)
+                break;
+              nextTransition = transitions(thisLayer+1, i);
+            }
+            propsGradient(thisLayer) += scale*(thisZVal - lastTransition);
+          }
+        }
+      }
+    }
+
     Eigen::MatrixXd voxelise(const Eigen::MatrixXd &transitions,
         const Eigen::VectorXd &zIntercepts, const Eigen::VectorXd &props)
     {
@@ -44,6 +44,34 @@ namespace obsidian
     Eigen::MatrixXd getVoxels(const std::vector<world::InterpolatorSpec>& interpolators,
         const WorldParams& inputs, const Query& query, obsidian::RockProperty desiredProp);
 
+    //! Chain a gradient with respect to the voxels of voxelise() back to the
+    //! transitions and the layer properties (the adjoint of voxelise).
+    //!
+    //! \param transitions The layer transitions.
+    //! \param zIntercepts A vector containing the z coordinates of the voxels.
+    //! \param props The property value of each layer.
+    //! \param gradient The gradient with respect to the voxel values.
+    //! \param transitionsGradient Output gradient with respect to the transitions.
+    //! \param propsGradient Output gradient with respect to the layer properties.
+    //!
+    void voxeliseGradient(const Eigen::MatrixXd &transitions, const Eigen::VectorXd &zIntercepts,
+        const Eigen::VectorXd &props, const Eigen::MatrixXd &gradient,
+        Eigen::MatrixXd &transitionsGradient, Eigen::VectorXd &propsGradient);
+
+    //! Chain a gradient with respect to the voxels of getVoxels() back to the
+    //! world model parameters.
+    //!
+    //! \param interpolators The interpolator specs for each layer.
+    //! \param inputs The world model parameters.
+    //! \param query The query the voxels were computed for.
+    //! \param desiredProp The property of the voxels.
+    //! \param gradient The gradient with respect to the voxel values.
+    //! \return The gradient with respect to the world model parameters.
+    //!
+    WorldParams getVoxelsGradient(const std::vector<world::InterpolatorSpec>& interpolators,
+        const WorldParams& inputs, const Query& query, obsidian::RockProperty desiredProp,
+        const Eigen::MatrixXd& gradient);
+
     Eigen::VectorXd shrink3d(const Eigen::VectorXd &densities, int nx, int ny, int nz);
 
   }